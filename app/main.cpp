@@ -22,12 +22,19 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <chrono>
 
 #include "matrix.h"
 #include "sample.h"
+#include "eigen.h"
 #include "subspace.h"
 #include "classifier.h"
+#include "hnsw.h"
+#include "ivfpq.h"
 #include "local.h"
+#include "cpu.h"
+#include "distance.h"
+#include "convert.h"
 
 using namespace LibSubspace;
 
@@ -36,6 +43,12 @@ void PrintUsage(char *appName) {
 	printf(" If task is 'learn', learns the subspace based on the training data\n");
 	printf(" If task is 'test', performs a classification experiment in the\n");
 	printf(" specified subspace\n");
+	printf(" If task is 'convert', converts the samples of the learnset (or the testset)\n");
+	printf(" into a single binary file, that can be given instead of the learnset or\n");
+	printf(" the testset text file and is loaded much faster\n");
+	printf(" If task is 'bench', times the distance kernels and the conversions of the\n");
+	printf(" sample types for feature vectors of 64 to 4096 components, for each\n");
+	printf(" instruction set supported by the processor\n");
 	printf("\nOptions:\n");
 	printf(" -learnset learnset  specifies a text file with learning samples\n");
 	printf("                     if testset is not specified, and the task is 'test'\n");
@@ -67,14 +80,41 @@ void PrintUsage(char *appName) {
 	printf(" -subtype type       specifies a subspace to be learnd\n");
 	printf("                     if 'pca', learns a subspace based on the PCA\n");
 	printf("                     if 'lda', learns a subspace based on the LDA\n");
+	printf("                     if 'rpca', learns a PCA subspace using a randomized\n");
+	printf("                     algorithm, suitable for very large learn sets\n");
+	printf("                     (use with -dim, not supported with -local)\n");
 	printf(" -npca npca          if subspace type is 'lda', this param specifies\n");
 	printf("                     a dimensionality to which the samples will be reduced\n");
 	printf("                     prior to performing LDA\n");
 	printf("                     If not specified, npca is determined automatically\n");
+	printf(" -eigen type         eigensolver to be used when learning a subspace\n");
+	printf("                     'std' standard LAPACK eigensolvers (default)\n");
+	printf("                     'dc' divide and conquer eigensolvers, faster for\n");
+	printf("                          high-dimensional samples but use more memory\n");
+	printf(" -statfile name      when learning, the statistics of the learnset (mean,\n");
+	printf("                     scatter matrix, per-class means) are stored to this file\n");
+	printf("                     so that the subspace can later be updated with -update\n");
+	printf(" -update             updates a 'pca' or 'lda' subspace with the samples from the\n");
+	printf("                     learnset, using the statistics from the statfile instead\n");
+	printf("                     of the previous learnsets, the statfile is then updated\n");
+	printf("                     (not supported with -local)\n");
+	printf(" -stream             learns a PCA subspace while reading the learnset in\n");
+	printf("                     chunks, without keeping all of the samples in memory\n");
+	printf("                     (only with subspace type 'pca', not supported with -local)\n");
+	printf(" -chunk size         number of samples read at once with -stream, 1000 by default\n");
+	printf(" -binfile name       name of the binary file created when converting\n");
+	printf(" -bintype type       type of the features in the binary file created when\n");
+	printf("                     converting, one of 'char', 'uchar', 'int', 'uint', 'float'\n");
+	printf("                     or 'double', the same as sampletype by default ('double'\n");
+	printf("                     for 'img'), 'int' and 'uint' are stored as 32-bit values\n");
+	printf("                     binary files with 'double' features are used directly\n");
+	printf("                     from the mapped file, as are 'float' files with -float\n");
 	printf(" -subfile name       name of the file to store a subspace to if learning\n");
 	printf("                     or a name of the file to read a subspace from if testing\n");
 	printf(" -dim size           feature vector dimensionality to be used in experiments\n");
 	printf("                     and when learning local subspaces\n");
+	printf("                     when learning a global PCA or RPCA subspace, only this many\n");
+	printf("                     principal components are computed\n");
 	printf("                     if not specified, full dimensionality of the subspace\n");
 	printf("                     will be used\n");
 	printf(" -dist type          distance measure to be used in experiments\n");
@@ -83,6 +123,9 @@ void PrintUsage(char *appName) {
 	printf("                     'hamming' normalized Hamming distance, only signs of\n");
 	printf("                               features will be used\n");
 	printf("                     if not specified, euclidean distance will be used\n");
+	printf(" -float              when testing, stores the samples and the projected samples\n");
+	printf("                     in single precision, halving the memory used\n");
+	printf("                     (not supported with -local)\n");
 	printf(" -local              learns or tests feature obtained using local instead of\n");
 	printf("                     global subspaces\n");
 	printf(" -w width            width of images used for learning local subspaces\n");
@@ -91,6 +134,39 @@ void PrintUsage(char *appName) {
 	printf("                     local subspaces\n");
 	printf(" -winstep step       translation step of the sliding window to be used when\n");
 	printf("                     learning local subspaces\n");
+	printf(" -rank k             when testing, also finds the k classes closest to each\n");
+	printf("                     test sample and prints the rank-1 to rank-k accuracy,\n");
+	printf("                     the cumulative match characteristic (CMC) curve\n");
+	printf(" -hnsw               when testing, classifies the test samples using an\n");
+	printf("                     approximate nearest neighbor index (HNSW graph) of the\n");
+	printf("                     learn samples, only with 'euclid' and 'nc' distances\n");
+	printf(" -M m                maximum number of links of a sample in the index, 16 by\n");
+	printf("                     default, the bottom layer of the graph has up to 2*m links\n");
+	printf(" -efc n              number of candidate neighbors examined when building the\n");
+	printf("                     index, 200 by default\n");
+	printf(" -ef n               number of candidates examined when searching the index,\n");
+	printf("                     64 by default, larger values are slower but more accurate\n");
+	printf(" -ivfpq              when testing, classifies the test samples using a compressed\n");
+	printf("                     index (inverted lists of product quantization codes) of\n");
+	printf("                     the learn samples, only with 'euclid' and 'nc' distances\n");
+	printf("                     (not supported with -float)\n");
+	printf(" -nlist n            number of inverted lists of the compressed index, 256 by\n");
+	printf("                     default\n");
+	printf(" -pqm m              number of bytes of the code of a sample in the compressed\n");
+	printf("                     index, 16 by default\n");
+	printf(" -nprobe n           number of lists searched in the compressed index, 8 by\n");
+	printf("                     default, larger values are slower but more accurate\n");
+	printf(" -rerank n           number of the closest candidates of the compressed index\n");
+	printf("                     compared with the learn samples, 100 by default\n");
+	printf(" -indexfile name     the index is loaded from this file if it was built for the\n");
+	printf("                     same learn samples (recognized by a hash of their\n");
+	printf("                     projected feature vectors), otherwise it is built and\n");
+	printf("                     stored to it\n");
+	printf(" -annbench           with -hnsw or -ivfpq, compares the index with the exact\n");
+	printf("                     search, prints the recall and the time per test sample for\n");
+	printf("                     several -ef or -nprobe values\n");
+	printf(" -threads n          number of threads used to load and classify the samples,\n");
+	printf("                     by default one thread per processor\n");
 	printf(" -v                  Verbose, prints detailed error messages and progress\n");
 	printf("                     information\n");
 	printf("\nExamples:\n");
@@ -130,6 +206,11 @@ void PrintUsage(char *appName) {
 	printf("   Samples are stored as images\n");
 	printf("   Hamming distance is used as the matching measure\n");
 	printf("   Feature vector dimensionality used in the experiment is 1500\n");	
+	printf("\nExample 6:\n");
+	printf("subspace convert -learnset face_db.txt -sampletype uchar -samplesize 4096 -binfile face_db.bin\n");
+	printf("   Converts the samples listed in face_db.txt into a single binary file\n");
+	printf("   face_db.bin, with the features stored as unsigned 8-bit values\n");
+	printf("   face_db.bin can then be used as -learnset or -testset\n");
 }
 
 int GetOption(int argc, char* argv[], const char *optionName, char **optionValue) {
@@ -148,6 +229,215 @@ int GetOption(int argc, char* argv[], const char *optionName, char **optionValue
 	return 0;
 }
 
+//reports the samples that could not be loaded, with -v each of them
+void ReportLoadErrors(int argc, char* argv[], SampleSet *samples) {
+	long errors = samples->GetNumberOfLoadErrors();
+	if(errors) {
+		printf("Warning: %ld of %ld samples could not be loaded\n",errors,samples->Size());
+		if(GetOption(argc,argv,"-v",NULL)) {
+			for(long i=0;i<errors;i++) {
+				printf("Error loading sample %s\n",samples->GetSample(samples->GetLoadError(i))->GetFilename());
+			}
+		}
+	}
+}
+
+void ReportLoadErrors(int argc, char* argv[], FloatSampleSet *samples) {
+	long errors = samples->GetNumberOfLoadErrors();
+	if(errors) {
+		printf("Warning: %ld of %ld samples could not be loaded\n",errors,samples->Size());
+		if(GetOption(argc,argv,"-v",NULL)) {
+			for(long i=0;i<errors;i++) {
+				printf("Error loading sample %s\n",samples->GetFilename(samples->GetLoadError(i)));
+			}
+		}
+	}
+}
+
+//loads a sample set, using the number of threads given by the -threads option
+//the samples that could not be loaded are reported, with -v each of them
+void LoadSampleSet(int argc, char* argv[], SampleSet *samples, char *filename, int sampletype, long samplesize) {
+	char *option;
+	if(GetOption(argc,argv,"-threads",&option)) {
+		samples->loadThreads = atoi(option);
+	}
+	samples->Load(filename,sampletype,samplesize);
+	ReportLoadErrors(argc,argv,samples);
+}
+
+//loads a single precision sample set, the samples that could not be loaded are reported as above
+void LoadSampleSet(int argc, char* argv[], FloatSampleSet *samples, char *filename, int sampletype, long samplesize) {
+	samples->Load(filename,sampletype,samplesize);
+	ReportLoadErrors(argc,argv,samples);
+}
+
+//prints the cumulative match characteristic computed by an identification test
+void PrintCMC(float *cmc, long rank) {
+	printf("Cumulative match characteristic:\n");
+	for(long r = 0; r < rank; r++) {
+		printf("Rank-%ld accuracy: %g%%\n",r+1,cmc[r]*100);
+	}
+}
+
+//builds the approximate nearest neighbor index of the gallery for the -hnsw option, using the -M, -efc and -ef options
+//the index is loaded from the file given by -indexfile if it was built for the same gallery and distance,
+//otherwise the new index is stored to that file
+//returns 0 on error
+int PrepareIndex(int argc, char* argv[], HNSWIndex *index, Gallery *gallery, int dist) {
+	char *option;
+	char *indexfilename = NULL;
+
+	if(GetOption(argc,argv,"-M",&option)) {
+		index->M = atol(option);
+	}
+	if(GetOption(argc,argv,"-efc",&option)) {
+		index->efConstruction = atol(option);
+	}
+	if(GetOption(argc,argv,"-ef",&option)) {
+		index->efSearch = atol(option);
+	}
+	if(GetOption(argc,argv,"-v",NULL)) {
+		index->verbose = true;
+	}
+
+	if(GetOption(argc,argv,"-indexfile",&indexfilename)) {
+		if(index->Load(indexfilename,gallery) && (index->GetDistanceMeasure() == dist)) return 1;
+	}
+
+	if(!index->Build(gallery,dist)) {
+		printf("Error: the index supports only the 'euclid' and 'nc' distances\n");
+		return 0;
+	}
+	if(indexfilename && !index->Save(indexfilename)) {
+		printf("Error saving the index to %s\n",indexfilename);
+	}
+	return 1;
+}
+
+//compares the approximate nearest neighbor search with the exact search for the -annbench option
+//prints the time per test sample of the exact search, and the recall (the fraction of test samples
+//for which the exact nearest base sample is found) and the time per test sample of the index for several efSearch values
+//either testSamples or floatTestSamples is given, the searches are performed by a single thread
+void BenchmarkIndex(OneNNClassifier *classifier, HNSWIndex *index, SampleSet *testSamples, FloatSampleSet *floatTestSamples) {
+	long i,j;
+	long numTest = testSamples ? testSamples->Size() : floatTestSamples->Size();
+	long efValues[] = {10, 20, 40, 80, 160, 320};
+	long numEf = sizeof(efValues)/sizeof(long);
+	long efSearch = index->efSearch;
+	if(numTest == 0) return;
+
+	long *exact = (long *)malloc(numTest*sizeof(long));
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(i = 0; i < numTest; i++) {
+		exact[i] = -1;
+		if(testSamples) classifier->IdentifySample(testSamples->GetSample(i),index->GetGallery(),1,&(exact[i]));
+		else classifier->IdentifySample(floatTestSamples->GetSampleData(i),index->GetGallery(),1,&(exact[i]));
+	}
+	double exactTime = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count()/numTest;
+	printf("Exact search: %.4f ms per test sample\n",exactTime*1000);
+
+	for(j = 0; j < numEf; j++) {
+		long found = 0;
+		index->efSearch = efValues[j];
+		start = std::chrono::steady_clock::now();
+		for(i = 0; i < numTest; i++) {
+			long nearest = -1;
+			if(testSamples) index->Search(testSamples->GetSample(i)->GetData(),1,&nearest);
+			else index->Search(floatTestSamples->GetSampleData(i),1,&nearest);
+			if(nearest == exact[i]) found++;
+		}
+		double time = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count()/numTest;
+		printf("Index search, ef %4ld: recall %.4f, %.4f ms per test sample (%.1fx faster)\n",efValues[j],((double)found)/numTest,time*1000,exactTime/time);
+	}
+
+	index->efSearch = efSearch;
+	free(exact);
+}
+
+//trains the compressed index of the learn samples for the -ivfpq option, using the -nlist, -pqm, -nprobe and -rerank options
+//the index is loaded from the file given by -indexfile if it was built for the same samples and distance,
+//otherwise the new index is stored to that file
+//returns 0 on error
+int PrepareCompressedIndex(int argc, char* argv[], IVFPQIndex *index, SampleSet *learnSamples, int dist, long dim) {
+	char *option;
+	char *indexfilename = NULL;
+
+	if(GetOption(argc,argv,"-nlist",&option)) {
+		index->numLists = atol(option);
+	}
+	if(GetOption(argc,argv,"-pqm",&option)) {
+		index->numSubquantizers = atol(option);
+	}
+	if(GetOption(argc,argv,"-nprobe",&option)) {
+		index->numProbes = atol(option);
+	}
+	if(GetOption(argc,argv,"-rerank",&option)) {
+		index->numRerank = atol(option);
+	}
+	if(GetOption(argc,argv,"-threads",&option)) {
+		index->numThreads = atoi(option);
+	}
+	if(GetOption(argc,argv,"-v",NULL)) {
+		index->verbose = true;
+	}
+
+	if(GetOption(argc,argv,"-indexfile",&indexfilename)) {
+		if(index->Load(indexfilename,learnSamples) && (index->GetDistanceMeasure() == dist) &&
+			(!dim || (index->GetDim() == dim))) return 1;
+	}
+
+	if(!index->Train(learnSamples,dist,dim)) {
+		printf("Error: the compressed index supports only the 'euclid' and 'nc' distances\n");
+		return 0;
+	}
+	index->SetBaseSamples(learnSamples);
+	if(indexfilename && !index->Save(indexfilename)) {
+		printf("Error saving the index to %s\n",indexfilename);
+	}
+	return 1;
+}
+
+//compares the compressed index with the exact search for the -annbench option, as BenchmarkIndex,
+//for several numProbes values, and prints the memory used by the index and by the feature vectors
+void BenchmarkCompressedIndex(OneNNClassifier *classifier, IVFPQIndex *index, SampleSet *testSamples) {
+	long i,j;
+	long numTest = testSamples->Size();
+	long probeValues[] = {1, 2, 4, 8, 16, 32, 64};
+	long numProbeValues = sizeof(probeValues)/sizeof(long);
+	long numProbes = index->numProbes;
+	SampleSet *baseSamples = index->GetBaseSamples();
+	if((numTest == 0) || !baseSamples) return;
+
+	double vectorSize = (double)baseSamples->Size()*index->GetDim()*sizeof(double);
+	printf("Compressed index: %.1f MB, feature vectors: %.1f MB (%.1fx smaller)\n",index->GetMemorySize()/1048576.0,vectorSize/1048576.0,vectorSize/index->GetMemorySize());
+
+	Gallery gallery(baseSamples,index->GetDim());
+	long *exact = (long *)malloc(numTest*sizeof(long));
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for(i = 0; i < numTest; i++) {
+		exact[i] = -1;
+		classifier->IdentifySample(testSamples->GetSample(i),&gallery,1,&(exact[i]));
+	}
+	double exactTime = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count()/numTest;
+	printf("Exact search: %.4f ms per test sample\n",exactTime*1000);
+
+	for(j = 0; j < numProbeValues; j++) {
+		long found = 0;
+		index->numProbes = probeValues[j];
+		start = std::chrono::steady_clock::now();
+		for(i = 0; i < numTest; i++) {
+			long nearest = -1;
+			index->Search(testSamples->GetSample(i)->GetData(),1,&nearest);
+			if(nearest == exact[i]) found++;
+		}
+		double time = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count()/numTest;
+		printf("Index search, nprobe %3ld: recall %.4f, %.4f ms per test sample (%.1fx faster)\n",probeValues[j],((double)found)/numTest,time*1000,exactTime/time);
+	}
+
+	index->numProbes = numProbes;
+	free(exact);
+}
+
 int LearnSubspace(int argc, char* argv[]) {
 	SubspaceGenerator *subGen = NULL;
 	SampleSet learnSamples;
@@ -159,6 +449,10 @@ int LearnSubspace(int argc, char* argv[]) {
 	int sampletype;
 	long samplesize = 0;
 	int subspacetype;
+	int eigenalgorithm = EIGEN_CHOL;
+	bool randomized = false;
+	char statfilename[1024] = "";
+	bool update = false;
 
 	//get all relevant options
 	if(!GetOption(argc,argv,"-learnset",&option)) {
@@ -201,6 +495,10 @@ int LearnSubspace(int argc, char* argv[]) {
 		return 0;
 	} else {
 		if(strcmp(option,"pca")==0) subspacetype = SUBSPACE_PCA;
+		else if(strcmp(option,"rpca")==0) {
+			subspacetype = SUBSPACE_PCA;
+			randomized = true;
+		}
 		else if(strcmp(option,"lda")==0) subspacetype = SUBSPACE_LDA;
 		else {
 			printf("Invalid option, unknown subspace type, exiting\n");
@@ -208,15 +506,82 @@ int LearnSubspace(int argc, char* argv[]) {
 		}
 	}
 
+	if(GetOption(argc,argv,"-eigen",&option)) {
+		if(strcmp(option,"std")==0) eigenalgorithm = EIGEN_CHOL;
+		else if(strcmp(option,"dc")==0) eigenalgorithm = EIGEN_DC;
+		else {
+			printf("Invalid option, unknown eigensolver, exiting\n");
+			return 0;
+		}
+	}
+
+	if(GetOption(argc,argv,"-statfile",&option)) {
+		strncpy(statfilename,option,1024);
+		statfilename[1023]=0;
+	}
+
+	if(GetOption(argc,argv,"-update",NULL)) {
+		if(!statfilename[0]) {
+			printf("Missing option, 'statfile' is required with 'update'\n");
+			return 0;
+		}
+		if(randomized) {
+			printf("Invalid option, 'update' is not supported for 'rpca' subspaces, exiting\n");
+			return 0;
+		}
+		update = true;
+	}
+
+	//streaming PCA reads the samples in chunks, without loading the whole sample set
+	if(GetOption(argc,argv,"-stream",NULL)) {
+		if(statfilename[0]) {
+			printf("Invalid option, 'statfile' is not supported with 'stream', exiting\n");
+			return 0;
+		}
+		if((subspacetype != SUBSPACE_PCA) || randomized) {
+			printf("Invalid option, streaming is only supported for 'pca' subspaces, exiting\n");
+			return 0;
+		}
+		StreamingPCASubspaceGenerator streamGen;
+		if(GetOption(argc,argv,"-dim",&option)) {
+			streamGen.numComponents = atol(option);
+		}
+		if(GetOption(argc,argv,"-chunk",&option)) {
+			streamGen.chunkSize = atol(option);
+			if(streamGen.chunkSize <= 0) {
+				printf("Invalid option, chunk size must be positive, exiting\n");
+				return 0;
+			}
+		}
+		if(GetOption(argc,argv,"-v",NULL)) {
+			streamGen.verbose = true;
+		}
+		streamGen.eigenAlgorithm = eigenalgorithm;
+
+		//generate and store subspace
+		if(!streamGen.GenerateSubspace(learnsamplefilename,sampletype,samplesize,&subspace)) return 0;
+		subspace.Save(subspacefilename);
+
+		return 1;
+	}
+
 	//load the sample set
-	learnSamples.Load(learnsamplefilename,sampletype,samplesize);
+	LoadSampleSet(argc,argv,&learnSamples,learnsamplefilename,sampletype,samplesize);
 	if(GetOption(argc,argv,"-v",NULL)) {
 		printf("Loaded %ld samples\n", learnSamples.Size());
 	}
 	
 	//create a subspace generator object and set its options
-	if(subspacetype == SUBSPACE_PCA) {
+	if((subspacetype == SUBSPACE_PCA) && randomized) {
+		subGen = new RandomizedPCASubspaceGenerator;
+		if(GetOption(argc,argv,"-dim",&option)) {
+			((RandomizedPCASubspaceGenerator*)subGen)->numComponents = atol(option);
+		}
+	} else if(subspacetype == SUBSPACE_PCA) {
 		subGen = new PCASubspaceGenerator;
+		if(GetOption(argc,argv,"-dim",&option)) {
+			((PCASubspaceGenerator*)subGen)->numComponents = atol(option);
+		}
 	} else if(subspacetype == SUBSPACE_LDA) {
 		subGen = new LDASubspaceGenerator;
 		if(GetOption(argc,argv,"-npca",&option)) {
@@ -226,9 +591,32 @@ int LearnSubspace(int argc, char* argv[]) {
 	if(GetOption(argc,argv,"-v",NULL)) {
 		subGen->verbose = true;
 	}
+	subGen->eigenAlgorithm = eigenalgorithm;
 
 	//generate subspace
-	subGen->GenerateSubspace(&learnSamples, &subspace);
+	if(update) {
+		//update the subspace with the learn set, using the statistics of the previous learn sets
+		SampleStatistics statistics;
+		if(!statistics.Load(statfilename)) {
+			printf("Error loading statistics from %s, exiting\n",statfilename);
+			delete subGen;
+			return 0;
+		}
+		if(!subGen->UpdateSubspace(&statistics, &learnSamples, &subspace)) {
+			printf("Error updating subspace, exiting\n");
+			delete subGen;
+			return 0;
+		}
+		statistics.Save(statfilename);
+	} else {
+		subGen->GenerateSubspace(&learnSamples, &subspace);
+		if(statfilename[0]) {
+			//store the statistics of the learn set for later updates
+			SampleStatistics statistics;
+			statistics.Add(&learnSamples);
+			statistics.Save(statfilename);
+		}
+	}
 	delete subGen;
 
 	//store subspace
@@ -248,6 +636,7 @@ int LearnLocalSubspace(int argc, char* argv[]) {
 	int sampletype;
 	long samplesize = 0;
 	int subspacetype;
+	int eigenalgorithm = EIGEN_CHOL;
 	int w,h,winstep,winsize;
 	long dim = 0;
 
@@ -329,8 +718,17 @@ int LearnLocalSubspace(int argc, char* argv[]) {
 		}
 	}
 
+	if(GetOption(argc,argv,"-eigen",&option)) {
+		if(strcmp(option,"std")==0) eigenalgorithm = EIGEN_CHOL;
+		else if(strcmp(option,"dc")==0) eigenalgorithm = EIGEN_DC;
+		else {
+			printf("Invalid option, unknown eigensolver, exiting\n");
+			return 0;
+		}
+	}
+
 	//load the sample set
-	learnSamples.Load(learnsamplefilename,sampletype,samplesize);
+	LoadSampleSet(argc,argv,&learnSamples,learnsamplefilename,sampletype,samplesize);
 	if(GetOption(argc,argv,"-v",NULL)) {
 		printf("Loaded %ld samples\n", learnSamples.Size());
 	}
@@ -347,6 +745,7 @@ int LearnLocalSubspace(int argc, char* argv[]) {
 	if(GetOption(argc,argv,"-v",NULL)) {
 		subGen->verbose = true;
 	}
+	subGen->eigenAlgorithm = eigenalgorithm;
 
 	LocalSubspaceGenerator localGen(subGen, w, h, winsize, winstep, dim);
 
@@ -360,6 +759,95 @@ int LearnLocalSubspace(int argc, char* argv[]) {
 	return 1;
 }
 
+//performs a classification experiment with single precision samples
+//the options are the same as in TestSubspace, parsed by the caller
+int TestSubspaceFloat(int argc, char* argv[], char *subspacefilename, int sampletype, long samplesize, long dim, int dist) {
+	FloatSampleSet *learnSet = NULL, *testSet = NULL;
+	FloatSampleSet *projectedSamplesLearn = NULL, *projectedSamplesTest = NULL;
+
+	char *option;
+	float result;
+
+	//read samples
+	if(GetOption(argc,argv,"-learnset",&option)) {
+		learnSet = new FloatSampleSet;
+		LoadSampleSet(argc,argv,learnSet,option,sampletype,samplesize);
+	}
+	if(GetOption(argc,argv,"-testset",&option)) {
+		testSet = new FloatSampleSet;
+		LoadSampleSet(argc,argv,testSet,option,sampletype,samplesize);
+	}
+	if(!learnSet&&!testSet) {
+		printf("Error: neither learn set nor test set specified\n");
+		return 0;
+	} else if(!learnSet) {
+		learnSet = testSet;
+	} else if(!testSet) {
+		testSet = learnSet;
+	}
+
+	//load subspace
+	Subspace subspace;
+	if(subspace.Load(subspacefilename)) {
+		//project samples into subspace
+		SubspaceProjector proj(&subspace);
+		projectedSamplesLearn = new FloatSampleSet;
+		proj.ProjectSampleSet(learnSet,projectedSamplesLearn);
+		if(learnSet == testSet) {
+			projectedSamplesTest = projectedSamplesLearn;
+		} else {
+			projectedSamplesTest = new FloatSampleSet;
+			proj.ProjectSampleSet(testSet,projectedSamplesTest);
+		}
+
+		//perform classification experiment
+		OneNNClassifier classifier;
+		classifier.distanceMeasure = dist;
+
+		if(GetOption(argc,argv,"-v",NULL)) {
+			classifier.verbose = true;
+		}
+		if(GetOption(argc,argv,"-threads",&option)) {
+			classifier.numThreads = atoi(option);
+		}
+
+		if(GetOption(argc,argv,"-hnsw",NULL)) {
+			Gallery gallery(projectedSamplesLearn,dim);
+			HNSWIndex index;
+			if(PrepareIndex(argc,argv,&index,&gallery,dist)) {
+				if(GetOption(argc,argv,"-annbench",NULL)) {
+					BenchmarkIndex(&classifier,&index,NULL,projectedSamplesTest);
+				}
+				result = classifier.ClassificationTest(&index,projectedSamplesTest);
+				printf("Classification accuracy: %g%%\n",result*100);
+			}
+		} else if(GetOption(argc,argv,"-ivfpq",NULL)) {
+			printf("Error: -ivfpq is not supported with -float\n");
+		} else if(GetOption(argc,argv,"-rank",&option)) {
+			long rank = atol(option);
+			if(rank < 1) rank = 1;
+			float *cmc = (float *)malloc(rank*sizeof(float));
+			result = classifier.IdentificationTest(projectedSamplesLearn,projectedSamplesTest,rank,cmc,dim);
+			printf("Classification accuracy: %g%%\n",result*100);
+			PrintCMC(cmc,rank);
+			free(cmc);
+		} else {
+			result = classifier.ClassificationTest(projectedSamplesLearn,projectedSamplesTest,dim);
+			printf("Classification accuracy: %g%%\n",result*100);
+		}
+	} else {
+		printf("Error loading subspace\n");
+	}
+
+	//cleanup
+	if(testSet != learnSet) delete testSet;
+	delete learnSet;
+	if(projectedSamplesTest != projectedSamplesLearn) delete projectedSamplesTest;
+	if(projectedSamplesLearn) delete projectedSamplesLearn;
+
+	return 1;
+}
+
 int TestSubspace(int argc, char* argv[]) {
 	SampleSet *learnSet = NULL, *testSet = NULL;
 	SampleSet *projectedSamplesLearn = NULL, *projectedSamplesTest = NULL;
@@ -416,18 +904,23 @@ int TestSubspace(int argc, char* argv[]) {
 		dim = atol(option);
 	}
 
+	//samples and projected samples are stored in single precision
+	if(GetOption(argc,argv,"-float",NULL)) {
+		return TestSubspaceFloat(argc,argv,subspacefilename,sampletype,samplesize,dim,dist);
+	}
+
 	//read samples
 	if(GetOption(argc,argv,"-learnset",&option)) {
 		strncpy(samplefilename,option,1024);
 		samplefilename[1023]=0;
 		learnSet = new SampleSet;
-		learnSet->Load(samplefilename,sampletype,samplesize);
+		LoadSampleSet(argc,argv,learnSet,samplefilename,sampletype,samplesize);
 	}
 	if(GetOption(argc,argv,"-testset",&option)) {
 		strncpy(samplefilename,option,1024);
 		samplefilename[1023]=0;
 		testSet = new SampleSet;
-		testSet->Load(samplefilename,sampletype,samplesize);
+		LoadSampleSet(argc,argv,testSet,samplefilename,sampletype,samplesize);
 	}
 	if(!learnSet&&!testSet) {
 		printf("Error: neither learn set nor test set specified\n");
@@ -461,9 +954,41 @@ int TestSubspace(int argc, char* argv[]) {
 		if(GetOption(argc,argv,"-v",NULL)) {
 			classifier.verbose = true;
 		}
+		if(GetOption(argc,argv,"-threads",&option)) {
+			classifier.numThreads = atoi(option);
+		}
 
-		result = classifier.ClassificationTest(projectedSamplesLearn,projectedSamplesTest,dim);
-		printf("Classification accuracy: %g%%\n",result*100);
+		if(GetOption(argc,argv,"-hnsw",NULL)) {
+			Gallery gallery(projectedSamplesLearn,dim);
+			HNSWIndex index;
+			if(PrepareIndex(argc,argv,&index,&gallery,dist)) {
+				if(GetOption(argc,argv,"-annbench",NULL)) {
+					BenchmarkIndex(&classifier,&index,projectedSamplesTest,NULL);
+				}
+				result = classifier.ClassificationTest(&index,projectedSamplesTest);
+				printf("Classification accuracy: %g%%\n",result*100);
+			}
+		} else if(GetOption(argc,argv,"-ivfpq",NULL)) {
+			IVFPQIndex index;
+			if(PrepareCompressedIndex(argc,argv,&index,projectedSamplesLearn,dist,dim)) {
+				if(GetOption(argc,argv,"-annbench",NULL)) {
+					BenchmarkCompressedIndex(&classifier,&index,projectedSamplesTest);
+				}
+				result = classifier.ClassificationTest(&index,projectedSamplesTest);
+				printf("Classification accuracy: %g%%\n",result*100);
+			}
+		} else if(GetOption(argc,argv,"-rank",&option)) {
+			long rank = atol(option);
+			if(rank < 1) rank = 1;
+			float *cmc = (float *)malloc(rank*sizeof(float));
+			result = classifier.IdentificationTest(projectedSamplesLearn,projectedSamplesTest,rank,cmc,dim);
+			printf("Classification accuracy: %g%%\n",result*100);
+			PrintCMC(cmc,rank);
+			free(cmc);
+		} else {
+			result = classifier.ClassificationTest(projectedSamplesLearn,projectedSamplesTest,dim);
+			printf("Classification accuracy: %g%%\n",result*100);
+		}
 	} else {
 		printf("Error loading subspace\n");
 	}	
@@ -546,13 +1071,13 @@ int TestLocalSubspace(int argc, char* argv[]) {
 		strncpy(samplefilename,option,1024);
 		samplefilename[1023]=0;
 		learnSet = new SampleSet;
-		learnSet->Load(samplefilename,sampletype,samplesize);
+		LoadSampleSet(argc,argv,learnSet,samplefilename,sampletype,samplesize);
 	}
 	if(GetOption(argc,argv,"-testset",&option)) {
 		strncpy(samplefilename,option,1024);
 		samplefilename[1023]=0;
 		testSet = new SampleSet;
-		testSet->Load(samplefilename,sampletype,samplesize);
+		LoadSampleSet(argc,argv,testSet,samplefilename,sampletype,samplesize);
 	}
 	if(!learnSet&&!testSet) {
 		printf("Error: neither learn set nor test set specified\n");
@@ -586,9 +1111,41 @@ int TestLocalSubspace(int argc, char* argv[]) {
 		if(GetOption(argc,argv,"-v",NULL)) {
 			classifier.verbose = true;
 		}
+		if(GetOption(argc,argv,"-threads",&option)) {
+			classifier.numThreads = atoi(option);
+		}
 
-		result = classifier.ClassificationTest(projectedSamplesLearn,projectedSamplesTest,dim);
-		printf("Classification accuracy: %g%%\n",result*100);
+		if(GetOption(argc,argv,"-hnsw",NULL)) {
+			Gallery gallery(projectedSamplesLearn,dim);
+			HNSWIndex index;
+			if(PrepareIndex(argc,argv,&index,&gallery,dist)) {
+				if(GetOption(argc,argv,"-annbench",NULL)) {
+					BenchmarkIndex(&classifier,&index,projectedSamplesTest,NULL);
+				}
+				result = classifier.ClassificationTest(&index,projectedSamplesTest);
+				printf("Classification accuracy: %g%%\n",result*100);
+			}
+		} else if(GetOption(argc,argv,"-ivfpq",NULL)) {
+			IVFPQIndex index;
+			if(PrepareCompressedIndex(argc,argv,&index,projectedSamplesLearn,dist,dim)) {
+				if(GetOption(argc,argv,"-annbench",NULL)) {
+					BenchmarkCompressedIndex(&classifier,&index,projectedSamplesTest);
+				}
+				result = classifier.ClassificationTest(&index,projectedSamplesTest);
+				printf("Classification accuracy: %g%%\n",result*100);
+			}
+		} else if(GetOption(argc,argv,"-rank",&option)) {
+			long rank = atol(option);
+			if(rank < 1) rank = 1;
+			float *cmc = (float *)malloc(rank*sizeof(float));
+			result = classifier.IdentificationTest(projectedSamplesLearn,projectedSamplesTest,rank,cmc,dim);
+			printf("Classification accuracy: %g%%\n",result*100);
+			PrintCMC(cmc,rank);
+			free(cmc);
+		} else {
+			result = classifier.ClassificationTest(projectedSamplesLearn,projectedSamplesTest,dim);
+			printf("Classification accuracy: %g%%\n",result*100);
+		}
 	} else {
 		printf("Error loading subspace\n");
 	}	
@@ -610,6 +1167,279 @@ int TestLocalSubspace(int argc, char* argv[]) {
 	return 1;}
 
 
+int ConvertSamples(int argc, char* argv[]) {
+	char *option;
+	char samplefilename[1024];
+	char binfilename[1024];
+	int sampletype;
+	int bintype;
+	long samplesize = 0;
+
+	//get all relevant options
+	if(GetOption(argc,argv,"-learnset",&option) || GetOption(argc,argv,"-testset",&option)) {
+		strncpy(samplefilename,option,1024);
+		samplefilename[1023]=0;
+	} else {
+		printf("Missing option, 'learnset'\n");
+		return 0;
+	}
+
+	if(!GetOption(argc,argv,"-binfile",&option)) {
+		printf("Missing option, 'binfile'\n");
+		return 0;
+	}
+	strncpy(binfilename,option,1024);
+	binfilename[1023]=0;
+
+	if(!GetOption(argc,argv,"-sampletype",&option)) {
+		printf("Warning: missing sample type, assumed 'double'\n");
+		sampletype = TYPE_DOUBLE;
+	} else {
+		if(strcmp(option,"char")==0) sampletype = TYPE_CHAR;
+		else if(strcmp(option,"uchar")==0) sampletype = TYPE_UCHAR;
+		else if(strcmp(option,"int")==0) sampletype = TYPE_INT;
+		else if(strcmp(option,"uint")==0) sampletype = TYPE_UINT;
+		else if(strcmp(option,"float")==0) sampletype = TYPE_FLOAT;
+		else if(strcmp(option,"double")==0) sampletype = TYPE_DOUBLE;
+		else if(strcmp(option,"img")==0) sampletype = TYPE_IMAGE;
+		else {
+			printf("Invalid option, unknown sample type, exiting\n");
+			return 0;
+		}
+	}
+
+	if(GetOption(argc,argv,"-bintype",&option)) {
+		if(strcmp(option,"char")==0) bintype = TYPE_CHAR;
+		else if(strcmp(option,"uchar")==0) bintype = TYPE_UCHAR;
+		else if(strcmp(option,"int")==0) bintype = TYPE_INT;
+		else if(strcmp(option,"uint")==0) bintype = TYPE_UINT;
+		else if(strcmp(option,"float")==0) bintype = TYPE_FLOAT;
+		else if(strcmp(option,"double")==0) bintype = TYPE_DOUBLE;
+		else {
+			printf("Invalid option, unknown binary file type, exiting\n");
+			return 0;
+		}
+	} else {
+		bintype = (sampletype == TYPE_IMAGE) ? TYPE_DOUBLE : sampletype;
+	}
+
+	if(GetOption(argc,argv,"-samplesize",&option)) {
+		samplesize = atol(option);
+	}
+
+	SampleSet names;
+	long converted = ConvertSampleSet(samplefilename,sampletype,samplesize,binfilename,bintype,&names);
+	if(!converted) {
+		printf("Error converting %s to %s\n",samplefilename,binfilename);
+		return 0;
+	}
+	ReportLoadErrors(argc,argv,&names);
+	if(GetOption(argc,argv,"-v",NULL)) {
+		printf("%ld samples converted\n",converted);
+	}
+
+	return 1;
+}
+
+#define BENCH_KERNELS 9
+static const char *benchKernelNames[BENCH_KERNELS] = {"squaredEuclidean", "dot", "dotProduct", "signMismatches",
+	"squaredEuclideanFloat", "dotFloat", "dotProductFloat", "signMismatchesFloat", "signCodeMismatches"};
+static const char *benchLevelNames[] = {"scalar", "AVX2", "AVX-512"};
+
+//receives the results of the timed kernels, so that the calls are not optimized away
+static volatile double benchSink;
+
+//calls the given kernel (an index in benchKernelNames) calls times, 3 times, and returns the shortest time in ns per call
+//the kernel compares vectors of n components, given in double and single precision and as sign codes
+double TimeDistanceKernel(const DistanceKernels *kernels, int kernel, double *v1, double *v2, float *f1, float *f2,
+	unsigned long long *c1, unsigned long long *c2, long n, long calls)
+{
+	double best = 0;
+	double sum = 0, sqnorm;
+	float sqnormf;
+	long nwords = SignCodeWords(n);
+	for(int repeat = 0; repeat < 3; repeat++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for(long i = 0; i < calls; i++) {
+			switch(kernel) {
+			case 0: sum += kernels->squaredEuclidean(v1,v2,n); break;
+			case 1: sum += kernels->dot(v1,v2,n); break;
+			case 2: sum += kernels->dotProduct(v1,v2,n,&sqnorm); break;
+			case 3: sum += kernels->signMismatches(v1,v2,n); break;
+			case 4: sum += kernels->squaredEuclideanFloat(f1,f2,n); break;
+			case 5: sum += kernels->dotFloat(f1,f2,n); break;
+			case 6: sum += kernels->dotProductFloat(f1,f2,n,&sqnormf); break;
+			case 7: sum += kernels->signMismatchesFloat(f1,f2,n); break;
+			case 8: sum += kernels->signCodeMismatches(c1,c2,nwords); break;
+			}
+		}
+		double time = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count()*1e9/calls;
+		if(repeat == 0 || time < best) best = time;
+	}
+	benchSink = sum;
+	return best;
+}
+
+//times the distance kernels for the 'bench' task, for each level of instruction set extensions supported by the processor
+//(see LimitCpuLevel), the sign codes are compared with POPCNT on the AVX2 level and with VPOPCNTDQ on the AVX-512 level if supported
+//prints the time per call for feature vectors of 64 to 4096 components, and the speedup of the highest level over the scalar code
+//the same vectors are compared repeatedly, so they stay in the cache
+int BenchmarkKernels() {
+	long dims[] = {64, 128, 256, 512, 1024, 2048, 4096};
+	long numDims = sizeof(dims)/sizeof(long);
+	long maxDim = dims[numDims-1];
+	int numLevels = 1;
+	DistanceKernels kernels[3];
+	unsigned long long seed = 1;
+	long i;
+
+	if(CpuSupportsAVX2()) numLevels = 2;
+	if(CpuSupportsAVX512()) numLevels = 3;
+	for(int level = 0; level < numLevels; level++) {
+		LimitCpuLevel(level);
+		kernels[level] = SelectDistanceKernels();
+	}
+	LimitCpuLevel(CPU_LEVEL_AVX512);
+
+	double *v1 = (double *)malloc(maxDim*sizeof(double));
+	double *v2 = (double *)malloc(maxDim*sizeof(double));
+	float *f1 = (float *)malloc(maxDim*sizeof(float));
+	float *f2 = (float *)malloc(maxDim*sizeof(float));
+	unsigned long long *c1 = (unsigned long long *)malloc(2*SignCodeWords(maxDim)*sizeof(unsigned long long));
+	unsigned long long *c2 = (unsigned long long *)malloc(2*SignCodeWords(maxDim)*sizeof(unsigned long long));
+	if(!v1 || !v2 || !f1 || !f2 || !c1 || !c2) {
+		printf("Error: not enough memory\n");
+		free(v1); free(v2); free(f1); free(f2); free(c1); free(c2);
+		return 0;
+	}
+	for(i = 0; i < maxDim; i++) {
+		v1[i] = 2*RandomUniform(&seed)-1;
+		v2[i] = 2*RandomUniform(&seed)-1;
+		f1[i] = (float)v1[i];
+		f2[i] = (float)v2[i];
+	}
+
+	for(int kernel = 0; kernel < BENCH_KERNELS; kernel++) {
+		printf("%s, ns per call\n",benchKernelNames[kernel]);
+		printf("   dim");
+		for(int level = 0; level < numLevels; level++) printf(" %10s",benchLevelNames[level]);
+		if(numLevels > 1) printf("    speedup");
+		printf("\n");
+		for(long d = 0; d < numDims; d++) {
+			long n = dims[d];
+			//about 4M components per measurement
+			long calls = (4*1024*1024)/n;
+			GetSignCode(v1,n,c1);
+			GetSignCode(v2,n,c2);
+			printf("%6ld",n);
+			double scalarTime = 0, time = 0;
+			for(int level = 0; level < numLevels; level++) {
+				time = TimeDistanceKernel(&(kernels[level]),kernel,v1,v2,f1,f2,c1,c2,n,calls);
+				if(level == 0) scalarTime = time;
+				printf(" %10.1f",time);
+			}
+			if(numLevels > 1) printf(" %9.1fx",scalarTime/time);
+			printf("\n");
+		}
+		printf("\n");
+	}
+
+	free(v1); free(v2); free(f1); free(f2); free(c1); free(c2);
+	return 1;
+}
+
+#define BENCH_CONVERSIONS 8
+static const char *benchConversionNames[BENCH_CONVERSIONS] = {"uchar to double", "char to double", "int to double",
+	"float to double", "uchar to float", "char to float", "int to float", "double to float"};
+
+//calls the given conversion (an index in benchConversionNames) of n values calls times, 3 times,
+//and returns the shortest time in ns per call, the source values are taken from the array of their type
+double TimeConversion(int conversion, unsigned char *uc, signed char *c, int *in, float *f, double *d,
+	double *dstDouble, float *dstFloat, long n, long calls)
+{
+	double best = 0;
+	for(int repeat = 0; repeat < 3; repeat++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for(long i = 0; i < calls; i++) {
+			switch(conversion) {
+			case 0: ConvertToDouble(uc,dstDouble,n); break;
+			case 1: ConvertToDouble(c,dstDouble,n); break;
+			case 2: ConvertToDouble(in,dstDouble,n); break;
+			case 3: ConvertToDouble(f,dstDouble,n); break;
+			case 4: ConvertToFloat(uc,dstFloat,n); break;
+			case 5: ConvertToFloat(c,dstFloat,n); break;
+			case 6: ConvertToFloat(in,dstFloat,n); break;
+			case 7: ConvertToFloat(d,dstFloat,n); break;
+			}
+			//makes the result of each call observable, so that the calls are not optimized away
+			benchSink = (conversion < 4) ? dstDouble[i%n] : dstFloat[i%n];
+		}
+		double time = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count()*1e9/calls;
+		if(repeat == 0 || time < best) best = time;
+	}
+	return best;
+}
+
+//times the conversions of the sample types for the 'bench' task, with and without AVX2 instructions if they are supported
+//prints the time per call for 64 to 4096 values, and the speedup of the AVX2 code over the scalar code
+int BenchmarkConversions() {
+	long dims[] = {64, 128, 256, 512, 1024, 2048, 4096};
+	long numDims = sizeof(dims)/sizeof(long);
+	long maxDim = dims[numDims-1];
+	int numLevels = CpuSupportsAVX2() ? 2 : 1;
+	unsigned long long seed = 1;
+	long i;
+
+	unsigned char *uc = (unsigned char *)malloc(maxDim*sizeof(unsigned char));
+	signed char *c = (signed char *)malloc(maxDim*sizeof(signed char));
+	int *in = (int *)malloc(maxDim*sizeof(int));
+	float *f = (float *)malloc(maxDim*sizeof(float));
+	double *d = (double *)malloc(maxDim*sizeof(double));
+	double *dstDouble = (double *)malloc(maxDim*sizeof(double));
+	float *dstFloat = (float *)malloc(maxDim*sizeof(float));
+	if(!uc || !c || !in || !f || !d || !dstDouble || !dstFloat) {
+		printf("Error: not enough memory\n");
+		free(uc); free(c); free(in); free(f); free(d); free(dstDouble); free(dstFloat);
+		return 0;
+	}
+	for(i = 0; i < maxDim; i++) {
+		double r = RandomUniform(&seed);
+		uc[i] = (unsigned char)(r*256);
+		c[i] = (signed char)(r*256-128);
+		in[i] = (int)(r*2000000-1000000);
+		d[i] = 2*r-1;
+		f[i] = (float)d[i];
+	}
+
+	for(int conversion = 0; conversion < BENCH_CONVERSIONS; conversion++) {
+		printf("%s, ns per call\n",benchConversionNames[conversion]);
+		printf("   dim");
+		for(int level = 0; level < numLevels; level++) printf(" %10s",benchLevelNames[level]);
+		if(numLevels > 1) printf("    speedup");
+		printf("\n");
+		for(long j = 0; j < numDims; j++) {
+			long n = dims[j];
+			//about 4M values per measurement
+			long calls = (4*1024*1024)/n;
+			printf("%6ld",n);
+			double scalarTime = 0, time = 0;
+			for(int level = 0; level < numLevels; level++) {
+				LimitCpuLevel(level);
+				time = TimeConversion(conversion,uc,c,in,f,d,dstDouble,dstFloat,n,calls);
+				if(level == 0) scalarTime = time;
+				printf(" %10.1f",time);
+			}
+			LimitCpuLevel(CPU_LEVEL_AVX512);
+			if(numLevels > 1) printf(" %9.1fx",scalarTime/time);
+			printf("\n");
+		}
+		printf("\n");
+	}
+
+	free(uc); free(c); free(in); free(f); free(d); free(dstDouble); free(dstFloat);
+	return 1;
+}
+
 int main(int argc, char* argv[])
 {
 	if(argc<=1) {
@@ -629,6 +1459,11 @@ int main(int argc, char* argv[])
 		} else {
 			TestSubspace(argc,argv);
 		}
+	} else if(strcmp(argv[1],"convert")==0) {
+		ConvertSamples(argc,argv);
+	} else if(strcmp(argv[1],"bench")==0) {
+		BenchmarkKernels();
+		BenchmarkConversions();
 	} else {
 		PrintUsage(argv[0]);
 	}
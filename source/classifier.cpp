@@ -28,15 +28,73 @@
 #include "matrix.h"
 #include "sample.h"
 #include "classifier.h"
+#include "distance.h"
+#include "gemm.h"
+#include "hnsw.h"
+#include "ivfpq.h"
+#include "parallel.h"
+
+//the distance matrix is computed in tiles of this many test samples by this many base samples
+#define DISTANCE_MATRIX_BLOCK_SIZE 128
+
+//number of features whose sign mismatches are counted at once, when the sign codes of a gallery are not available
+#define SIGN_MISMATCH_BLOCK_SIZE 64
 
 namespace LibSubspace {
 
-double OneNNClassifier::DotProduct(double *v1, double *v2, long n) {
-	double dot = 0;
-	for(long i=0;i<n;i++) {
-		dot += v1[i]*v2[i];
+Gallery::Gallery(SampleSet *baseSamples, long dim) {
+	if((!dim)||(dim>(*baseSamples)[0].Size())) dim = (*baseSamples)[0].Size();
+	this->baseSamples = baseSamples;
+	this->floatBaseSamples = NULL;
+	this->dim = dim;
+	floatInvnorms = NULL;
+
+	const DistanceKernels *kernels = GetDistanceKernels();
+	invnorms = (double *)malloc(baseSamples->Size()*sizeof(double));
+	for(long i = 0; i < baseSamples->Size(); i++) {
+		double *v = baseSamples->GetSample(i)->GetData();
+		invnorms[i] = 1/sqrt(kernels->dot(v,v,dim));
+	}
+	signCodeWords = SignCodeWords(dim);
+	signCodes = NULL;
+}
+
+Gallery::Gallery(FloatSampleSet *baseSamples, long dim) {
+	if((!dim)||(dim>baseSamples->GetDim())) dim = baseSamples->GetDim();
+	this->baseSamples = NULL;
+	this->floatBaseSamples = baseSamples;
+	this->dim = dim;
+	invnorms = NULL;
+
+	const DistanceKernels *kernels = GetDistanceKernels();
+	floatInvnorms = (float *)malloc(baseSamples->Size()*sizeof(float));
+	for(long i = 0; i < baseSamples->Size(); i++) {
+		float *v = baseSamples->GetSampleData(i);
+		floatInvnorms[i] = 1/sqrtf(kernels->dotFloat(v,v,dim));
 	}
-	return dot;
+	signCodeWords = SignCodeWords(dim);
+	signCodes = NULL;
+}
+
+Gallery::~Gallery() {
+	if(invnorms) free(invnorms);
+	if(floatInvnorms) free(floatInvnorms);
+	if(signCodes) free(signCodes);
+}
+
+void Gallery::InitSignCodes() {
+	if(signCodes) return;
+	long n = baseSamples ? baseSamples->Size() : floatBaseSamples->Size();
+	signCodes = (unsigned long long *)malloc(n*2*signCodeWords*sizeof(unsigned long long));
+	for(long i = 0; i < n; i++) {
+		if(baseSamples) LibSubspace::GetSignCode(baseSamples->GetSample(i)->GetData(),dim,GetSignCode(i));
+		else LibSubspace::GetSignCode(floatBaseSamples->GetSampleData(i),dim,GetSignCode(i));
+	}
+}
+
+double OneNNClassifier::DotProduct(double *v1, double *v2, long n) {
+	double sqnorm;
+	return GetDistanceKernels()->dotProduct(v1,v2,n,&sqnorm);
 }
 
 double OneNNClassifier::Norm(double *v, long n) {
@@ -45,24 +103,17 @@ double OneNNClassifier::Norm(double *v, long n) {
 }
 
 double OneNNClassifier::EuclideanDistance(double *v1, double *v2, long n) {
-	double sum = 0,d;
-	for(long i=0;i<n;i++) {
-		d = v2[i]-v1[i];
-		sum += d*d;
-	}
-	return sqrt(sum);
+	return sqrt(GetDistanceKernels()->squaredEuclidean(v1,v2,n));
 }
 
 double OneNNClassifier::HammingDistance(double *v1, double *v2, long n) {
-	double sum = 0;
-	for(long i=0;i<n;i++) {
-		if(((v1[i]<0)&&(v2[i]>0))||((v1[i]>0)&&(v2[i]<0))) sum = sum+1;
-	}
-	return sum/n;
+	return ((double)GetDistanceKernels()->signMismatches(v1,v2,n))/n;
 }
 
 double OneNNClassifier::CosineDistance(double *v1, double *v2, long n) {
-	return 1-(DotProduct(v1,v2,n)/(Norm(v1,n)*Norm(v2,n)));
+	double sqnorm1;
+	double dot = GetDistanceKernels()->dotProduct(v1,v2,n,&sqnorm1);
+	return 1-(dot/(sqrt(sqnorm1)*Norm(v2,n)));
 }
 
 double OneNNClassifier::Distance(Sample *sample1, Sample *sample2, long dim) {
@@ -81,66 +132,839 @@ double OneNNClassifier::Distance(Sample *sample1, Sample *sample2, long dim) {
 	return dist;
 }
 
-char *OneNNClassifier::ClassifySample(Sample *testSample, SampleSet *baseSamples, long dim) {
-	int i;
-	Sample *closestsample = NULL;
+long OneNNClassifier::FindNearestSample(Sample *testSample, SampleSet *baseSamples, long dim, Gallery *gallery) {
+	long i;
+	long closest = -1;
+	long n = baseSamples->Size();
+	double *test = testSample->GetData();
+	const DistanceKernels *kernels = GetDistanceKernels();
 
+	//the distance measure is selected once, the loops compare the values that are monotonic in the distance:
+	//squared Euclidean distance and the number of sign mismatches
+	//the Euclidean and Hamming distances are computed by the bounded kernels, which stop as soon as a base sample
+	//is certain to be farther than the closest one so far; the features of a subspace are ordered by decreasing
+	//importance, so most base samples are rejected after the first blocks of features
 	double dist,mindist;
+	mindist = std::numeric_limits<double>::max();
 
+	if(distanceMeasure == DISTANCE_EUCLIDEAN) {
+		for(i = 0; i < n; i++) {
+			if(testSample == baseSamples->GetSample(i)) continue; //never compare sample to itself, enables leave-one-out tests
+			dist = kernels->squaredEuclideanBounded(baseSamples->GetSample(i)->GetData(),test,dim,mindist);
+			if(dist < mindist) {
+				mindist = dist;
+				closest = i;
+			}
+		}
+	} else if((distanceMeasure == DISTANCE_COSINE) && gallery) {
+		double *invnorms = gallery->GetInverseNorms();
+		double testInvNorm = 1/Norm(test,dim);
+		for(i = 0; i < n; i++) {
+			if(testSample == baseSamples->GetSample(i)) continue;
+			dist = 1-(kernels->dot(baseSamples->GetSample(i)->GetData(),test,dim)*invnorms[i]*testInvNorm);
+			if(dist < mindist) {
+				mindist = dist;
+				closest = i;
+			}
+		}
+	} else if(distanceMeasure == DISTANCE_COSINE) {
+		double testNorm = Norm(test,dim);
+		double sqnorm;
+		for(i = 0; i < n; i++) {
+			if(testSample == baseSamples->GetSample(i)) continue;
+			dist = 1-(kernels->dotProduct(baseSamples->GetSample(i)->GetData(),test,dim,&sqnorm)/(sqrt(sqnorm)*testNorm));
+			if(dist < mindist) {
+				mindist = dist;
+				closest = i;
+			}
+		}
+	} else if((distanceMeasure == DISTANCE_HAMMING) && gallery && gallery->HasSignCodes()) {
+		long words = gallery->GetSignCodeWords();
+		long mismatches,minmismatches = dim+1;
+		unsigned long long *testCode = (unsigned long long *)malloc(2*words*sizeof(unsigned long long));
+		GetSignCode(test,dim,testCode);
+		for(i = 0; i < n; i++) {
+			if(testSample == baseSamples->GetSample(i)) continue;
+			mismatches = kernels->signCodeMismatchesBounded(gallery->GetSignCode(i),testCode,words,minmismatches-1);
+			if(mismatches < minmismatches) {
+				minmismatches = mismatches;
+				closest = i;
+			}
+		}
+		free(testCode);
+	} else if(distanceMeasure == DISTANCE_HAMMING) {
+		long mismatches,minmismatches = dim+1;
+		for(i = 0; i < n; i++) {
+			if(testSample == baseSamples->GetSample(i)) continue;
+			//without sign codes, the mismatches are counted in blocks, stopping as the bounded kernels do
+			double *v = baseSamples->GetSample(i)->GetData();
+			mismatches = 0;
+			for(long j = 0; (j < dim) && (mismatches < minmismatches); j += SIGN_MISMATCH_BLOCK_SIZE) {
+				long size = (dim-j < SIGN_MISMATCH_BLOCK_SIZE) ? (dim-j) : SIGN_MISMATCH_BLOCK_SIZE;
+				mismatches += kernels->signMismatches(v+j,test+j,size);
+			}
+			if(mismatches < minmismatches) {
+				minmismatches = mismatches;
+				closest = i;
+			}
+		}
+	} else {
+		//all distances are 0, the first sample is the closest
+		for(i = 0; (i < n) && (closest < 0); i++) {
+			if(testSample != baseSamples->GetSample(i)) closest = i;
+		}
+	}
+
+	return closest;
+}
+
+char *OneNNClassifier::ClassifySample(Sample *testSample, SampleSet *baseSamples, long dim) {
 	if((!dim)||(dim>(*baseSamples)[0].Size())) dim = (*baseSamples)[0].Size();
 
-	mindist = std::numeric_limits<double>::max();
+	long closest = FindNearestSample(testSample,baseSamples,dim);
+	if(closest < 0) return NULL;
+
+	return baseSamples->GetSample(closest)->GetClassname();
+}
+
+char *OneNNClassifier::ClassifySample(Sample *testSample, Gallery *gallery) {
+	SampleSet *baseSamples = gallery->GetSamples();
+
+	long closest = FindNearestSample(testSample,baseSamples,gallery->GetDim(),gallery);
+	if(closest < 0) return NULL;
+
+	return baseSamples->GetSample(closest)->GetClassname();
+}
+
+void OneNNClassifier::ClassificationTestBody(long i, void *context) {
+	ClassificationTestLoop *loop = (ClassificationTestLoop *)context;
+	Gallery *gallery = loop->gallery;
+	if(loop->compressedIndex) {
+		if(!loop->compressedIndex->Search(loop->testSamples->GetSample(i)->GetData(), 1, &(loop->nearest[i]))) loop->nearest[i] = -1;
+	} else if(loop->index) {
+		long found;
+		if(loop->testSamples) {
+			found = loop->index->Search(loop->testSamples->GetSample(i)->GetData(), 1, &(loop->nearest[i]));
+		} else {
+			found = loop->index->Search(loop->floatTestSamples->GetSampleData(i), 1, &(loop->nearest[i]));
+		}
+		if(!found) loop->nearest[i] = -1;
+	} else if(loop->k) {
+		long *nearest = &(loop->nearest[i*loop->k]);
+		long found;
+		if(loop->testSamples) {
+			found = loop->classifier->FindNearestClasses(loop->testSamples->GetSample(i), gallery, loop->k, nearest, NULL);
+		} else {
+			found = loop->classifier->FindNearestClasses(loop->floatTestSamples->GetSampleData(i), gallery, loop->k, nearest, NULL);
+		}
+		for(; found < loop->k; found++) nearest[found] = -1;
+	} else if(loop->testSamples) {
+		loop->nearest[i] = loop->classifier->FindNearestSample(loop->testSamples->GetSample(i), gallery->GetSamples(), gallery->GetDim(), gallery);
+	} else {
+		loop->nearest[i] = loop->classifier->FindNearestSample(loop->floatTestSamples->GetSampleData(i), gallery->GetFloatSamples(), gallery->GetDim(), gallery);
+	}
+}
+
+float OneNNClassifier::GetAccuracy(SampleSet *baseSamples, SampleSet *testSamples, long *nearest) {
+	long i;
+	long numOK=0;
+	long closest;
+
+	//maps the class ids of the test set to the class ids of the base set, -1 if the class is not in the base set
+	long numTestClasses = testSamples->GetNumberOfClassIds();
+	long *baseClassId = (long *)malloc(numTestClasses*sizeof(long));
+	for(i = 0; i < numTestClasses; i++) {
+		baseClassId[i] = baseSamples->FindClassId(testSamples->GetClassnameById(i));
+	}
 
-	for(i = 0; i < baseSamples->Size(); i++) {
-		if(testSample == baseSamples->GetSample(i)) continue; //never compare sample to itself, enables leave-one-out tests
+	for(i = 0; i < testSamples->Size(); i++) {
 
-		dist = Distance(baseSamples->GetSample(i),testSample,dim);
+		closest = nearest[i];
 
-		if(dist < mindist) {
-			mindist = dist;
-			closestsample = baseSamples->GetSample(i);
+		if((closest >= 0) && (baseClassId[testSamples->GetClassId(i)] == baseSamples->GetClassId(closest))) {
+			numOK ++;
+		} else {
+			if(verbose) {
+				printf("Incorrect classification: %s <---> %s\n",testSamples->GetSample(i)->GetFilename(), (closest >= 0) ? baseSamples->GetSample(closest)->GetClassname() : "");
+			}
 		}
 	}
 
-	return closestsample->GetClassname();
+	free(baseClassId);
+	return ((float)numOK)/(testSamples->Size());
 }
 
 float OneNNClassifier::ClassificationTest(SampleSet *baseSamples, SampleSet *testSamples, long dim) {
-	int i;
+	if((!dim)||(dim>(*baseSamples)[0].Size())) dim = (*baseSamples)[0].Size();
+
+	//the nearest base samples are found in parallel, the results are then evaluated in order
+	long *nearest = (long *)malloc(testSamples->Size()*sizeof(long));
+	Gallery gallery(baseSamples,dim);
+	if(distanceMeasure == DISTANCE_HAMMING) gallery.InitSignCodes();
+	ClassificationTestLoop loop = {this,&gallery,testSamples,NULL,0,nearest,NULL,NULL};
+	ParallelFor(testSamples->Size(),numThreads,ClassificationTestBody,&loop);
+
+	float accuracy = GetAccuracy(baseSamples,testSamples,nearest);
+	free(nearest);
+	return accuracy;
+}
+
+char *OneNNClassifier::ClassifySample(Sample *testSample, HNSWIndex *index) {
+	long closest;
+	if(!index->Search(testSample->GetData(),1,&closest)) return NULL;
+
+	return index->GetGallery()->GetSamples()->GetSample(closest)->GetClassname();
+}
+
+float OneNNClassifier::ClassificationTest(HNSWIndex *index, SampleSet *testSamples) {
+	long *nearest = (long *)malloc(testSamples->Size()*sizeof(long));
+	ClassificationTestLoop loop = {this,index->GetGallery(),testSamples,NULL,0,nearest,index,NULL};
+	ParallelFor(testSamples->Size(),numThreads,ClassificationTestBody,&loop);
+
+	float accuracy = GetAccuracy(index->GetGallery()->GetSamples(),testSamples,nearest);
+	free(nearest);
+	return accuracy;
+}
+
+char *OneNNClassifier::ClassifySample(Sample *testSample, IVFPQIndex *index) {
+	long closest;
+	if(!index->Search(testSample->GetData(),1,&closest)) return NULL;
+
+	return index->GetBaseSamples()->GetSample(closest)->GetClassname();
+}
+
+float OneNNClassifier::ClassificationTest(IVFPQIndex *index, SampleSet *testSamples) {
+	long *nearest = (long *)malloc(testSamples->Size()*sizeof(long));
+	ClassificationTestLoop loop = {this,NULL,testSamples,NULL,0,nearest,NULL,index};
+	ParallelFor(testSamples->Size(),numThreads,ClassificationTestBody,&loop);
+
+	float accuracy = GetAccuracy(index->GetBaseSamples(),testSamples,nearest);
+	free(nearest);
+	return accuracy;
+}
+
+//bounded max-heap of the classes closest to a test sample found so far, the farthest of them is at the root
+//each class is kept once, with the distance of its closest base sample
+//of two samples at the same distance, the one with the lower index is closer, as in FindNearestSample
+struct NearestClassHeap {
+	long k;
+	long size;
+	double *dist;
+	long *index;
+	long *classid;
+
+	NearestClassHeap(long k) {
+		this->k = k;
+		size = 0;
+		dist = (double *)malloc(k*sizeof(double));
+		index = (long *)malloc(k*sizeof(long));
+		classid = (long *)malloc(k*sizeof(long));
+	}
+
+	~NearestClassHeap() {
+		free(dist);
+		free(index);
+		free(classid);
+	}
+
+	bool Farther(long a, long b) {
+		return (dist[a] > dist[b]) || ((dist[a] == dist[b]) && (index[a] > index[b]));
+	}
+
+	void Swap(long a, long b) {
+		double d = dist[a]; dist[a] = dist[b]; dist[b] = d;
+		long t = index[a]; index[a] = index[b]; index[b] = t;
+		t = classid[a]; classid[a] = classid[b]; classid[b] = t;
+	}
+
+	void SiftUp(long i) {
+		while((i > 0) && Farther(i,(i-1)/2)) {
+			Swap(i,(i-1)/2);
+			i = (i-1)/2;
+		}
+	}
+
+	//moves the element i down the heap of the first n elements
+	void SiftDown(long i, long n) {
+		for(;;) {
+			long child = 2*i+1;
+			if(child >= n) break;
+			if((child+1 < n) && Farther(child+1,child)) child++;
+			if(!Farther(child,i)) break;
+			Swap(i,child);
+			i = child;
+		}
+	}
+
+	//adds the i-th base sample, of class c, at distance d
+	//the samples must be added in order of increasing index
+	inline void Add(double d, long i, long c) {
+		//most samples are rejected here, once the heap is full
+		if((size == k) && (d >= dist[0])) return;
+
+		for(long j = 0; j < size; j++) {
+			if(classid[j] == c) {
+				if(d < dist[j]) {
+					dist[j] = d;
+					index[j] = i;
+					SiftDown(j,size);
+				}
+				return;
+			}
+		}
+
+		if(size < k) {
+			dist[size] = d;
+			index[size] = i;
+			classid[size] = c;
+			SiftUp(size);
+			size++;
+		} else {
+			dist[0] = d;
+			index[0] = i;
+			classid[0] = c;
+			SiftDown(0,size);
+		}
+	}
+
+	//sorts the classes by increasing distance, the heap can not be used after that
+	void Sort() {
+		for(long n = size-1; n > 0; n--) {
+			Swap(0,n);
+			SiftDown(0,n);
+		}
+	}
+};
+
+//copies the sorted classes of a heap into nearest and distances (if not NULL), returns the number of classes
+//the heap is ordered by the squared Euclidean distance and the number of sign mismatches, these are converted to distances
+static long GetNearestClasses(NearestClassHeap *heap, int distanceMeasure, long dim, long *nearest, double *distances) {
+	heap->Sort();
+	for(long i = 0; i < heap->size; i++) {
+		nearest[i] = heap->index[i];
+		if(!distances) continue;
+		if(distanceMeasure == DISTANCE_EUCLIDEAN) distances[i] = sqrt(heap->dist[i]);
+		else if(distanceMeasure == DISTANCE_HAMMING) distances[i] = heap->dist[i]/dim;
+		else distances[i] = heap->dist[i];
+	}
+	return heap->size;
+}
+
+long OneNNClassifier::FindNearestClasses(Sample *testSample, Gallery *gallery, long k, long *nearest, double *distances) {
+	long i;
+	SampleSet *baseSamples = gallery->GetSamples();
+	long n = baseSamples->Size();
+	long dim = gallery->GetDim();
+	double *test = testSample->GetData();
+	const DistanceKernels *kernels = GetDistanceKernels();
+	NearestClassHeap heap(k);
+
+	if(distanceMeasure == DISTANCE_EUCLIDEAN) {
+		for(i = 0; i < n; i++) {
+			if(testSample == baseSamples->GetSample(i)) continue;
+			heap.Add(kernels->squaredEuclidean(baseSamples->GetSample(i)->GetData(),test,dim),i,baseSamples->GetClassId(i));
+		}
+	} else if(distanceMeasure == DISTANCE_COSINE) {
+		double *invnorms = gallery->GetInverseNorms();
+		double testInvNorm = 1/Norm(test,dim);
+		for(i = 0; i < n; i++) {
+			if(testSample == baseSamples->GetSample(i)) continue;
+			heap.Add(1-(kernels->dot(baseSamples->GetSample(i)->GetData(),test,dim)*invnorms[i]*testInvNorm),i,baseSamples->GetClassId(i));
+		}
+	} else if((distanceMeasure == DISTANCE_HAMMING) && gallery->HasSignCodes()) {
+		long words = gallery->GetSignCodeWords();
+		unsigned long long *testCode = (unsigned long long *)malloc(2*words*sizeof(unsigned long long));
+		GetSignCode(test,dim,testCode);
+		for(i = 0; i < n; i++) {
+			if(testSample == baseSamples->GetSample(i)) continue;
+			heap.Add((double)kernels->signCodeMismatches(gallery->GetSignCode(i),testCode,words),i,baseSamples->GetClassId(i));
+		}
+		free(testCode);
+	} else if(distanceMeasure == DISTANCE_HAMMING) {
+		for(i = 0; i < n; i++) {
+			if(testSample == baseSamples->GetSample(i)) continue;
+			heap.Add((double)kernels->signMismatches(baseSamples->GetSample(i)->GetData(),test,dim),i,baseSamples->GetClassId(i));
+		}
+	} else {
+		for(i = 0; i < n; i++) {
+			if(testSample == baseSamples->GetSample(i)) continue;
+			heap.Add(0,i,baseSamples->GetClassId(i));
+		}
+	}
+
+	return GetNearestClasses(&heap,distanceMeasure,dim,nearest,distances);
+}
+
+long OneNNClassifier::IdentifySample(Sample *testSample, Gallery *gallery, long k, long *nearest, double *distances) {
+	return FindNearestClasses(testSample,gallery,k,nearest,distances);
+}
+
+float OneNNClassifier::IdentificationTest(SampleSet *baseSamples, SampleSet *testSamples, long k, float *cmc, long dim) {
+	long i,r;
+
+	if((!dim)||(dim>(*baseSamples)[0].Size())) dim = (*baseSamples)[0].Size();
+
+	long numTestClasses = testSamples->GetNumberOfClassIds();
+	long *baseClassId = (long *)malloc(numTestClasses*sizeof(long));
+	for(i = 0; i < numTestClasses; i++) {
+		baseClassId[i] = baseSamples->FindClassId(testSamples->GetClassnameById(i));
+	}
+
+	//the k nearest classes of each test sample are found in parallel
+	long *nearest = (long *)malloc(testSamples->Size()*k*sizeof(long));
+	Gallery gallery(baseSamples,dim);
+	if(distanceMeasure == DISTANCE_HAMMING) gallery.InitSignCodes();
+	ClassificationTestLoop loop = {this,&gallery,testSamples,NULL,k,nearest,NULL,NULL};
+	ParallelFor(testSamples->Size(),numThreads,ClassificationTestBody,&loop);
+
+	//number of test samples whose class is found at each rank
+	long *matches = (long *)calloc(k,sizeof(long));
+	for(i = 0; i < testSamples->Size(); i++) {
+		long *candidates = &(nearest[i*k]);
+		long classid = baseClassId[testSamples->GetClassId(i)];
+		long rank = -1;
+		for(r = 0; (r < k) && (candidates[r] >= 0); r++) {
+			if(baseSamples->GetClassId(candidates[r]) == classid) {
+				rank = r;
+				break;
+			}
+		}
+		if(rank >= 0) matches[rank]++;
+
+		if((rank != 0) && verbose) {
+			printf("Incorrect classification: %s <---> %s\n",testSamples->GetSample(i)->GetFilename(), (candidates[0] >= 0) ? baseSamples->GetSample(candidates[0])->GetClassname() : "");
+		}
+	}
+
+	long numOK = 0;
+	for(r = 0; r < k; r++) {
+		numOK += matches[r];
+		cmc[r] = ((float)numOK)/(testSamples->Size());
+	}
+
+	free(matches);
+	free(nearest);
+	free(baseClassId);
+	return cmc[0];
+}
+
+float OneNNClassifier::DotProduct(float *v1, float *v2, long n) {
+	float sqnorm;
+	return GetDistanceKernels()->dotProductFloat(v1,v2,n,&sqnorm);
+}
+
+float OneNNClassifier::Norm(float *v, long n) {
+	float dot = DotProduct(v,v,n);
+	return sqrtf(dot);
+}
+
+float OneNNClassifier::EuclideanDistance(float *v1, float *v2, long n) {
+	return sqrtf(GetDistanceKernels()->squaredEuclideanFloat(v1,v2,n));
+}
+
+float OneNNClassifier::HammingDistance(float *v1, float *v2, long n) {
+	return ((float)GetDistanceKernels()->signMismatchesFloat(v1,v2,n))/n;
+}
+
+float OneNNClassifier::CosineDistance(float *v1, float *v2, long n) {
+	float sqnorm1;
+	float dot = GetDistanceKernels()->dotProductFloat(v1,v2,n,&sqnorm1);
+	return 1-(dot/(sqrtf(sqnorm1)*Norm(v2,n)));
+}
+
+float OneNNClassifier::Distance(float *v1, float *v2, long dim) {
+	float dist;
+
+	if(distanceMeasure == DISTANCE_EUCLIDEAN) {
+		dist = EuclideanDistance(v1, v2, dim);
+	} else if (distanceMeasure == DISTANCE_COSINE) {
+		dist = CosineDistance(v1, v2, dim);
+	} else if (distanceMeasure == DISTANCE_HAMMING) {
+		dist = HammingDistance(v1, v2, dim);
+	} else dist = 0;
+
+	return dist;
+}
+
+long OneNNClassifier::FindNearestSample(float *testSample, FloatSampleSet *baseSamples, long dim, Gallery *gallery) {
+	long i;
+	long closest = -1;
+	long n = baseSamples->Size();
+	const DistanceKernels *kernels = GetDistanceKernels();
+
+	//as in the double precision version, the Euclidean and Hamming distances are computed by the bounded kernels
+	float dist,mindist;
+	mindist = std::numeric_limits<float>::max();
+
+	if(distanceMeasure == DISTANCE_EUCLIDEAN) {
+		for(i = 0; i < n; i++) {
+			if(testSample == baseSamples->GetSampleData(i)) continue; //never compare sample to itself, enables leave-one-out tests
+			dist = kernels->squaredEuclideanBoundedFloat(baseSamples->GetSampleData(i),testSample,dim,mindist);
+			if(dist < mindist) {
+				mindist = dist;
+				closest = i;
+			}
+		}
+	} else if((distanceMeasure == DISTANCE_COSINE) && gallery) {
+		float *invnorms = gallery->GetFloatInverseNorms();
+		float testInvNorm = 1/Norm(testSample,dim);
+		for(i = 0; i < n; i++) {
+			if(testSample == baseSamples->GetSampleData(i)) continue;
+			dist = 1-(kernels->dotFloat(baseSamples->GetSampleData(i),testSample,dim)*invnorms[i]*testInvNorm);
+			if(dist < mindist) {
+				mindist = dist;
+				closest = i;
+			}
+		}
+	} else if(distanceMeasure == DISTANCE_COSINE) {
+		float testNorm = Norm(testSample,dim);
+		float sqnorm;
+		for(i = 0; i < n; i++) {
+			if(testSample == baseSamples->GetSampleData(i)) continue;
+			dist = 1-(kernels->dotProductFloat(baseSamples->GetSampleData(i),testSample,dim,&sqnorm)/(sqrtf(sqnorm)*testNorm));
+			if(dist < mindist) {
+				mindist = dist;
+				closest = i;
+			}
+		}
+	} else if((distanceMeasure == DISTANCE_HAMMING) && gallery && gallery->HasSignCodes()) {
+		long words = gallery->GetSignCodeWords();
+		long mismatches,minmismatches = dim+1;
+		unsigned long long *testCode = (unsigned long long *)malloc(2*words*sizeof(unsigned long long));
+		GetSignCode(testSample,dim,testCode);
+		for(i = 0; i < n; i++) {
+			if(testSample == baseSamples->GetSampleData(i)) continue;
+			mismatches = kernels->signCodeMismatchesBounded(gallery->GetSignCode(i),testCode,words,minmismatches-1);
+			if(mismatches < minmismatches) {
+				minmismatches = mismatches;
+				closest = i;
+			}
+		}
+		free(testCode);
+	} else if(distanceMeasure == DISTANCE_HAMMING) {
+		long mismatches,minmismatches = dim+1;
+		for(i = 0; i < n; i++) {
+			if(testSample == baseSamples->GetSampleData(i)) continue;
+			float *v = baseSamples->GetSampleData(i);
+			mismatches = 0;
+			for(long j = 0; (j < dim) && (mismatches < minmismatches); j += SIGN_MISMATCH_BLOCK_SIZE) {
+				long size = (dim-j < SIGN_MISMATCH_BLOCK_SIZE) ? (dim-j) : SIGN_MISMATCH_BLOCK_SIZE;
+				mismatches += kernels->signMismatchesFloat(v+j,testSample+j,size);
+			}
+			if(mismatches < minmismatches) {
+				minmismatches = mismatches;
+				closest = i;
+			}
+		}
+	} else {
+		for(i = 0; (i < n) && (closest < 0); i++) {
+			if(testSample != baseSamples->GetSampleData(i)) closest = i;
+		}
+	}
+
+	return closest;
+}
+
+char *OneNNClassifier::ClassifySample(float *testSample, FloatSampleSet *baseSamples, long dim) {
+	if((!dim)||(dim>baseSamples->GetDim())) dim = baseSamples->GetDim();
+
+	long closest = FindNearestSample(testSample,baseSamples,dim);
+	if(closest < 0) return NULL;
+
+	return baseSamples->GetClassname(closest);
+}
+
+char *OneNNClassifier::ClassifySample(float *testSample, Gallery *gallery) {
+	FloatSampleSet *baseSamples = gallery->GetFloatSamples();
+
+	long closest = FindNearestSample(testSample,baseSamples,gallery->GetDim(),gallery);
+	if(closest < 0) return NULL;
+
+	return baseSamples->GetClassname(closest);
+}
+
+float OneNNClassifier::GetAccuracy(FloatSampleSet *baseSamples, FloatSampleSet *testSamples, long *nearest) {
+	long i;
 	long numOK=0;
-	char *claimedClass;
+	long closest;
+
+	//maps the class ids of the test set to the class ids of the base set, -1 if the class is not in the base set
+	long numTestClasses = testSamples->GetNumberOfClassIds();
+	long *baseClassId = (long *)malloc(numTestClasses*sizeof(long));
+	for(i = 0; i < numTestClasses; i++) {
+		baseClassId[i] = baseSamples->FindClassId(testSamples->GetClassnameById(i));
+	}
 
 	for(i = 0; i < testSamples->Size(); i++) {
-	
-		claimedClass = ClassifySample(testSamples->GetSample(i), baseSamples, dim);
 
-		if(strcmp(testSamples->GetSample(i)->GetClassname(),claimedClass)==0) {
+		closest = nearest[i];
+
+		if((closest >= 0) && (baseClassId[testSamples->GetClassId(i)] == baseSamples->GetClassId(closest))) {
 			numOK ++;
 		} else {
 			if(verbose) {
-				printf("Incorrect classification: %s <---> %s\n",testSamples->GetSample(i)->GetFilename(), claimedClass);
+				printf("Incorrect classification: %s <---> %s\n",testSamples->GetFilename(i), (closest >= 0) ? baseSamples->GetClassname(closest) : "");
 			}
 		}
 	}
+
+	free(baseClassId);
 	return ((float)numOK)/(testSamples->Size());
 }
 
+float OneNNClassifier::ClassificationTest(FloatSampleSet *baseSamples, FloatSampleSet *testSamples, long dim) {
+	if((!dim)||(dim>baseSamples->GetDim())) dim = baseSamples->GetDim();
+
+	long *nearest = (long *)malloc(testSamples->Size()*sizeof(long));
+	Gallery gallery(baseSamples,dim);
+	if(distanceMeasure == DISTANCE_HAMMING) gallery.InitSignCodes();
+	ClassificationTestLoop loop = {this,&gallery,NULL,testSamples,0,nearest,NULL,NULL};
+	ParallelFor(testSamples->Size(),numThreads,ClassificationTestBody,&loop);
+
+	float accuracy = GetAccuracy(baseSamples,testSamples,nearest);
+	free(nearest);
+	return accuracy;
+}
+
+char *OneNNClassifier::ClassifySample(float *testSample, HNSWIndex *index) {
+	long closest;
+	if(!index->Search(testSample,1,&closest)) return NULL;
+
+	return index->GetGallery()->GetFloatSamples()->GetClassname(closest);
+}
+
+float OneNNClassifier::ClassificationTest(HNSWIndex *index, FloatSampleSet *testSamples) {
+	long *nearest = (long *)malloc(testSamples->Size()*sizeof(long));
+	ClassificationTestLoop loop = {this,index->GetGallery(),NULL,testSamples,0,nearest,index,NULL};
+	ParallelFor(testSamples->Size(),numThreads,ClassificationTestBody,&loop);
+
+	float accuracy = GetAccuracy(index->GetGallery()->GetFloatSamples(),testSamples,nearest);
+	free(nearest);
+	return accuracy;
+}
+
+long OneNNClassifier::FindNearestClasses(float *testSample, Gallery *gallery, long k, long *nearest, double *distances) {
+	long i;
+	FloatSampleSet *baseSamples = gallery->GetFloatSamples();
+	long n = baseSamples->Size();
+	long dim = gallery->GetDim();
+	const DistanceKernels *kernels = GetDistanceKernels();
+	NearestClassHeap heap(k);
+
+	if(distanceMeasure == DISTANCE_EUCLIDEAN) {
+		for(i = 0; i < n; i++) {
+			if(testSample == baseSamples->GetSampleData(i)) continue;
+			heap.Add(kernels->squaredEuclideanFloat(baseSamples->GetSampleData(i),testSample,dim),i,baseSamples->GetClassId(i));
+		}
+	} else if(distanceMeasure == DISTANCE_COSINE) {
+		float *invnorms = gallery->GetFloatInverseNorms();
+		float testInvNorm = 1/Norm(testSample,dim);
+		for(i = 0; i < n; i++) {
+			if(testSample == baseSamples->GetSampleData(i)) continue;
+			float dist = 1-(kernels->dotFloat(baseSamples->GetSampleData(i),testSample,dim)*invnorms[i]*testInvNorm);
+			heap.Add(dist,i,baseSamples->GetClassId(i));
+		}
+	} else if((distanceMeasure == DISTANCE_HAMMING) && gallery->HasSignCodes()) {
+		long words = gallery->GetSignCodeWords();
+		unsigned long long *testCode = (unsigned long long *)malloc(2*words*sizeof(unsigned long long));
+		GetSignCode(testSample,dim,testCode);
+		for(i = 0; i < n; i++) {
+			if(testSample == baseSamples->GetSampleData(i)) continue;
+			heap.Add((double)kernels->signCodeMismatches(gallery->GetSignCode(i),testCode,words),i,baseSamples->GetClassId(i));
+		}
+		free(testCode);
+	} else if(distanceMeasure == DISTANCE_HAMMING) {
+		for(i = 0; i < n; i++) {
+			if(testSample == baseSamples->GetSampleData(i)) continue;
+			heap.Add((double)kernels->signMismatchesFloat(baseSamples->GetSampleData(i),testSample,dim),i,baseSamples->GetClassId(i));
+		}
+	} else {
+		for(i = 0; i < n; i++) {
+			if(testSample == baseSamples->GetSampleData(i)) continue;
+			heap.Add(0,i,baseSamples->GetClassId(i));
+		}
+	}
+
+	return GetNearestClasses(&heap,distanceMeasure,dim,nearest,distances);
+}
+
+long OneNNClassifier::IdentifySample(float *testSample, Gallery *gallery, long k, long *nearest, float *distances) {
+	double *d = distances ? (double *)malloc(k*sizeof(double)) : NULL;
+	long found = FindNearestClasses(testSample,gallery,k,nearest,d);
+	if(d) {
+		for(long i = 0; i < found; i++) distances[i] = (float)d[i];
+		free(d);
+	}
+	return found;
+}
+
+float OneNNClassifier::IdentificationTest(FloatSampleSet *baseSamples, FloatSampleSet *testSamples, long k, float *cmc, long dim) {
+	long i,r;
+
+	if((!dim)||(dim>baseSamples->GetDim())) dim = baseSamples->GetDim();
+
+	long numTestClasses = testSamples->GetNumberOfClassIds();
+	long *baseClassId = (long *)malloc(numTestClasses*sizeof(long));
+	for(i = 0; i < numTestClasses; i++) {
+		baseClassId[i] = baseSamples->FindClassId(testSamples->GetClassnameById(i));
+	}
+
+	long *nearest = (long *)malloc(testSamples->Size()*k*sizeof(long));
+	Gallery gallery(baseSamples,dim);
+	if(distanceMeasure == DISTANCE_HAMMING) gallery.InitSignCodes();
+	ClassificationTestLoop loop = {this,&gallery,NULL,testSamples,k,nearest,NULL,NULL};
+	ParallelFor(testSamples->Size(),numThreads,ClassificationTestBody,&loop);
+
+	long *matches = (long *)calloc(k,sizeof(long));
+	for(i = 0; i < testSamples->Size(); i++) {
+		long *candidates = &(nearest[i*k]);
+		long classid = baseClassId[testSamples->GetClassId(i)];
+		long rank = -1;
+		for(r = 0; (r < k) && (candidates[r] >= 0); r++) {
+			if(baseSamples->GetClassId(candidates[r]) == classid) {
+				rank = r;
+				break;
+			}
+		}
+		if(rank >= 0) matches[rank]++;
+
+		if((rank != 0) && verbose) {
+			printf("Incorrect classification: %s <---> %s\n",testSamples->GetFilename(i), (candidates[0] >= 0) ? baseSamples->GetClassname(candidates[0]) : "");
+		}
+	}
+
+	long numOK = 0;
+	for(r = 0; r < k; r++) {
+		numOK += matches[r];
+		cmc[r] = ((float)numOK)/(testSamples->Size());
+	}
+
+	free(matches);
+	free(nearest);
+	free(baseClassId);
+	return cmc[0];
+}
+
 void OneNNClassifier::GetDistanceMatrix(Matrix *matrix, SampleSet *baseSamples, SampleSet *testSamples, long dim) {
-	int i,j;
-	double dist;
+	Gallery gallery(baseSamples,dim);
+	if(distanceMeasure == DISTANCE_HAMMING) gallery.InitSignCodes();
+	GetDistanceMatrix(matrix,&gallery,testSamples);
+}
 
-	matrix->Init(testSamples->Size(), baseSamples->Size());
+void OneNNClassifier::GetDistanceMatrix(Matrix *matrix, Gallery *gallery, SampleSet *testSamples) {
+	long i,j;
+	SampleSet *baseSamples = gallery->GetSamples();
+	long dim = gallery->GetDim();
+	double *invnorms = gallery->GetInverseNorms();
+	const DistanceKernels *kernels = GetDistanceKernels();
+	long words = gallery->GetSignCodeWords();
+	unsigned long long *testCode = (unsigned long long *)malloc(2*words*sizeof(unsigned long long));
 
-	if((!dim)||(dim>(*baseSamples)[0].Size())) dim = (*baseSamples)[0].Size();
+	if(!exactDistances && ((distanceMeasure == DISTANCE_EUCLIDEAN) || (distanceMeasure == DISTANCE_COSINE))) {
+		GetDistanceMatrixGemm(matrix,gallery,testSamples);
+		free(testCode);
+		return;
+	}
+
+	matrix->Init(testSamples->Size(), baseSamples->Size());
 
 	for(i = 0; i < testSamples->Size(); i++) {
-		for(j = 0; j < baseSamples->Size(); j++) {
+		double *test = testSamples->GetSample(i)->GetData();
+		double *row = (*matrix)[i];
+
+		if(distanceMeasure == DISTANCE_EUCLIDEAN) {
+			for(j = 0; j < baseSamples->Size(); j++) {
+				row[j] = sqrt(kernels->squaredEuclidean(baseSamples->GetSample(j)->GetData(),test,dim));
+			}
+		} else if(distanceMeasure == DISTANCE_COSINE) {
+			double testInvNorm = 1/Norm(test,dim);
+			for(j = 0; j < baseSamples->Size(); j++) {
+				row[j] = 1-(kernels->dot(baseSamples->GetSample(j)->GetData(),test,dim)*invnorms[j]*testInvNorm);
+			}
+		} else if((distanceMeasure == DISTANCE_HAMMING) && gallery->HasSignCodes()) {
+			GetSignCode(test,dim,testCode);
+			for(j = 0; j < baseSamples->Size(); j++) {
+				row[j] = ((double)kernels->signCodeMismatches(gallery->GetSignCode(j),testCode,words))/dim;
+			}
+		} else if(distanceMeasure == DISTANCE_HAMMING) {
+			for(j = 0; j < baseSamples->Size(); j++) {
+				row[j] = ((double)kernels->signMismatches(baseSamples->GetSample(j)->GetData(),test,dim))/dim;
+			}
+		}
+	}
+
+	free(testCode);
+}
+
+//copies the first dim features of n samples, starting with sample first, into the rows of block
+static void PackSamples(SampleSet *samples, long first, long n, long dim, double *block) {
+	for(long i = 0; i < n; i++) {
+		memcpy(&(block[i*dim]),samples->GetSample(first+i)->GetData(),dim*sizeof(double));
+	}
+}
+
+void OneNNClassifier::GetDistanceMatrixGemm(Matrix *matrix, Gallery *gallery, SampleSet *testSamples) {
+	long i,j,k,l;
+	SampleSet *baseSamples = gallery->GetSamples();
+	long dim = gallery->GetDim();
+	long numTest = testSamples->Size();
+	long numBase = baseSamples->Size();
+	double *invnorms = gallery->GetInverseNorms();
+	const DistanceKernels *kernels = GetDistanceKernels();
+	bool euclidean = (distanceMeasure == DISTANCE_EUCLIDEAN);
+
+	matrix->Init(numTest, numBase);
+	if((numTest == 0) || (numBase == 0)) return;
 
-			dist = Distance(baseSamples->GetSample(j),testSamples->GetSample(i),dim);
+	//squared norms of the base samples (Euclidean) or their inverse norms (cosine)
+	double *baseNorms = invnorms;
+	if(euclidean) {
+		baseNorms = (double *)malloc(numBase*sizeof(double));
+		for(j = 0; j < numBase; j++) {
+			double *v = baseSamples->GetSample(j)->GetData();
+			baseNorms[j] = kernels->dot(v,v,dim);
+		}
+	}
+
+	double *testBlock = (double *)malloc(DISTANCE_MATRIX_BLOCK_SIZE*dim*sizeof(double));
+	double *baseBlock = (double *)malloc(DISTANCE_MATRIX_BLOCK_SIZE*dim*sizeof(double));
+	double testNorms[DISTANCE_MATRIX_BLOCK_SIZE];
+
+	for(i = 0; i < numTest; i += DISTANCE_MATRIX_BLOCK_SIZE) {
+		long nt = (numTest-i < DISTANCE_MATRIX_BLOCK_SIZE) ? (numTest-i) : DISTANCE_MATRIX_BLOCK_SIZE;
+		PackSamples(testSamples,i,nt,dim,testBlock);
+		for(k = 0; k < nt; k++) {
+			double *v = &(testBlock[k*dim]);
+			testNorms[k] = kernels->dot(v,v,dim);
+			if(!euclidean) testNorms[k] = 1/sqrt(testNorms[k]);
+		}
+
+		for(j = 0; j < numBase; j += DISTANCE_MATRIX_BLOCK_SIZE) {
+			long nb = (numBase-j < DISTANCE_MATRIX_BLOCK_SIZE) ? (numBase-j) : DISTANCE_MATRIX_BLOCK_SIZE;
+			PackSamples(baseSamples,j,nb,dim,baseBlock);
 
-			(*matrix)[i][j] = dist;
+			//the tile of dot products is written directly into the matrix and finished while it is still in cache
+			double *tile = &((*matrix)[i][j]);
+			gemm(GEMM_NOTRANS,GEMM_TRANS,nt,nb,dim,euclidean ? -2.0 : 1.0,testBlock,dim,baseBlock,dim,0.0,tile,numBase);
+			for(k = 0; k < nt; k++) {
+				double *row = &(tile[k*numBase]);
+				if(euclidean) {
+					for(l = 0; l < nb; l++) {
+						double d = row[l] + testNorms[k] + baseNorms[j+l];
+						row[l] = (d > 0) ? sqrt(d) : 0;
+					}
+				} else {
+					for(l = 0; l < nb; l++) {
+						row[l] = 1-(row[l]*baseNorms[j+l]*testNorms[k]);
+					}
+				}
+			}
 		}
 	}
+
+	free(baseBlock);
+	free(testBlock);
+	if(euclidean) free(baseNorms);
 }
 
 } //namespace
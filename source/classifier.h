@@ -24,6 +24,82 @@
 
 namespace LibSubspace {
 
+//base samples prepared for repeated matching with a OneNNClassifier
+//the inverse norms of the base samples are computed once, when the gallery is created,
+//so that the cosine distance of a test sample to a base sample needs a single dot product
+//for the Hamming distance, the signs of the base sample components can be packed into sign codes
+//(see GetSignCode in distance.h, InitSignCodes), so that the distance is computed by counting bits
+//the gallery refers to the base samples, which must not be changed or deleted while the gallery is used
+class Gallery {
+protected:
+	SampleSet *baseSamples;
+	FloatSampleSet *floatBaseSamples;
+	long dim;
+	double *invnorms;
+	float *floatInvnorms;
+	long signCodeWords;
+	unsigned long long *signCodes;	//NULL until InitSignCodes is called
+
+public:
+	//prepares a gallery of double or single precision base samples
+	//dim : sample dimensionality, if 0 the dimensionality of the first base sample will be used
+	Gallery(SampleSet *baseSamples, long dim = 0);
+	Gallery(FloatSampleSet *baseSamples, long dim = 0);
+	~Gallery();
+
+	//returns the base samples, NULL if the gallery was created from the samples of the other precision
+	SampleSet *GetSamples() {
+		return baseSamples;
+	}
+
+	FloatSampleSet *GetFloatSamples() {
+		return floatBaseSamples;
+	}
+
+	//returns the dimensionality used for matching
+	long GetDim() {
+		return dim;
+	}
+
+	//returns the number of base samples
+	long Size() {
+		return baseSamples ? baseSamples->Size() : floatBaseSamples->Size();
+	}
+
+	//returns the array of inverse norms of the base samples, in the precision of the base samples
+	double *GetInverseNorms() {
+		return invnorms;
+	}
+
+	float *GetFloatInverseNorms() {
+		return floatInvnorms;
+	}
+
+	//computes the sign codes of the base samples, if they have not been computed yet
+	//the codes use 2 bits per feature and are only needed for the Hamming distance, so they are not computed
+	//by the constructors, without them the Hamming distance is computed from the features
+	//must not be called while the gallery is used by other threads
+	void InitSignCodes();
+
+	//returns true if the sign codes have been computed
+	bool HasSignCodes() {
+		return signCodes != NULL;
+	}
+
+	//returns the number of 64-bit words of negative (and of positive) sign bits of each sample
+	long GetSignCodeWords() {
+		return signCodeWords;
+	}
+
+	//returns the sign code of the i-th base sample, 2*GetSignCodeWords() words
+	unsigned long long *GetSignCode(long i) {
+		return &(signCodes[2*i*signCodeWords]);
+	}
+};
+
+class HNSWIndex;
+class IVFPQIndex;
+
 //implements a one-NN (nearest neighbor) classifier
 class OneNNClassifier {
 protected:
@@ -43,11 +119,57 @@ protected:
 	//only looks at the signs of vector components
 	double HammingDistance(double *v1, double *v2, long n);
 
+	//computes the Euclidean or cosine distance matrix for GetDistanceMatrix from matrix products of blocks of samples
+	void GetDistanceMatrixGemm(Matrix *matrix, Gallery *gallery, SampleSet *testSamples);
+
 	//returns the distance between sample1 and sample 2
 	//only the first dim components are considered
 	//if dim=0, use the dimensionality of sample1
 	double Distance(Sample *sample1, Sample *sample2, long dim = 0);
 
+	//returns the index of the base sample closest to testSample, -1 if there is none
+	//dim must be set to the actual dimensionality to be used
+	//if a gallery prepared from baseSamples with the same dim is given, its inverse norms and sign codes (if computed) are used
+	long FindNearestSample(Sample *testSample, SampleSet *baseSamples, long dim, Gallery *gallery = NULL);
+
+	//single precision versions of the above, used with FloatSampleSet
+	//the sums are accumulated in single precision
+	float DotProduct(float *v1, float *v2, long n);
+	float Norm(float *v, long n);
+	float EuclideanDistance(float *v1, float *v2, long n);
+	float CosineDistance(float *v1, float *v2, long n);
+	float HammingDistance(float *v1, float *v2, long n);
+	float Distance(float *v1, float *v2, long dim);
+	long FindNearestSample(float *testSample, FloatSampleSet *baseSamples, long dim, Gallery *gallery = NULL);
+
+	//finds the k classes of the gallery closest to testSample in a single pass over the base samples,
+	//keeping a bounded heap of the closest classes found so far
+	//a class is represented by its base sample closest to testSample
+	//nearest receives the indices of these base samples, ordered by increasing distance,
+	//distances (if not NULL) their distances, returns the number of classes found (at most k)
+	long FindNearestClasses(Sample *testSample, Gallery *gallery, long k, long *nearest, double *distances);
+	long FindNearestClasses(float *testSample, Gallery *gallery, long k, long *nearest, double *distances);
+
+	//state of a parallel classification test, either the double or the single precision sets are set
+	struct ClassificationTestLoop {
+		OneNNClassifier *classifier;
+		Gallery *gallery;
+		SampleSet *testSamples;
+		FloatSampleSet *floatTestSamples;
+		long k;	//number of nearest classes found for each test sample, 0 to find only the nearest base sample
+		long *nearest;	//index of the nearest base sample for each test sample, or k indices (see FindNearestClasses)
+		HNSWIndex *index;	//if not NULL, the nearest base samples are searched for in this index instead of the gallery
+		IVFPQIndex *compressedIndex;	//if not NULL, the nearest base samples are searched for in this index
+	};
+
+	//finds the nearest base sample for the i-th test sample of a ClassificationTestLoop
+	static void ClassificationTestBody(long i, void *context);
+
+	//returns the fraction of test samples whose nearest base sample (-1 if none) is of the same class
+	//if verbose is set, prints the incorrectly classified samples
+	float GetAccuracy(SampleSet *baseSamples, SampleSet *testSamples, long *nearest);
+	float GetAccuracy(FloatSampleSet *baseSamples, FloatSampleSet *testSamples, long *nearest);
+
 public:
 	//distance measure to be used, by default DISTANCE_EUCLIDEAN
 	int distanceMeasure;
@@ -55,9 +177,19 @@ public:
 	//outputs details of errorneous classifications
 	bool verbose;
 
+	//number of threads used by ClassificationTest, 0 (default) for one thread per processor
+	//the test samples are distributed between the threads, the result does not depend on the number of threads
+	int numThreads;
+
+	//if true, GetDistanceMatrix computes every distance individually instead of using a matrix product
+	//false by default (see GetDistanceMatrix)
+	bool exactDistances;
+
 	OneNNClassifier() {
 		distanceMeasure = DISTANCE_EUCLIDEAN;
 		verbose = false;
+		numThreads = 0;
+		exactDistances = false;
 	}
 
 	//classifies sample testSample and returns a pointer to the claimed class name
@@ -67,6 +199,10 @@ public:
 	//   dim : sample dimensionality, if 0 the dimensionality of the first base sample will be used
 	char *ClassifySample(Sample *testSample, SampleSet *baseSamples, long dim = 0);
 
+	//classifies sample testSample using a prepared gallery of base samples
+	//this is faster than the above when many samples are classified using cosine distance
+	char *ClassifySample(Sample *testSample, Gallery *gallery);
+
 
 	//performs a classification test, returns classification accuracy
 	//parameters:
@@ -75,13 +211,65 @@ public:
 	//   dim : sample dimensionality, if 0 the dimensionality of the first base sample will be used
 	float ClassificationTest(SampleSet *baseSamples, SampleSet *testSamples, long dim = 0);
 
+	//single precision versions of ClassifySample and ClassificationTest
+	//testSample is a feature vector of at least dim elements
+	char *ClassifySample(float *testSample, FloatSampleSet *baseSamples, long dim = 0);
+	char *ClassifySample(float *testSample, Gallery *gallery);
+	float ClassificationTest(FloatSampleSet *baseSamples, FloatSampleSet *testSamples, long dim = 0);
+
+	//classify samples using an approximate nearest neighbor index of the base samples (see HNSWIndex),
+	//which is much faster for large galleries, but does not always find the nearest base sample
+	//the distance measure of the index is used instead of distanceMeasure
+	char *ClassifySample(Sample *testSample, HNSWIndex *index);
+	char *ClassifySample(float *testSample, HNSWIndex *index);
+	float ClassificationTest(HNSWIndex *index, SampleSet *testSamples);
+	float ClassificationTest(HNSWIndex *index, FloatSampleSet *testSamples);
+
+	//classify samples using a compressed index of the base samples (see IVFPQIndex),
+	//which needs much less memory than the feature vectors, but does not always find the nearest base sample
+	//the distance measure of the index is used instead of distanceMeasure
+	char *ClassifySample(Sample *testSample, IVFPQIndex *index);
+	float ClassificationTest(IVFPQIndex *index, SampleSet *testSamples);
+
+	//finds the k classes closest to testSample, the candidates of an identification
+	//parameters:
+	//   testSample : sample to be identified
+	//   gallery : prepared gallery of base samples
+	//   k : maximum number of classes to be returned
+	//   nearest : array of k elements, receives the indices of the base samples closest to testSample,
+	//             one for each class, ordered by increasing distance
+	//   distances : array of k elements that receives the distances of these samples, can be NULL
+	//returns the number of classes found, smaller than k if the gallery has fewer classes
+	//the class of nearest[0] is the class returned by ClassifySample
+	long IdentifySample(Sample *testSample, Gallery *gallery, long k, long *nearest, double *distances = NULL);
+	long IdentifySample(float *testSample, Gallery *gallery, long k, long *nearest, float *distances = NULL);
+
+	//performs an identification test and computes the cumulative match characteristic (CMC)
+	//the k closest classes of each test sample are found with a single pass over the base samples
+	//parameters:
+	//   baseSamples : database samples, used for comparison with the testSamples
+	//   testSamples : probe samples
+	//   k : highest rank computed
+	//   cmc : array of k elements, cmc[r] receives the fraction of test samples
+	//         whose class is among the r+1 classes closest to them (rank-(r+1) accuracy)
+	//   dim : sample dimensionality, if 0 the dimensionality of the first base sample will be used
+	//returns the rank-1 accuracy, the same as ClassificationTest
+	float IdentificationTest(SampleSet *baseSamples, SampleSet *testSamples, long k, float *cmc, long dim = 0);
+	float IdentificationTest(FloatSampleSet *baseSamples, FloatSampleSet *testSamples, long k, float *cmc, long dim = 0);
+
 	//computes a distance matrix between two sample sets
 	//an element (i,j) of the score matrix will be the distance of the i-th test sample to the j-th base sample
+	//unless exactDistances is set, Euclidean and cosine distances are computed as |a|^2+|b|^2-2*a'b and 1-a'b/(|a|*|b|)
+	//using a blocked matrix product, the Euclidean distances then lose accuracy for very close samples
+	//(the absolute error of the squared distance is on the order of DBL_EPSILON*(|a|^2+|b|^2))
 	//parameters:
 	//   baseSamples : database samples
 	//   testSamples : probe samples
 	//   dim : sample dimensionality, if 0 the dimensionality of the first base sample will be used
 	void GetDistanceMatrix(Matrix *matrix, SampleSet *baseSamples, SampleSet *testSamples, long dim = 0);
+
+	//computes a distance matrix between a prepared gallery of base samples and the test samples
+	void GetDistanceMatrix(Matrix *matrix, Gallery *gallery, SampleSet *testSamples);
 };
 
 } //namespace
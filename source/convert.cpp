@@ -0,0 +1,199 @@
+//Copyright (C) 2011 by Ivan Fratric
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in
+//all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//THE SOFTWARE.
+
+#include "convert.h"
+#include "cpu.h"
+
+#ifdef LIBSUBSPACE_X86
+#include <immintrin.h>
+#endif
+
+namespace LibSubspace {
+
+//the AVX2 kernels convert the largest multiple of their block size and return the number of values converted
+//each block is loaded completely before it is stored, which keeps the in-place conversions correct
+
+#ifdef LIBSUBSPACE_X86
+
+LIBSUBSPACE_TARGET_AVX2 static long ConvertUCharToDoubleAVX2(unsigned char *src, double *dst, long n) {
+	long i;
+	for(i=0;i+16<=n;i+=16) {
+		__m128i v = _mm_loadu_si128((__m128i *)(src+i));
+		__m256d d0 = _mm256_cvtepi32_pd(_mm_cvtepu8_epi32(v));
+		__m256d d1 = _mm256_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_srli_si128(v,4)));
+		__m256d d2 = _mm256_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_srli_si128(v,8)));
+		__m256d d3 = _mm256_cvtepi32_pd(_mm_cvtepu8_epi32(_mm_srli_si128(v,12)));
+		_mm256_storeu_pd(dst+i,d0);
+		_mm256_storeu_pd(dst+i+4,d1);
+		_mm256_storeu_pd(dst+i+8,d2);
+		_mm256_storeu_pd(dst+i+12,d3);
+	}
+	return i;
+}
+
+LIBSUBSPACE_TARGET_AVX2 static long ConvertCharToDoubleAVX2(signed char *src, double *dst, long n) {
+	long i;
+	for(i=0;i+16<=n;i+=16) {
+		__m128i v = _mm_loadu_si128((__m128i *)(src+i));
+		__m256d d0 = _mm256_cvtepi32_pd(_mm_cvtepi8_epi32(v));
+		__m256d d1 = _mm256_cvtepi32_pd(_mm_cvtepi8_epi32(_mm_srli_si128(v,4)));
+		__m256d d2 = _mm256_cvtepi32_pd(_mm_cvtepi8_epi32(_mm_srli_si128(v,8)));
+		__m256d d3 = _mm256_cvtepi32_pd(_mm_cvtepi8_epi32(_mm_srli_si128(v,12)));
+		_mm256_storeu_pd(dst+i,d0);
+		_mm256_storeu_pd(dst+i+4,d1);
+		_mm256_storeu_pd(dst+i+8,d2);
+		_mm256_storeu_pd(dst+i+12,d3);
+	}
+	return i;
+}
+
+LIBSUBSPACE_TARGET_AVX2 static long ConvertIntToDoubleAVX2(int *src, double *dst, long n) {
+	long i;
+	for(i=0;i+8<=n;i+=8) {
+		__m256i v = _mm256_loadu_si256((__m256i *)(src+i));
+		__m256d d0 = _mm256_cvtepi32_pd(_mm256_castsi256_si128(v));
+		__m256d d1 = _mm256_cvtepi32_pd(_mm256_extracti128_si256(v,1));
+		_mm256_storeu_pd(dst+i,d0);
+		_mm256_storeu_pd(dst+i+4,d1);
+	}
+	return i;
+}
+
+LIBSUBSPACE_TARGET_AVX2 static long ConvertFloatToDoubleAVX2(float *src, double *dst, long n) {
+	long i;
+	for(i=0;i+8<=n;i+=8) {
+		__m256 v = _mm256_loadu_ps(src+i);
+		__m256d d0 = _mm256_cvtps_pd(_mm256_castps256_ps128(v));
+		__m256d d1 = _mm256_cvtps_pd(_mm256_extractf128_ps(v,1));
+		_mm256_storeu_pd(dst+i,d0);
+		_mm256_storeu_pd(dst+i+4,d1);
+	}
+	return i;
+}
+
+LIBSUBSPACE_TARGET_AVX2 static long ConvertUCharToFloatAVX2(unsigned char *src, float *dst, long n) {
+	long i;
+	for(i=0;i+16<=n;i+=16) {
+		__m128i v = _mm_loadu_si128((__m128i *)(src+i));
+		__m256 f0 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v));
+		__m256 f1 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(v,8)));
+		_mm256_storeu_ps(dst+i,f0);
+		_mm256_storeu_ps(dst+i+8,f1);
+	}
+	return i;
+}
+
+LIBSUBSPACE_TARGET_AVX2 static long ConvertCharToFloatAVX2(signed char *src, float *dst, long n) {
+	long i;
+	for(i=0;i+16<=n;i+=16) {
+		__m128i v = _mm_loadu_si128((__m128i *)(src+i));
+		__m256 f0 = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(v));
+		__m256 f1 = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(_mm_srli_si128(v,8)));
+		_mm256_storeu_ps(dst+i,f0);
+		_mm256_storeu_ps(dst+i+8,f1);
+	}
+	return i;
+}
+
+LIBSUBSPACE_TARGET_AVX2 static long ConvertIntToFloatAVX2(int *src, float *dst, long n) {
+	long i;
+	for(i=0;i+8<=n;i+=8) {
+		_mm256_storeu_ps(dst+i,_mm256_cvtepi32_ps(_mm256_loadu_si256((__m256i *)(src+i))));
+	}
+	return i;
+}
+
+LIBSUBSPACE_TARGET_AVX2 static long ConvertDoubleToFloatAVX2(double *src, float *dst, long n) {
+	long i;
+	for(i=0;i+8<=n;i+=8) {
+		__m128 f0 = _mm256_cvtpd_ps(_mm256_loadu_pd(src+i));
+		__m128 f1 = _mm256_cvtpd_ps(_mm256_loadu_pd(src+i+4));
+		_mm256_storeu_ps(dst+i,_mm256_set_m128(f1,f0));
+	}
+	return i;
+}
+
+#endif
+
+void ConvertToDouble(unsigned char *src, double *dst, long n) {
+	long i = 0;
+#ifdef LIBSUBSPACE_X86
+	if(CpuSupportsAVX2()) i = ConvertUCharToDoubleAVX2(src,dst,n);
+#endif
+	for(;i<n;i++) dst[i] = (double)src[i];
+}
+
+void ConvertToDouble(signed char *src, double *dst, long n) {
+	long i = 0;
+#ifdef LIBSUBSPACE_X86
+	if(CpuSupportsAVX2()) i = ConvertCharToDoubleAVX2(src,dst,n);
+#endif
+	for(;i<n;i++) dst[i] = (double)src[i];
+}
+
+void ConvertToDouble(int *src, double *dst, long n) {
+	long i = 0;
+#ifdef LIBSUBSPACE_X86
+	if(CpuSupportsAVX2()) i = ConvertIntToDoubleAVX2(src,dst,n);
+#endif
+	for(;i<n;i++) dst[i] = (double)src[i];
+}
+
+void ConvertToDouble(float *src, double *dst, long n) {
+	long i = 0;
+#ifdef LIBSUBSPACE_X86
+	if(CpuSupportsAVX2()) i = ConvertFloatToDoubleAVX2(src,dst,n);
+#endif
+	for(;i<n;i++) dst[i] = (double)src[i];
+}
+
+void ConvertToFloat(unsigned char *src, float *dst, long n) {
+	long i = 0;
+#ifdef LIBSUBSPACE_X86
+	if(CpuSupportsAVX2()) i = ConvertUCharToFloatAVX2(src,dst,n);
+#endif
+	for(;i<n;i++) dst[i] = (float)src[i];
+}
+
+void ConvertToFloat(signed char *src, float *dst, long n) {
+	long i = 0;
+#ifdef LIBSUBSPACE_X86
+	if(CpuSupportsAVX2()) i = ConvertCharToFloatAVX2(src,dst,n);
+#endif
+	for(;i<n;i++) dst[i] = (float)src[i];
+}
+
+void ConvertToFloat(int *src, float *dst, long n) {
+	long i = 0;
+#ifdef LIBSUBSPACE_X86
+	if(CpuSupportsAVX2()) i = ConvertIntToFloatAVX2(src,dst,n);
+#endif
+	for(;i<n;i++) dst[i] = (float)src[i];
+}
+
+void ConvertToFloat(double *src, float *dst, long n) {
+	long i = 0;
+#ifdef LIBSUBSPACE_X86
+	if(CpuSupportsAVX2()) i = ConvertDoubleToFloatAVX2(src,dst,n);
+#endif
+	for(;i<n;i++) dst[i] = (float)src[i];
+}
+
+} //namespace
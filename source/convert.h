@@ -0,0 +1,40 @@
+//Copyright (C) 2011 by Ivan Fratric
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in
+//all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//THE SOFTWARE.
+
+namespace LibSubspace {
+
+//converts n feature values from the types stored in sample files to double or float
+//the conversions use AVX2 instructions if they are supported by the processor
+//a widening conversion can be done in place: the source values may be stored at the end
+//of the destination array, e.g. read from a file into the last n*sizeof(source type) bytes
+//of the destination, as each value is read before its bytes are overwritten
+void ConvertToDouble(unsigned char *src, double *dst, long n);
+void ConvertToDouble(signed char *src, double *dst, long n);
+void ConvertToDouble(int *src, double *dst, long n);
+void ConvertToDouble(float *src, double *dst, long n);
+
+void ConvertToFloat(unsigned char *src, float *dst, long n);
+void ConvertToFloat(signed char *src, float *dst, long n);
+void ConvertToFloat(int *src, float *dst, long n);
+
+//narrowing conversion, must not be done in place
+void ConvertToFloat(double *src, float *dst, long n);
+
+} //namespace
@@ -0,0 +1,173 @@
+//Copyright (C) 2011 by Ivan Fratric
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in
+//all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//THE SOFTWARE.
+
+
+#include "cpu.h"
+
+#if defined(_MSC_VER) && defined(LIBSUBSPACE_X86)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace LibSubspace {
+
+#if defined(_MSC_VER) && defined(LIBSUBSPACE_X86)
+
+static bool OSSupportsAVX() {
+	int regs[4];
+	__cpuid(regs,1);
+	//OSXSAVE and AVX bits
+	if(!(regs[2] & (1<<27)) || !(regs[2] & (1<<28))) return false;
+	//the OS has to save the YMM registers
+	return (_xgetbv(0) & 6) == 6;
+}
+
+static bool DetectAVX2() {
+	static int supported = -1;
+	if(supported < 0) {
+		int regs[4];
+		supported = 0;
+		if(OSSupportsAVX()) {
+			bool fma;
+			__cpuid(regs,1);
+			fma = (regs[2] & (1<<12)) != 0;
+			__cpuidex(regs,7,0);
+			if(fma && (regs[1] & (1<<5))) supported = 1;
+		}
+	}
+	return supported == 1;
+}
+
+static bool DetectAVX512() {
+	static int supported = -1;
+	if(supported < 0) {
+		int regs[4];
+		supported = 0;
+		//the OS also has to save the opmask and ZMM registers
+		if(DetectAVX2() && ((_xgetbv(0) & 0xE6) == 0xE6)) {
+			__cpuidex(regs,7,0);
+			if(regs[1] & (1<<16)) supported = 1;
+		}
+	}
+	return supported == 1;
+}
+
+static bool DetectPOPCNT() {
+	static int supported = -1;
+	if(supported < 0) {
+		int regs[4];
+		__cpuid(regs,1);
+		supported = (regs[2] & (1<<23)) ? 1 : 0;
+	}
+	return supported == 1;
+}
+
+static bool DetectAVX512VPOPCNTDQ() {
+	static int supported = -1;
+	if(supported < 0) {
+		int regs[4];
+		supported = 0;
+		if(DetectAVX512()) {
+			__cpuidex(regs,7,0);
+			if(regs[2] & (1<<14)) supported = 1;
+		}
+	}
+	return supported == 1;
+}
+
+#elif defined(LIBSUBSPACE_X86)
+
+static bool DetectAVX2() {
+	static int supported = -1;
+	if(supported < 0) {
+		__builtin_cpu_init();
+		supported = (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) ? 1 : 0;
+	}
+	return supported == 1;
+}
+
+static bool DetectAVX512() {
+	static int supported = -1;
+	if(supported < 0) {
+		supported = (DetectAVX2() && __builtin_cpu_supports("avx512f")) ? 1 : 0;
+	}
+	return supported == 1;
+}
+
+static bool DetectPOPCNT() {
+	static int supported = -1;
+	if(supported < 0) {
+		__builtin_cpu_init();
+		supported = __builtin_cpu_supports("popcnt") ? 1 : 0;
+	}
+	return supported == 1;
+}
+
+static bool DetectAVX512VPOPCNTDQ() {
+	static int supported = -1;
+	if(supported < 0) {
+		supported = (DetectAVX512() && __builtin_cpu_supports("avx512vpopcntdq")) ? 1 : 0;
+	}
+	return supported == 1;
+}
+
+#else
+
+static bool DetectAVX2() {
+	return false;
+}
+
+static bool DetectAVX512() {
+	return false;
+}
+
+static bool DetectPOPCNT() {
+	return false;
+}
+
+static bool DetectAVX512VPOPCNTDQ() {
+	return false;
+}
+
+#endif
+
+static int cpuLevel = CPU_LEVEL_AVX512;
+
+void LimitCpuLevel(int level) {
+	cpuLevel = level;
+}
+
+bool CpuSupportsAVX2() {
+	return (cpuLevel >= CPU_LEVEL_AVX2) && DetectAVX2();
+}
+
+bool CpuSupportsAVX512() {
+	return (cpuLevel >= CPU_LEVEL_AVX512) && DetectAVX512();
+}
+
+bool CpuSupportsPOPCNT() {
+	return (cpuLevel >= CPU_LEVEL_AVX2) && DetectPOPCNT();
+}
+
+bool CpuSupportsAVX512VPOPCNTDQ() {
+	return (cpuLevel >= CPU_LEVEL_AVX512) && DetectAVX512VPOPCNTDQ();
+}
+
+} //namespace
@@ -0,0 +1,64 @@
+//Copyright (C) 2011 by Ivan Fratric
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in
+//all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//THE SOFTWARE.
+
+
+//helpers for selecting SIMD code paths at runtime
+//code using the instruction set extensions is only compiled for x86 processors with GCC, Clang or MSVC
+//and only executed if the processor the library is running on supports them
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	#define LIBSUBSPACE_X86
+	#define LIBSUBSPACE_TARGET_AVX2 __attribute__((target("avx2,fma")))
+	#define LIBSUBSPACE_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+	#define LIBSUBSPACE_TARGET_POPCNT __attribute__((target("popcnt")))
+	#define LIBSUBSPACE_TARGET_AVX512_VPOPCNTDQ __attribute__((target("avx512f,avx512vpopcntdq,avx2,fma")))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	#define LIBSUBSPACE_X86
+	#define LIBSUBSPACE_TARGET_AVX2
+	#define LIBSUBSPACE_TARGET_AVX512
+	#define LIBSUBSPACE_TARGET_POPCNT
+	#define LIBSUBSPACE_TARGET_AVX512_VPOPCNTDQ
+#endif
+
+namespace LibSubspace {
+
+//returns true if the processor supports AVX2 and FMA instructions
+bool CpuSupportsAVX2();
+
+//returns true if the processor supports AVX-512F instructions (in addition to AVX2 and FMA)
+bool CpuSupportsAVX512();
+
+//returns true if the processor supports the POPCNT instruction
+bool CpuSupportsPOPCNT();
+
+//returns true if the processor supports AVX-512 VPOPCNTDQ instructions (in addition to AVX-512F)
+bool CpuSupportsAVX512VPOPCNTDQ();
+
+//levels of instruction set extensions
+#define CPU_LEVEL_SCALAR 0 //no extensions
+#define CPU_LEVEL_AVX2 1 //AVX2, FMA and POPCNT
+#define CPU_LEVEL_AVX512 2 //all of the above functions, the default
+
+//the functions above return false for the extensions above the given level, even if the processor supports them
+//used to compare the code paths of a kernel, only affects the code paths selected after the call
+//(the distance kernels returned by GetDistanceKernels are selected on its first call)
+//must not be called while other threads use the library
+void LimitCpuLevel(int level);
+
+} //namespace
@@ -0,0 +1,728 @@
+//Copyright (C) 2011 by Ivan Fratric
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in
+//all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//THE SOFTWARE.
+
+#include "distance.h"
+#include "cpu.h"
+
+#ifdef LIBSUBSPACE_X86
+#include <immintrin.h>
+#endif
+
+//the bounded kernels compare the partial sum with the bound after every DISTANCE_BOUND_BLOCK components
+//(DISTANCE_BOUND_BLOCK/64 words of sign codes)
+#define DISTANCE_BOUND_BLOCK 64
+
+namespace LibSubspace {
+
+static double SquaredEuclideanScalar(double *v1, double *v2, long n) {
+	double sum = 0,d;
+	for(long i=0;i<n;i++) {
+		d = v2[i]-v1[i];
+		sum += d*d;
+	}
+	return sum;
+}
+
+static double DotScalar(double *v1, double *v2, long n) {
+	double dot = 0;
+	for(long i=0;i<n;i++) dot += v1[i]*v2[i];
+	return dot;
+}
+
+static double DotProductScalar(double *v1, double *v2, long n, double *sqnorm1) {
+	double dot = 0,sqnorm = 0;
+	for(long i=0;i<n;i++) {
+		dot += v1[i]*v2[i];
+		sqnorm += v1[i]*v1[i];
+	}
+	*sqnorm1 = sqnorm;
+	return dot;
+}
+
+static long SignMismatchesScalar(double *v1, double *v2, long n) {
+	long count = 0;
+	for(long i=0;i<n;i++) {
+		if(((v1[i]<0)&&(v2[i]>0))||((v1[i]>0)&&(v2[i]<0))) count++;
+	}
+	return count;
+}
+
+static float SquaredEuclideanScalar(float *v1, float *v2, long n) {
+	float sum = 0,d;
+	for(long i=0;i<n;i++) {
+		d = v2[i]-v1[i];
+		sum += d*d;
+	}
+	return sum;
+}
+
+//the bounded kernels add in the same order as the unbounded ones, and only adding non-negative values
+//to the accumulators can not decrease them, so a partial sum that exceeds the bound proves the full sum does
+
+static double SquaredEuclideanBoundedScalar(double *v1, double *v2, long n, double bound) {
+	double sum = 0,d;
+	for(long i=0;i<n;i++) {
+		d = v2[i]-v1[i];
+		sum += d*d;
+		if((((i+1)%DISTANCE_BOUND_BLOCK) == 0) && (sum > bound)) return sum;
+	}
+	return sum;
+}
+
+static float SquaredEuclideanBoundedScalar(float *v1, float *v2, long n, float bound) {
+	float sum = 0,d;
+	for(long i=0;i<n;i++) {
+		d = v2[i]-v1[i];
+		sum += d*d;
+		if((((i+1)%DISTANCE_BOUND_BLOCK) == 0) && (sum > bound)) return sum;
+	}
+	return sum;
+}
+
+static float DotScalar(float *v1, float *v2, long n) {
+	float dot = 0;
+	for(long i=0;i<n;i++) dot += v1[i]*v2[i];
+	return dot;
+}
+
+static float DotProductScalar(float *v1, float *v2, long n, float *sqnorm1) {
+	float dot = 0,sqnorm = 0;
+	for(long i=0;i<n;i++) {
+		dot += v1[i]*v2[i];
+		sqnorm += v1[i]*v1[i];
+	}
+	*sqnorm1 = sqnorm;
+	return dot;
+}
+
+static long SignMismatchesScalar(float *v1, float *v2, long n) {
+	long count = 0;
+	for(long i=0;i<n;i++) {
+		if(((v1[i]<0)&&(v2[i]>0))||((v1[i]>0)&&(v2[i]<0))) count++;
+	}
+	return count;
+}
+
+static void PQDistancesScalar(float *lut, unsigned char *codes, long m, long nblocks, float *distances) {
+	for(long b=0;b<nblocks;b++) {
+		unsigned char *block = &(codes[b*m*PQ_BLOCK_SIZE]);
+		for(long v=0;v<PQ_BLOCK_SIZE;v++) {
+			float sum = 0;
+			for(long j=0;j<m;j++) sum += lut[j*256+block[j*PQ_BLOCK_SIZE+v]];
+			distances[b*PQ_BLOCK_SIZE+v] = sum;
+		}
+	}
+}
+
+static long PopCount(unsigned long long x) {
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (long)((x * 0x0101010101010101ULL) >> 56);
+}
+
+static long SignCodeMismatchesScalar(unsigned long long *code1, unsigned long long *code2, long nwords) {
+	unsigned long long *pos1 = code1+nwords, *pos2 = code2+nwords;
+	long count = 0;
+	for(long i=0;i<nwords;i++) {
+		count += PopCount((code1[i]&pos2[i])|(pos1[i]&code2[i]));
+	}
+	return count;
+}
+
+static long SignCodeMismatchesBoundedScalar(unsigned long long *code1, unsigned long long *code2, long nwords, long bound) {
+	unsigned long long *pos1 = code1+nwords, *pos2 = code2+nwords;
+	long count = 0;
+	for(long i=0;i<nwords;i++) {
+		count += PopCount((code1[i]&pos2[i])|(pos1[i]&code2[i]));
+		if((((i+1)%(DISTANCE_BOUND_BLOCK/64)) == 0) && (count > bound)) return count;
+	}
+	return count;
+}
+
+#ifdef LIBSUBSPACE_X86
+
+//the AVX2 kernels process blocks of 8 (double) or 16 (float) values with two accumulators
+//and finish the remaining values with a scalar loop
+//the sign mismatch masks (all bits set) are subtracted from integer counters
+
+LIBSUBSPACE_TARGET_AVX2 static inline double HorizontalSumAVX2(__m256d v) {
+	__m128d s = _mm_add_pd(_mm256_castpd256_pd128(v),_mm256_extractf128_pd(v,1));
+	s = _mm_add_sd(s,_mm_unpackhi_pd(s,s));
+	return _mm_cvtsd_f64(s);
+}
+
+LIBSUBSPACE_TARGET_AVX2 static inline float HorizontalSumAVX2(__m256 v) {
+	__m128 s = _mm_add_ps(_mm256_castps256_ps128(v),_mm256_extractf128_ps(v,1));
+	s = _mm_add_ps(s,_mm_movehl_ps(s,s));
+	s = _mm_add_ss(s,_mm_shuffle_ps(s,s,1));
+	return _mm_cvtss_f32(s);
+}
+
+LIBSUBSPACE_TARGET_AVX2 static double SquaredEuclideanAVX2(double *v1, double *v2, long n) {
+	long i;
+	__m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+	for(i=0;i+8<=n;i+=8) {
+		__m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(v2+i),_mm256_loadu_pd(v1+i));
+		__m256d d1 = _mm256_sub_pd(_mm256_loadu_pd(v2+i+4),_mm256_loadu_pd(v1+i+4));
+		s0 = _mm256_fmadd_pd(d0,d0,s0);
+		s1 = _mm256_fmadd_pd(d1,d1,s1);
+	}
+	double sum = HorizontalSumAVX2(_mm256_add_pd(s0,s1));
+	return sum + SquaredEuclideanScalar(v1+i,v2+i,n-i);
+}
+
+LIBSUBSPACE_TARGET_AVX2 static double DotAVX2(double *v1, double *v2, long n) {
+	long i;
+	__m256d d0 = _mm256_setzero_pd(), d1 = _mm256_setzero_pd();
+	for(i=0;i+8<=n;i+=8) {
+		d0 = _mm256_fmadd_pd(_mm256_loadu_pd(v1+i),_mm256_loadu_pd(v2+i),d0);
+		d1 = _mm256_fmadd_pd(_mm256_loadu_pd(v1+i+4),_mm256_loadu_pd(v2+i+4),d1);
+	}
+	return HorizontalSumAVX2(_mm256_add_pd(d0,d1)) + DotScalar(v1+i,v2+i,n-i);
+}
+
+LIBSUBSPACE_TARGET_AVX2 static double DotProductAVX2(double *v1, double *v2, long n, double *sqnorm1) {
+	long i;
+	__m256d d0 = _mm256_setzero_pd(), d1 = _mm256_setzero_pd();
+	__m256d q0 = _mm256_setzero_pd(), q1 = _mm256_setzero_pd();
+	for(i=0;i+8<=n;i+=8) {
+		__m256d a0 = _mm256_loadu_pd(v1+i), a1 = _mm256_loadu_pd(v1+i+4);
+		d0 = _mm256_fmadd_pd(a0,_mm256_loadu_pd(v2+i),d0);
+		d1 = _mm256_fmadd_pd(a1,_mm256_loadu_pd(v2+i+4),d1);
+		q0 = _mm256_fmadd_pd(a0,a0,q0);
+		q1 = _mm256_fmadd_pd(a1,a1,q1);
+	}
+	double sqnorm;
+	double dot = DotProductScalar(v1+i,v2+i,n-i,&sqnorm);
+	*sqnorm1 = HorizontalSumAVX2(_mm256_add_pd(q0,q1)) + sqnorm;
+	return HorizontalSumAVX2(_mm256_add_pd(d0,d1)) + dot;
+}
+
+LIBSUBSPACE_TARGET_AVX2 static long SignMismatchesAVX2(double *v1, double *v2, long n) {
+	long i;
+	__m256d zero = _mm256_setzero_pd();
+	__m256i count = _mm256_setzero_si256();
+	for(i=0;i+4<=n;i+=4) {
+		__m256d a = _mm256_loadu_pd(v1+i), b = _mm256_loadu_pd(v2+i);
+		__m256d m = _mm256_or_pd(
+			_mm256_and_pd(_mm256_cmp_pd(a,zero,_CMP_LT_OQ),_mm256_cmp_pd(b,zero,_CMP_GT_OQ)),
+			_mm256_and_pd(_mm256_cmp_pd(a,zero,_CMP_GT_OQ),_mm256_cmp_pd(b,zero,_CMP_LT_OQ)));
+		count = _mm256_sub_epi64(count,_mm256_castpd_si256(m));
+	}
+	long long counts[4];
+	_mm256_storeu_si256((__m256i *)counts,count);
+	return (long)(counts[0]+counts[1]+counts[2]+counts[3]) + SignMismatchesScalar(v1+i,v2+i,n-i);
+}
+
+LIBSUBSPACE_TARGET_AVX2 static float SquaredEuclideanAVX2(float *v1, float *v2, long n) {
+	long i;
+	__m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+	for(i=0;i+16<=n;i+=16) {
+		__m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(v2+i),_mm256_loadu_ps(v1+i));
+		__m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(v2+i+8),_mm256_loadu_ps(v1+i+8));
+		s0 = _mm256_fmadd_ps(d0,d0,s0);
+		s1 = _mm256_fmadd_ps(d1,d1,s1);
+	}
+	float sum = HorizontalSumAVX2(_mm256_add_ps(s0,s1));
+	return sum + SquaredEuclideanScalar(v1+i,v2+i,n-i);
+}
+
+LIBSUBSPACE_TARGET_AVX2 static double SquaredEuclideanBoundedAVX2(double *v1, double *v2, long n, double bound) {
+	long i;
+	__m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+	for(i=0;i+8<=n;i+=8) {
+		__m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(v2+i),_mm256_loadu_pd(v1+i));
+		__m256d d1 = _mm256_sub_pd(_mm256_loadu_pd(v2+i+4),_mm256_loadu_pd(v1+i+4));
+		s0 = _mm256_fmadd_pd(d0,d0,s0);
+		s1 = _mm256_fmadd_pd(d1,d1,s1);
+		if(((i+8)%DISTANCE_BOUND_BLOCK) == 0) {
+			double sum = HorizontalSumAVX2(_mm256_add_pd(s0,s1));
+			if(sum > bound) return sum;
+		}
+	}
+	double sum = HorizontalSumAVX2(_mm256_add_pd(s0,s1));
+	return sum + SquaredEuclideanScalar(v1+i,v2+i,n-i);
+}
+
+LIBSUBSPACE_TARGET_AVX2 static float SquaredEuclideanBoundedAVX2(float *v1, float *v2, long n, float bound) {
+	long i;
+	__m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+	for(i=0;i+16<=n;i+=16) {
+		__m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(v2+i),_mm256_loadu_ps(v1+i));
+		__m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(v2+i+8),_mm256_loadu_ps(v1+i+8));
+		s0 = _mm256_fmadd_ps(d0,d0,s0);
+		s1 = _mm256_fmadd_ps(d1,d1,s1);
+		if(((i+16)%DISTANCE_BOUND_BLOCK) == 0) {
+			float sum = HorizontalSumAVX2(_mm256_add_ps(s0,s1));
+			if(sum > bound) return sum;
+		}
+	}
+	float sum = HorizontalSumAVX2(_mm256_add_ps(s0,s1));
+	return sum + SquaredEuclideanScalar(v1+i,v2+i,n-i);
+}
+
+LIBSUBSPACE_TARGET_AVX2 static float DotAVX2(float *v1, float *v2, long n) {
+	long i;
+	__m256 d0 = _mm256_setzero_ps(), d1 = _mm256_setzero_ps();
+	for(i=0;i+16<=n;i+=16) {
+		d0 = _mm256_fmadd_ps(_mm256_loadu_ps(v1+i),_mm256_loadu_ps(v2+i),d0);
+		d1 = _mm256_fmadd_ps(_mm256_loadu_ps(v1+i+8),_mm256_loadu_ps(v2+i+8),d1);
+	}
+	return HorizontalSumAVX2(_mm256_add_ps(d0,d1)) + DotScalar(v1+i,v2+i,n-i);
+}
+
+LIBSUBSPACE_TARGET_AVX2 static float DotProductAVX2(float *v1, float *v2, long n, float *sqnorm1) {
+	long i;
+	__m256 d0 = _mm256_setzero_ps(), d1 = _mm256_setzero_ps();
+	__m256 q0 = _mm256_setzero_ps(), q1 = _mm256_setzero_ps();
+	for(i=0;i+16<=n;i+=16) {
+		__m256 a0 = _mm256_loadu_ps(v1+i), a1 = _mm256_loadu_ps(v1+i+8);
+		d0 = _mm256_fmadd_ps(a0,_mm256_loadu_ps(v2+i),d0);
+		d1 = _mm256_fmadd_ps(a1,_mm256_loadu_ps(v2+i+8),d1);
+		q0 = _mm256_fmadd_ps(a0,a0,q0);
+		q1 = _mm256_fmadd_ps(a1,a1,q1);
+	}
+	float sqnorm;
+	float dot = DotProductScalar(v1+i,v2+i,n-i,&sqnorm);
+	*sqnorm1 = HorizontalSumAVX2(_mm256_add_ps(q0,q1)) + sqnorm;
+	return HorizontalSumAVX2(_mm256_add_ps(d0,d1)) + dot;
+}
+
+LIBSUBSPACE_TARGET_AVX2 static long SignMismatchesAVX2(float *v1, float *v2, long n) {
+	long i;
+	__m256 zero = _mm256_setzero_ps();
+	__m256i count = _mm256_setzero_si256();
+	for(i=0;i+8<=n;i+=8) {
+		__m256 a = _mm256_loadu_ps(v1+i), b = _mm256_loadu_ps(v2+i);
+		__m256 m = _mm256_or_ps(
+			_mm256_and_ps(_mm256_cmp_ps(a,zero,_CMP_LT_OQ),_mm256_cmp_ps(b,zero,_CMP_GT_OQ)),
+			_mm256_and_ps(_mm256_cmp_ps(a,zero,_CMP_GT_OQ),_mm256_cmp_ps(b,zero,_CMP_LT_OQ)));
+		count = _mm256_sub_epi32(count,_mm256_castps_si256(m));
+	}
+	int counts[8];
+	_mm256_storeu_si256((__m256i *)counts,count);
+	long total = 0;
+	for(int j=0;j<8;j++) total += counts[j];
+	return total + SignMismatchesScalar(v1+i,v2+i,n-i);
+}
+
+//the AVX-512 kernels process blocks of 16 (double) or 32 (float) values with two accumulators
+//the remaining values are loaded with masked loads, which set the missing lanes to zero
+
+LIBSUBSPACE_TARGET_AVX512 static inline double HorizontalSumAVX512(__m512d v) {
+	double s[8];
+	_mm512_storeu_pd(s,v);
+	return ((s[0]+s[4])+(s[1]+s[5]))+((s[2]+s[6])+(s[3]+s[7]));
+}
+
+LIBSUBSPACE_TARGET_AVX512 static inline float HorizontalSumAVX512(__m512 v) {
+	float s[16];
+	_mm512_storeu_ps(s,v);
+	for(int j=0;j<8;j++) s[j] += s[j+8];
+	return ((s[0]+s[4])+(s[1]+s[5]))+((s[2]+s[6])+(s[3]+s[7]));
+}
+
+LIBSUBSPACE_TARGET_AVX512 static double SquaredEuclideanAVX512(double *v1, double *v2, long n) {
+	long i;
+	__m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+	for(i=0;i+16<=n;i+=16) {
+		__m512d d0 = _mm512_sub_pd(_mm512_loadu_pd(v2+i),_mm512_loadu_pd(v1+i));
+		__m512d d1 = _mm512_sub_pd(_mm512_loadu_pd(v2+i+8),_mm512_loadu_pd(v1+i+8));
+		s0 = _mm512_fmadd_pd(d0,d0,s0);
+		s1 = _mm512_fmadd_pd(d1,d1,s1);
+	}
+	for(;i<n;i+=8) {
+		__mmask8 m = (n-i >= 8) ? (__mmask8)0xFF : (__mmask8)((1<<(n-i))-1);
+		__m512d d0 = _mm512_sub_pd(_mm512_maskz_loadu_pd(m,v2+i),_mm512_maskz_loadu_pd(m,v1+i));
+		s0 = _mm512_fmadd_pd(d0,d0,s0);
+	}
+	return HorizontalSumAVX512(_mm512_add_pd(s0,s1));
+}
+
+LIBSUBSPACE_TARGET_AVX512 static double SquaredEuclideanBoundedAVX512(double *v1, double *v2, long n, double bound) {
+	long i;
+	__m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+	for(i=0;i+16<=n;i+=16) {
+		__m512d d0 = _mm512_sub_pd(_mm512_loadu_pd(v2+i),_mm512_loadu_pd(v1+i));
+		__m512d d1 = _mm512_sub_pd(_mm512_loadu_pd(v2+i+8),_mm512_loadu_pd(v1+i+8));
+		s0 = _mm512_fmadd_pd(d0,d0,s0);
+		s1 = _mm512_fmadd_pd(d1,d1,s1);
+		if(((i+16)%DISTANCE_BOUND_BLOCK) == 0) {
+			double sum = HorizontalSumAVX512(_mm512_add_pd(s0,s1));
+			if(sum > bound) return sum;
+		}
+	}
+	for(;i<n;i+=8) {
+		__mmask8 m = (n-i >= 8) ? (__mmask8)0xFF : (__mmask8)((1<<(n-i))-1);
+		__m512d d0 = _mm512_sub_pd(_mm512_maskz_loadu_pd(m,v2+i),_mm512_maskz_loadu_pd(m,v1+i));
+		s0 = _mm512_fmadd_pd(d0,d0,s0);
+	}
+	return HorizontalSumAVX512(_mm512_add_pd(s0,s1));
+}
+
+LIBSUBSPACE_TARGET_AVX512 static double DotAVX512(double *v1, double *v2, long n) {
+	long i;
+	__m512d d0 = _mm512_setzero_pd(), d1 = _mm512_setzero_pd();
+	for(i=0;i+16<=n;i+=16) {
+		d0 = _mm512_fmadd_pd(_mm512_loadu_pd(v1+i),_mm512_loadu_pd(v2+i),d0);
+		d1 = _mm512_fmadd_pd(_mm512_loadu_pd(v1+i+8),_mm512_loadu_pd(v2+i+8),d1);
+	}
+	for(;i<n;i+=8) {
+		__mmask8 m = (n-i >= 8) ? (__mmask8)0xFF : (__mmask8)((1<<(n-i))-1);
+		d0 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(m,v1+i),_mm512_maskz_loadu_pd(m,v2+i),d0);
+	}
+	return HorizontalSumAVX512(_mm512_add_pd(d0,d1));
+}
+
+LIBSUBSPACE_TARGET_AVX512 static double DotProductAVX512(double *v1, double *v2, long n, double *sqnorm1) {
+	long i;
+	__m512d d0 = _mm512_setzero_pd(), d1 = _mm512_setzero_pd();
+	__m512d q0 = _mm512_setzero_pd(), q1 = _mm512_setzero_pd();
+	for(i=0;i+16<=n;i+=16) {
+		__m512d a0 = _mm512_loadu_pd(v1+i), a1 = _mm512_loadu_pd(v1+i+8);
+		d0 = _mm512_fmadd_pd(a0,_mm512_loadu_pd(v2+i),d0);
+		d1 = _mm512_fmadd_pd(a1,_mm512_loadu_pd(v2+i+8),d1);
+		q0 = _mm512_fmadd_pd(a0,a0,q0);
+		q1 = _mm512_fmadd_pd(a1,a1,q1);
+	}
+	for(;i<n;i+=8) {
+		__mmask8 m = (n-i >= 8) ? (__mmask8)0xFF : (__mmask8)((1<<(n-i))-1);
+		__m512d a0 = _mm512_maskz_loadu_pd(m,v1+i);
+		d0 = _mm512_fmadd_pd(a0,_mm512_maskz_loadu_pd(m,v2+i),d0);
+		q0 = _mm512_fmadd_pd(a0,a0,q0);
+	}
+	*sqnorm1 = HorizontalSumAVX512(_mm512_add_pd(q0,q1));
+	return HorizontalSumAVX512(_mm512_add_pd(d0,d1));
+}
+
+LIBSUBSPACE_TARGET_AVX512 static long SignMismatchesAVX512(double *v1, double *v2, long n) {
+	long i;
+	__m512d zero = _mm512_setzero_pd();
+	__m512i one = _mm512_set1_epi64(1);
+	__m512i count = _mm512_setzero_si512();
+	for(i=0;i<n;i+=8) {
+		__mmask8 k = (n-i >= 8) ? (__mmask8)0xFF : (__mmask8)((1<<(n-i))-1);
+		__m512d a = _mm512_maskz_loadu_pd(k,v1+i), b = _mm512_maskz_loadu_pd(k,v2+i);
+		__mmask8 m = (_mm512_cmp_pd_mask(a,zero,_CMP_LT_OQ) & _mm512_cmp_pd_mask(b,zero,_CMP_GT_OQ)) |
+			(_mm512_cmp_pd_mask(a,zero,_CMP_GT_OQ) & _mm512_cmp_pd_mask(b,zero,_CMP_LT_OQ));
+		count = _mm512_mask_add_epi64(count,m,count,one);
+	}
+	long long counts[8];
+	_mm512_storeu_si512(counts,count);
+	long total = 0;
+	for(int j=0;j<8;j++) total += (long)counts[j];
+	return total;
+}
+
+LIBSUBSPACE_TARGET_AVX512 static float SquaredEuclideanAVX512(float *v1, float *v2, long n) {
+	long i;
+	__m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+	for(i=0;i+32<=n;i+=32) {
+		__m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(v2+i),_mm512_loadu_ps(v1+i));
+		__m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(v2+i+16),_mm512_loadu_ps(v1+i+16));
+		s0 = _mm512_fmadd_ps(d0,d0,s0);
+		s1 = _mm512_fmadd_ps(d1,d1,s1);
+	}
+	for(;i<n;i+=16) {
+		__mmask16 m = (n-i >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1<<(n-i))-1);
+		__m512 d0 = _mm512_sub_ps(_mm512_maskz_loadu_ps(m,v2+i),_mm512_maskz_loadu_ps(m,v1+i));
+		s0 = _mm512_fmadd_ps(d0,d0,s0);
+	}
+	return HorizontalSumAVX512(_mm512_add_ps(s0,s1));
+}
+
+LIBSUBSPACE_TARGET_AVX512 static float SquaredEuclideanBoundedAVX512(float *v1, float *v2, long n, float bound) {
+	long i;
+	__m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+	for(i=0;i+32<=n;i+=32) {
+		__m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(v2+i),_mm512_loadu_ps(v1+i));
+		__m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(v2+i+16),_mm512_loadu_ps(v1+i+16));
+		s0 = _mm512_fmadd_ps(d0,d0,s0);
+		s1 = _mm512_fmadd_ps(d1,d1,s1);
+		if(((i+32)%DISTANCE_BOUND_BLOCK) == 0) {
+			float sum = HorizontalSumAVX512(_mm512_add_ps(s0,s1));
+			if(sum > bound) return sum;
+		}
+	}
+	for(;i<n;i+=16) {
+		__mmask16 m = (n-i >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1<<(n-i))-1);
+		__m512 d0 = _mm512_sub_ps(_mm512_maskz_loadu_ps(m,v2+i),_mm512_maskz_loadu_ps(m,v1+i));
+		s0 = _mm512_fmadd_ps(d0,d0,s0);
+	}
+	return HorizontalSumAVX512(_mm512_add_ps(s0,s1));
+}
+
+LIBSUBSPACE_TARGET_AVX512 static float DotAVX512(float *v1, float *v2, long n) {
+	long i;
+	__m512 d0 = _mm512_setzero_ps(), d1 = _mm512_setzero_ps();
+	for(i=0;i+32<=n;i+=32) {
+		d0 = _mm512_fmadd_ps(_mm512_loadu_ps(v1+i),_mm512_loadu_ps(v2+i),d0);
+		d1 = _mm512_fmadd_ps(_mm512_loadu_ps(v1+i+16),_mm512_loadu_ps(v2+i+16),d1);
+	}
+	for(;i<n;i+=16) {
+		__mmask16 m = (n-i >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1<<(n-i))-1);
+		d0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m,v1+i),_mm512_maskz_loadu_ps(m,v2+i),d0);
+	}
+	return HorizontalSumAVX512(_mm512_add_ps(d0,d1));
+}
+
+LIBSUBSPACE_TARGET_AVX512 static float DotProductAVX512(float *v1, float *v2, long n, float *sqnorm1) {
+	long i;
+	__m512 d0 = _mm512_setzero_ps(), d1 = _mm512_setzero_ps();
+	__m512 q0 = _mm512_setzero_ps(), q1 = _mm512_setzero_ps();
+	for(i=0;i+32<=n;i+=32) {
+		__m512 a0 = _mm512_loadu_ps(v1+i), a1 = _mm512_loadu_ps(v1+i+16);
+		d0 = _mm512_fmadd_ps(a0,_mm512_loadu_ps(v2+i),d0);
+		d1 = _mm512_fmadd_ps(a1,_mm512_loadu_ps(v2+i+16),d1);
+		q0 = _mm512_fmadd_ps(a0,a0,q0);
+		q1 = _mm512_fmadd_ps(a1,a1,q1);
+	}
+	for(;i<n;i+=16) {
+		__mmask16 m = (n-i >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1<<(n-i))-1);
+		__m512 a0 = _mm512_maskz_loadu_ps(m,v1+i);
+		d0 = _mm512_fmadd_ps(a0,_mm512_maskz_loadu_ps(m,v2+i),d0);
+		q0 = _mm512_fmadd_ps(a0,a0,q0);
+	}
+	*sqnorm1 = HorizontalSumAVX512(_mm512_add_ps(q0,q1));
+	return HorizontalSumAVX512(_mm512_add_ps(d0,d1));
+}
+
+LIBSUBSPACE_TARGET_AVX512 static long SignMismatchesAVX512(float *v1, float *v2, long n) {
+	long i;
+	__m512 zero = _mm512_setzero_ps();
+	__m512i one = _mm512_set1_epi32(1);
+	__m512i count = _mm512_setzero_si512();
+	for(i=0;i<n;i+=16) {
+		__mmask16 k = (n-i >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1<<(n-i))-1);
+		__m512 a = _mm512_maskz_loadu_ps(k,v1+i), b = _mm512_maskz_loadu_ps(k,v2+i);
+		__mmask16 m = (_mm512_cmp_ps_mask(a,zero,_CMP_LT_OQ) & _mm512_cmp_ps_mask(b,zero,_CMP_GT_OQ)) |
+			(_mm512_cmp_ps_mask(a,zero,_CMP_GT_OQ) & _mm512_cmp_ps_mask(b,zero,_CMP_LT_OQ));
+		count = _mm512_mask_add_epi32(count,m,count,one);
+	}
+	int counts[16];
+	_mm512_storeu_si512(counts,count);
+	long total = 0;
+	for(int j=0;j<16;j++) total += counts[j];
+	return total;
+}
+
+//the product quantization kernels gather the table entries of 8 or 16 codes at once
+
+LIBSUBSPACE_TARGET_AVX2 static void PQDistancesAVX2(float *lut, unsigned char *codes, long m, long nblocks, float *distances) {
+	for(long b=0;b<nblocks;b++) {
+		unsigned char *block = &(codes[b*m*PQ_BLOCK_SIZE]);
+		__m256 sum0 = _mm256_setzero_ps();
+		__m256 sum1 = _mm256_setzero_ps();
+		for(long j=0;j<m;j++) {
+			__m128i c = _mm_loadu_si128((__m128i *)&(block[j*PQ_BLOCK_SIZE]));
+			sum0 = _mm256_add_ps(sum0,_mm256_i32gather_ps(&(lut[j*256]),_mm256_cvtepu8_epi32(c),4));
+			sum1 = _mm256_add_ps(sum1,_mm256_i32gather_ps(&(lut[j*256]),_mm256_cvtepu8_epi32(_mm_srli_si128(c,8)),4));
+		}
+		_mm256_storeu_ps(&(distances[b*PQ_BLOCK_SIZE]),sum0);
+		_mm256_storeu_ps(&(distances[b*PQ_BLOCK_SIZE+8]),sum1);
+	}
+}
+
+LIBSUBSPACE_TARGET_AVX512 static void PQDistancesAVX512(float *lut, unsigned char *codes, long m, long nblocks, float *distances) {
+	for(long b=0;b<nblocks;b++) {
+		unsigned char *block = &(codes[b*m*PQ_BLOCK_SIZE]);
+		__m512 sum = _mm512_setzero_ps();
+		for(long j=0;j<m;j++) {
+			__m128i c = _mm_loadu_si128((__m128i *)&(block[j*PQ_BLOCK_SIZE]));
+			__m512i index = _mm512_maskz_cvtepu8_epi32(0xFFFF,c);
+			sum = _mm512_add_ps(sum,_mm512_mask_i32gather_ps(_mm512_setzero_ps(),0xFFFF,index,&(lut[j*256]),4));
+		}
+		_mm512_storeu_ps(&(distances[b*PQ_BLOCK_SIZE]),sum);
+	}
+}
+
+//the sign code kernels count the bits of (negative1 & positive2) | (positive1 & negative2)
+
+LIBSUBSPACE_TARGET_POPCNT static long SignCodeMismatchesPOPCNT(unsigned long long *code1, unsigned long long *code2, long nwords) {
+	unsigned long long *pos1 = code1+nwords, *pos2 = code2+nwords;
+	long count = 0;
+	for(long i=0;i<nwords;i++) {
+		unsigned long long x = (code1[i]&pos2[i])|(pos1[i]&code2[i]);
+#if defined(__x86_64__) || defined(_M_X64)
+		count += (long)_mm_popcnt_u64(x);
+#else
+		count += _mm_popcnt_u32((unsigned int)x) + _mm_popcnt_u32((unsigned int)(x >> 32));
+#endif
+	}
+	return count;
+}
+
+LIBSUBSPACE_TARGET_POPCNT static long SignCodeMismatchesBoundedPOPCNT(unsigned long long *code1, unsigned long long *code2, long nwords, long bound) {
+	unsigned long long *pos1 = code1+nwords, *pos2 = code2+nwords;
+	long count = 0;
+	for(long i=0;i<nwords;i++) {
+		unsigned long long x = (code1[i]&pos2[i])|(pos1[i]&code2[i]);
+#if defined(__x86_64__) || defined(_M_X64)
+		count += (long)_mm_popcnt_u64(x);
+#else
+		count += _mm_popcnt_u32((unsigned int)x) + _mm_popcnt_u32((unsigned int)(x >> 32));
+#endif
+		if((((i+1)%(DISTANCE_BOUND_BLOCK/64)) == 0) && (count > bound)) return count;
+	}
+	return count;
+}
+
+LIBSUBSPACE_TARGET_AVX512_VPOPCNTDQ static long SignCodeMismatchesAVX512(unsigned long long *code1, unsigned long long *code2, long nwords) {
+	unsigned long long *pos1 = code1+nwords, *pos2 = code2+nwords;
+	__m512i count = _mm512_setzero_si512();
+	for(long i=0;i<nwords;i+=8) {
+		__mmask8 m = (nwords-i >= 8) ? (__mmask8)0xFF : (__mmask8)((1<<(nwords-i))-1);
+		__m512i x = _mm512_or_si512(
+			_mm512_and_si512(_mm512_maskz_loadu_epi64(m,code1+i),_mm512_maskz_loadu_epi64(m,pos2+i)),
+			_mm512_and_si512(_mm512_maskz_loadu_epi64(m,pos1+i),_mm512_maskz_loadu_epi64(m,code2+i)));
+		count = _mm512_add_epi64(count,_mm512_popcnt_epi64(x));
+	}
+	long long counts[8];
+	_mm512_storeu_si512(counts,count);
+	long total = 0;
+	for(int j=0;j<8;j++) total += (long)counts[j];
+	return total;
+}
+
+//the AVX-512 version compares the count with the bound after every 8 words
+LIBSUBSPACE_TARGET_AVX512_VPOPCNTDQ static long SignCodeMismatchesBoundedAVX512(unsigned long long *code1, unsigned long long *code2, long nwords, long bound) {
+	unsigned long long *pos1 = code1+nwords, *pos2 = code2+nwords;
+	__m512i count = _mm512_setzero_si512();
+	long long counts[8];
+	long total = 0;
+	for(long i=0;i<nwords;i+=8) {
+		__mmask8 m = (nwords-i >= 8) ? (__mmask8)0xFF : (__mmask8)((1<<(nwords-i))-1);
+		__m512i x = _mm512_or_si512(
+			_mm512_and_si512(_mm512_maskz_loadu_epi64(m,code1+i),_mm512_maskz_loadu_epi64(m,pos2+i)),
+			_mm512_and_si512(_mm512_maskz_loadu_epi64(m,pos1+i),_mm512_maskz_loadu_epi64(m,code2+i)));
+		count = _mm512_add_epi64(count,_mm512_popcnt_epi64(x));
+		_mm512_storeu_si512(counts,count);
+		total = 0;
+		for(int j=0;j<8;j++) total += (long)counts[j];
+		if(total > bound) return total;
+	}
+	return total;
+}
+
+#endif
+
+DistanceKernels SelectDistanceKernels() {
+	DistanceKernels kernels;
+	double (*squaredEuclidean)(double *, double *, long) = SquaredEuclideanScalar;
+	double (*dot)(double *, double *, long) = DotScalar;
+	double (*dotProduct)(double *, double *, long, double *) = DotProductScalar;
+	long (*signMismatches)(double *, double *, long) = SignMismatchesScalar;
+	long (*signCodeMismatches)(unsigned long long *, unsigned long long *, long) = SignCodeMismatchesScalar;
+	double (*squaredEuclideanBounded)(double *, double *, long, double) = SquaredEuclideanBoundedScalar;
+	long (*signCodeMismatchesBounded)(unsigned long long *, unsigned long long *, long, long) = SignCodeMismatchesBoundedScalar;
+	float (*squaredEuclideanFloat)(float *, float *, long) = SquaredEuclideanScalar;
+	float (*squaredEuclideanBoundedFloat)(float *, float *, long, float) = SquaredEuclideanBoundedScalar;
+	float (*dotFloat)(float *, float *, long) = DotScalar;
+	float (*dotProductFloat)(float *, float *, long, float *) = DotProductScalar;
+	long (*signMismatchesFloat)(float *, float *, long) = SignMismatchesScalar;
+	void (*pqDistances)(float *, unsigned char *, long, long, float *) = PQDistancesScalar;
+#ifdef LIBSUBSPACE_X86
+	if(CpuSupportsAVX512()) {
+		squaredEuclidean = SquaredEuclideanAVX512;
+		squaredEuclideanBounded = SquaredEuclideanBoundedAVX512;
+		dot = DotAVX512;
+		dotProduct = DotProductAVX512;
+		signMismatches = SignMismatchesAVX512;
+		squaredEuclideanFloat = SquaredEuclideanAVX512;
+		squaredEuclideanBoundedFloat = SquaredEuclideanBoundedAVX512;
+		dotFloat = DotAVX512;
+		dotProductFloat = DotProductAVX512;
+		signMismatchesFloat = SignMismatchesAVX512;
+		pqDistances = PQDistancesAVX512;
+	} else if(CpuSupportsAVX2()) {
+		squaredEuclidean = SquaredEuclideanAVX2;
+		squaredEuclideanBounded = SquaredEuclideanBoundedAVX2;
+		dot = DotAVX2;
+		dotProduct = DotProductAVX2;
+		signMismatches = SignMismatchesAVX2;
+		squaredEuclideanFloat = SquaredEuclideanAVX2;
+		squaredEuclideanBoundedFloat = SquaredEuclideanBoundedAVX2;
+		dotFloat = DotAVX2;
+		dotProductFloat = DotProductAVX2;
+		signMismatchesFloat = SignMismatchesAVX2;
+		pqDistances = PQDistancesAVX2;
+	}
+	if(CpuSupportsAVX512VPOPCNTDQ()) {
+		signCodeMismatches = SignCodeMismatchesAVX512;
+		signCodeMismatchesBounded = SignCodeMismatchesBoundedAVX512;
+	} else if(CpuSupportsPOPCNT()) {
+		signCodeMismatches = SignCodeMismatchesPOPCNT;
+		signCodeMismatchesBounded = SignCodeMismatchesBoundedPOPCNT;
+	}
+#endif
+	kernels.squaredEuclidean = squaredEuclidean;
+	kernels.dot = dot;
+	kernels.dotProduct = dotProduct;
+	kernels.signMismatches = signMismatches;
+	kernels.signCodeMismatches = signCodeMismatches;
+	kernels.squaredEuclideanBounded = squaredEuclideanBounded;
+	kernels.signCodeMismatchesBounded = signCodeMismatchesBounded;
+	kernels.squaredEuclideanFloat = squaredEuclideanFloat;
+	kernels.squaredEuclideanBoundedFloat = squaredEuclideanBoundedFloat;
+	kernels.dotFloat = dotFloat;
+	kernels.dotProductFloat = dotProductFloat;
+	kernels.signMismatchesFloat = signMismatchesFloat;
+	kernels.pqDistances = pqDistances;
+	return kernels;
+}
+
+long SignCodeWords(long n) {
+	return (n+63)/64;
+}
+
+void GetSignCode(double *v, long n, unsigned long long *code) {
+	long nwords = SignCodeWords(n);
+	unsigned long long *neg = code, *pos = code+nwords;
+	for(long i=0;i<nwords;i++) {
+		neg[i] = 0;
+		pos[i] = 0;
+	}
+	for(long i=0;i<n;i++) {
+		if(v[i] < 0) neg[i/64] |= 1ULL << (i%64);
+		else if(v[i] > 0) pos[i/64] |= 1ULL << (i%64);
+	}
+}
+
+void GetSignCode(float *v, long n, unsigned long long *code) {
+	long nwords = SignCodeWords(n);
+	unsigned long long *neg = code, *pos = code+nwords;
+	for(long i=0;i<nwords;i++) {
+		neg[i] = 0;
+		pos[i] = 0;
+	}
+	for(long i=0;i<n;i++) {
+		if(v[i] < 0) neg[i/64] |= 1ULL << (i%64);
+		else if(v[i] > 0) pos[i/64] |= 1ULL << (i%64);
+	}
+}
+
+const DistanceKernels *GetDistanceKernels() {
+	//initialized once, on the first call
+	static const DistanceKernels kernels = SelectDistanceKernels();
+	return &kernels;
+}
+
+} //namespace
@@ -0,0 +1,78 @@
+//Copyright (C) 2011 by Ivan Fratric
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in
+//all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//THE SOFTWARE.
+
+namespace LibSubspace {
+
+//kernels used to compare feature vectors of size n
+//the kernels are selected once, for the processor the library is running on,
+//and use AVX-512 or AVX2 instructions if they are supported
+//the vectorized kernels sum in a different order than a sequential loop, so the results can differ in the last bits
+struct DistanceKernels {
+	//returns the squared Euclidean distance of v1 and v2
+	double (*squaredEuclidean)(double *v1, double *v2, long n);
+	//returns the dot product of v1 and v2
+	double (*dot)(double *v1, double *v2, long n);
+	//returns the dot product of v1 and v2, the dot product of v1 with itself is stored in sqnorm1
+	double (*dotProduct)(double *v1, double *v2, long n, double *sqnorm1);
+	//returns the number of components of v1 and v2 with opposite signs (zero has no sign)
+	long (*signMismatches)(double *v1, double *v2, long n);
+	//returns the number of components with opposite signs, given the sign codes of two vectors (see GetSignCode)
+	//the result is the same as signMismatches for the vectors
+	long (*signCodeMismatches)(unsigned long long *code1, unsigned long long *code2, long nwords);
+	//early-abandon versions of squaredEuclidean and signCodeMismatches, used to search for the nearest sample
+	//the partial sum is compared with bound after each block of components, and returned as soon as it exceeds bound
+	//otherwise the result is exactly the same as the result of the unbounded kernel, which is never smaller than a partial sum
+	double (*squaredEuclideanBounded)(double *v1, double *v2, long n, double bound);
+	long (*signCodeMismatchesBounded)(unsigned long long *code1, unsigned long long *code2, long nwords, long bound);
+
+	//single precision versions, the sums are accumulated in single precision
+	float (*squaredEuclideanFloat)(float *v1, float *v2, long n);
+	float (*squaredEuclideanBoundedFloat)(float *v1, float *v2, long n, float bound);
+	float (*dotFloat)(float *v1, float *v2, long n);
+	float (*dotProductFloat)(float *v1, float *v2, long n, float *sqnorm1);
+	long (*signMismatchesFloat)(float *v1, float *v2, long n);
+	//computes the distances of product quantization codes from lookup tables (see PQ_BLOCK_SIZE)
+	//lut contains m tables of 256 distances, one for each subquantizer
+	//codes contains nblocks blocks of PQ_BLOCK_SIZE codes, distances receives PQ_BLOCK_SIZE*nblocks distances
+	//the distance of a code is the sum of the table entries of its m bytes, added in order
+	void (*pqDistances)(float *lut, unsigned char *codes, long m, long nblocks, float *distances);
+};
+
+//product quantization codes of m bytes are stored in blocks of PQ_BLOCK_SIZE codes
+//a block contains m groups of PQ_BLOCK_SIZE bytes, the j-th group holds the j-th byte of each code,
+//so that the table entries of a group can be looked up with a single vector instruction
+#define PQ_BLOCK_SIZE 16
+
+//returns the kernels for the processor the library is running on
+const DistanceKernels *GetDistanceKernels();
+
+//selects the kernels for the instruction set extensions reported by the functions in cpu.h
+//GetDistanceKernels returns the kernels selected on its first call, this function can be used
+//to obtain the kernels of a lower level after LimitCpuLevel, e.g. to compare their speed
+DistanceKernels SelectDistanceKernels();
+
+//a sign code stores the signs of the n components of a feature vector as bits in 2*SignCodeWords(n) 64-bit words
+//the first SignCodeWords(n) words have a bit set for each negative component, the others for each positive component
+//zero (and NaN) components have no sign, the same as in signMismatches
+long SignCodeWords(long n);
+void GetSignCode(double *v, long n, unsigned long long *code);
+void GetSignCode(float *v, long n, unsigned long long *code);
+
+} //namespace
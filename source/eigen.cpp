@@ -35,10 +35,29 @@ extern "C" int dsyev_(const char *jobz, const char *uplo, int *n, double *a,
 	int *lda, double *w, double *work, int *lwork, 
 	int *info);
 
+extern "C" int dsyevd_(const char *jobz, const char *uplo, int *n, double *a,
+	int *lda, double *w, double *work, int *lwork, int *iwork, int *liwork,
+	int *info);
+
+extern "C" int dsyevr_(const char *jobz, const char *range, const char *uplo, int *n, 
+	double *a, int *lda, double *vl, double *vu, int *il, int *iu, 
+	double *abstol, int *m, double *w, double *z, int *ldz, int *isuppz, 
+	double *work, int *lwork, int *iwork, int *liwork, int *info);
+
 extern "C" int dsygv_(int *itype, const char *jobz, const char *uplo, int *
 	n, double *a, int *lda, double *b, int *ldb, 
 	double *w, double *work, int *lwork, int *info);
 
+extern "C" int dsygvd_(int *itype, const char *jobz, const char *uplo, int *
+	n, double *a, int *lda, double *b, int *ldb, 
+	double *w, double *work, int *lwork, int *iwork, int *liwork, int *info);
+
+extern "C" int dgeqrf_(int *m, int *n, double *a, int *lda, double *tau, 
+	double *work, int *lwork, int *info);
+
+extern "C" int dorgqr_(int *m, int *n, int *k, double *a, int *lda, double *tau, 
+	double *work, int *lwork, int *info);
+
 extern "C" int dggev_(const char *jobvl, const char *jobvr, int *n, double *
 	a, int *lda, double *b, int *ldb, double *alphar, 
 	double *alphai, double *beta, double *vl, int *ldvl, 
@@ -47,16 +66,34 @@ extern "C" int dggev_(const char *jobvl, const char *jobvr, int *n, double *
 
 namespace LibSubspace {
 
-int eigen(double* A, double* V, double* E, int n, bool verbose) {
+int eigen(double* A, double* V, double* E, int n, bool verbose, int algorithm) {
 	int info;
 	int ispec = 1;
 	int lwork;
 
-	lwork = (ilaenv_(&ispec,"DSYEV","U",&n,&n,&n,&n,5,1)+2)*n;
-	double *work = (double *)malloc(lwork*sizeof(double));
 	memcpy(V,A,n*n*sizeof(double));
-	dsyev_("V","U",&n,V,&n,E,work,&lwork,&info);
-	free(work);
+
+	if(algorithm == EIGEN_DC) {
+		//getting the optimal workspace size
+		int liwork = -1;
+		int iworkopt;
+		double workopt;
+		lwork = -1;
+		dsyevd_("V","U",&n,V,&n,E,&workopt,&lwork,&iworkopt,&liwork,&info);
+		lwork = (int)workopt;
+		liwork = iworkopt;
+
+		double *work = (double *)malloc(lwork*sizeof(double));
+		int *iwork = (int *)malloc(liwork*sizeof(int));
+		dsyevd_("V","U",&n,V,&n,E,work,&lwork,iwork,&liwork,&info);
+		free(work);
+		free(iwork);
+	} else {
+		lwork = (ilaenv_(&ispec,"DSYEV","U",&n,&n,&n,&n,5,1)+2)*n;
+		double *work = (double *)malloc(lwork*sizeof(double));
+		dsyev_("V","U",&n,V,&n,E,work,&lwork,&info);
+		free(work);
+	}
 
 	//check the return value
 	if(info!=0) {
@@ -77,6 +114,61 @@ int eigen(double* A, double* V, double* E, int n, bool verbose) {
 }
 
 
+int eigentop(double* A, double* V, double* E, int n, int k, bool verbose) {
+	int info;
+	int lwork,liwork;
+	double workopt;
+	int iworkopt;
+	int il,iu,m;
+	double vl = 0, vu = 0;
+	double abstol = 0; //default tolerance
+
+	if(k>n) k = n;
+	if(k<=0) return 0;
+
+	il = n-k+1;
+	iu = n;
+
+	double *W = (double *)malloc(n*sizeof(double));
+	int *isuppz = (int *)malloc(2*k*sizeof(int));
+
+	//getting the optimal workspace size
+	lwork = -1;
+	liwork = -1;
+	dsyevr_("V","I","U",&n,A,&n,&vl,&vu,&il,&iu,&abstol,&m,W,V,&n,isuppz,&workopt,&lwork,&iworkopt,&liwork,&info);
+	lwork = (int)workopt;
+	liwork = iworkopt;
+	double *work = (double *)malloc(lwork*sizeof(double));
+	int *iwork = (int *)malloc(liwork*sizeof(int));
+
+	//eigenvectors are written as columns of a column-ordered (n x k) matrix
+	//which is the same as rows of a row-ordered (k x n) matrix
+	dsyevr_("V","I","U",&n,A,&n,&vl,&vu,&il,&iu,&abstol,&m,W,V,&n,isuppz,work,&lwork,iwork,&liwork,&info);
+	memcpy(E,W,k*sizeof(double));
+
+	free(work);
+	free(iwork);
+	free(isuppz);
+	free(W);
+
+	//check the return value
+	if((info!=0)||(m!=k)) {
+		if(verbose) {
+			printf("Error computing eigenvectors: ");
+			if(info>0) {
+				printf("Algorithm failed to converge\n");
+			} else if(info<0) {
+				printf("Illegal argument\n");
+			} else {
+				printf("Unknown error\n");
+			}
+		}
+		return 0;
+	}
+
+	return 1;
+}
+
 int geneigen(double *A, double *B, int n, double *W, int algorithm, bool verbose) {
 	//getting the optimal lwork
 	int ispec = 1;
@@ -116,6 +208,42 @@ int geneigen(double *A, double *B, int n, double *W, int algorithm, bool verbose
 		}
 		break;
 
+		case EIGEN_DC: 
+		{
+			//getting the optimal workspace size
+			int problemType = 1;
+			int liwork = -1;
+			int iworkopt;
+			double workopt;
+			lwork = -1;
+			dsygvd_(&problemType,"V","U",&n,A,&n,B,&n,W,&workopt,&lwork,&iworkopt,&liwork,&info);
+			lwork = (int)workopt;
+			liwork = iworkopt;
+
+			//computing eigenvectors
+			double *work = (double *)malloc(lwork*sizeof(double));
+			int *iwork = (int *)malloc(liwork*sizeof(int));
+			dsygvd_(&problemType,"V","U",&n,A,&n,B,&n,W,work,&lwork,iwork,&liwork,&info);
+			free(work);
+			free(iwork);
+
+			//check the return value
+			if(info!=0) {
+				if(verbose) {
+					printf("Error computing eigenvectors: ");
+					if(info<0) {
+						printf("Illegal argument\n");
+					} else if(info>n) {
+						printf("Matrix B is not positive definite\n");
+					} else {
+						printf("The problem failed to converge\n");
+					}
+				}
+				return 0;
+			}
+		}
+		break;
+
 		case EIGEN_QZ:
 		{
 			//more general algorithm
@@ -163,4 +291,37 @@ int geneigen(double *A, double *B, int n, double *W, int algorithm, bool verbose
 	return 1;
 }
 
+int orthonormalize(double *A, int rows, int cols, bool verbose) {
+	int info;
+	int lwork;
+	double workopt;
+
+	if(rows>cols) return 0;
+
+	//a row-ordered (rows x cols) matrix is a column-ordered (cols x rows) matrix
+	//so its rows are orthonormalized by computing the Q factor of that matrix
+	double *tau = (double *)malloc(rows*sizeof(double));
+
+	//getting the optimal workspace size, the larger of the two routines
+	int lworkqr = -1;
+	dgeqrf_(&cols,&rows,A,&cols,tau,&workopt,&lworkqr,&info);
+	lwork = (int)workopt;
+	lworkqr = -1;
+	dorgqr_(&cols,&rows,&rows,A,&cols,tau,&workopt,&lworkqr,&info);
+	if((int)workopt > lwork) lwork = (int)workopt;
+
+	double *work = (double *)malloc(lwork*sizeof(double));
+	dgeqrf_(&cols,&rows,A,&cols,tau,work,&lwork,&info);
+	if(info==0) dorgqr_(&cols,&rows,&rows,A,&cols,tau,work,&lwork,&info);
+	free(work);
+	free(tau);
+
+	if(info!=0) {
+		if(verbose) printf("Error computing QR decomposition: Illegal argument\n");
+		return 0;
+	}
+
+	return 1;
+}
+
 } //namespace
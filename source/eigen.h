@@ -21,6 +21,7 @@
 
 #define EIGEN_CHOL 0
 #define EIGEN_QZ 1
+#define EIGEN_DC 2
 
 namespace LibSubspace {
 
@@ -33,7 +34,23 @@ namespace LibSubspace {
 //            E(n)    - vector of its eigenvalues
 //                          (i-th element is an eigenvalue Ei),
 //            verbose - prints error messages to stdout
-int eigen(double* A, double* V, double* E, int n, bool verbose = false);
+//            algorithm - EIGEN_DC uses the divide and conquer algorithm, which is considerably faster
+//                        for large matrices, but needs more workspace memory
+//                        any other value uses the QR algorithm
+int eigen(double* A, double* V, double* E, int n, bool verbose = false, int algorithm = EIGEN_CHOL);
+
+//Computes only the k largest eigenvalues & corresponding eigenvectors of a symmetric matrix
+//this is much faster than computing the full spectrum with eigen() when k is small compared to n
+//Returns 1 on success, 0 on failure
+//Parameters: A(n, n) - source symmetric matrix (n - rows & columns number),
+//                      destroyed during the computation
+//            V(k, n) - matrix of its eigenvectors 
+//                      (i-th row is an eigenvector Vi),
+//            E(k)    - vector of its eigenvalues in rising order
+//                          (i-th element is an eigenvalue Ei),
+//            k       - number of eigenvalues to compute, if k>=n all of them are computed
+//            verbose - prints error messages to stdout
+int eigentop(double* A, double* V, double* E, int n, int k, bool verbose = false);
 
 
 
@@ -52,7 +69,19 @@ int eigen(double* A, double* V, double* E, int n, bool verbose = false);
 //								EIGEN_CHOL uses the Cholesky factorization, works only 
 //									for symmetric A and symmetric positive definite B
 //								EIGEN_QZ uses the QZ algorithm
+//								EIGEN_DC uses the Cholesky factorization followed by the divide and conquer
+//									algorithm, faster than EIGEN_CHOL for large matrices but needs more
+//									workspace memory, works only for symmetric A and symmetric positive definite B
 //      verbose             :   prints error messages to stdout
 int geneigen(double *A, double *B, int n, double *W, int algorithm = EIGEN_CHOL, bool verbose = false);
 
+//orthonormalizes the rows of a matrix using the QR decomposition
+//on output, the rows of A form an orthonormal basis of the space spanned by its rows on input
+//returns 1 on success, 0 on failiure
+//Parameters:
+//		A (input/output)	:	row-ordered (rows x cols) matrix, rows must not be larger than cols
+//		rows, cols (input)	:	matrix dimensions
+//      verbose             :   prints error messages to stdout
+int orthonormalize(double *A, int rows, int cols, bool verbose = false);
+
 } //namespace
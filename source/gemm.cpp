@@ -0,0 +1,297 @@
+//Copyright (C) 2011 by Ivan Fratric
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in
+//all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//THE SOFTWARE.
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gemm.h"
+#include "cpu.h"
+
+#ifdef LIBSUBSPACE_X86
+#include <immintrin.h>
+#endif
+
+#if defined(LIBSUBSPACE_NO_BLAS) || defined(LIBSUBSPACE_NATIVE_GEMM)
+#define GEMM_USE_NATIVE
+#endif
+
+#ifndef GEMM_USE_NATIVE
+extern "C" int dgemm_(const char *transa, const char *transb, int *m, int *n, int *k,
+	double *alpha, double *a, int *lda, double *b, int *ldb, 
+	double *beta, double *c, int *ldc);
+
+extern "C" int dsyrk_(const char *uplo, const char *trans, int *n, int *k,
+	double *alpha, double *a, int *lda, double *beta, double *c, int *ldc);
+#endif
+
+namespace LibSubspace {
+
+#ifdef GEMM_USE_NATIVE
+
+//block sizes used by the native implementation
+//the product is computed in (GEMM_MR x GEMM_NR) tiles of C that are kept in registers,
+//the operands are packed in blocks of (GEMM_MC x GEMM_KC) elements of op(A)
+//and (GEMM_KC x GEMM_NC) elements of op(B) so that they stay in cache
+#define GEMM_MR 6
+#define GEMM_NR 8
+#define GEMM_MC 96
+#define GEMM_KC 256
+#define GEMM_NC 2048
+
+//computes a (GEMM_MR x GEMM_NR) tile of alpha*A*B from the packed panels a and b
+//and stores it in out (row-ordered, GEMM_NR columns)
+typedef void (*GemmKernel)(long kc, double *a, double *b, double alpha, double *out);
+
+static void GemmKernelScalar(long kc, double *a, double *b, double alpha, double *out) {
+	double acc[GEMM_MR*GEMM_NR];
+	long i,j,p;
+
+	memset(acc,0,GEMM_MR*GEMM_NR*sizeof(double));
+	for(p=0;p<kc;p++) {
+		for(i=0;i<GEMM_MR;i++) {
+			for(j=0;j<GEMM_NR;j++) {
+				acc[i*GEMM_NR+j] += a[i]*b[j];
+			}
+		}
+		a += GEMM_MR;
+		b += GEMM_NR;
+	}
+	for(i=0;i<GEMM_MR*GEMM_NR;i++) {
+		out[i] = alpha*acc[i];
+	}
+}
+
+#ifdef LIBSUBSPACE_X86
+
+LIBSUBSPACE_TARGET_AVX2 static void GemmKernelAVX2(long kc, double *a, double *b, double alpha, double *out) {
+	__m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+	__m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+	__m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+	__m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+	__m256d c40 = _mm256_setzero_pd(), c41 = _mm256_setzero_pd();
+	__m256d c50 = _mm256_setzero_pd(), c51 = _mm256_setzero_pd();
+	__m256d b0,b1,ai;
+
+	for(long p=0;p<kc;p++) {
+		b0 = _mm256_loadu_pd(b);
+		b1 = _mm256_loadu_pd(b+4);
+		ai = _mm256_broadcast_sd(a);
+		c00 = _mm256_fmadd_pd(ai,b0,c00);
+		c01 = _mm256_fmadd_pd(ai,b1,c01);
+		ai = _mm256_broadcast_sd(a+1);
+		c10 = _mm256_fmadd_pd(ai,b0,c10);
+		c11 = _mm256_fmadd_pd(ai,b1,c11);
+		ai = _mm256_broadcast_sd(a+2);
+		c20 = _mm256_fmadd_pd(ai,b0,c20);
+		c21 = _mm256_fmadd_pd(ai,b1,c21);
+		ai = _mm256_broadcast_sd(a+3);
+		c30 = _mm256_fmadd_pd(ai,b0,c30);
+		c31 = _mm256_fmadd_pd(ai,b1,c31);
+		ai = _mm256_broadcast_sd(a+4);
+		c40 = _mm256_fmadd_pd(ai,b0,c40);
+		c41 = _mm256_fmadd_pd(ai,b1,c41);
+		ai = _mm256_broadcast_sd(a+5);
+		c50 = _mm256_fmadd_pd(ai,b0,c50);
+		c51 = _mm256_fmadd_pd(ai,b1,c51);
+		a += GEMM_MR;
+		b += GEMM_NR;
+	}
+
+	__m256d al = _mm256_set1_pd(alpha);
+	_mm256_storeu_pd(out, _mm256_mul_pd(al,c00));
+	_mm256_storeu_pd(out+4, _mm256_mul_pd(al,c01));
+	_mm256_storeu_pd(out+8, _mm256_mul_pd(al,c10));
+	_mm256_storeu_pd(out+12, _mm256_mul_pd(al,c11));
+	_mm256_storeu_pd(out+16, _mm256_mul_pd(al,c20));
+	_mm256_storeu_pd(out+20, _mm256_mul_pd(al,c21));
+	_mm256_storeu_pd(out+24, _mm256_mul_pd(al,c30));
+	_mm256_storeu_pd(out+28, _mm256_mul_pd(al,c31));
+	_mm256_storeu_pd(out+32, _mm256_mul_pd(al,c40));
+	_mm256_storeu_pd(out+36, _mm256_mul_pd(al,c41));
+	_mm256_storeu_pd(out+40, _mm256_mul_pd(al,c50));
+	_mm256_storeu_pd(out+44, _mm256_mul_pd(al,c51));
+}
+
+#endif
+
+//packs a (mc x kc) block of op(A), starting at row i0 and column p0, into panels of GEMM_MR rows
+//within a panel, the GEMM_MR elements of each column are stored consecutively
+//panels at the bottom edge are padded with zeros
+static void PackA(int transA, double *A, long lda, long i0, long p0, long mc, long kc, double *packed) {
+	long ir,i,p,mr;
+	for(ir=0;ir<mc;ir+=GEMM_MR) {
+		mr = (mc-ir < GEMM_MR) ? (mc-ir) : GEMM_MR;
+		for(p=0;p<kc;p++) {
+			for(i=0;i<mr;i++) {
+				if(transA == GEMM_TRANS) packed[i] = A[(p0+p)*lda+i0+ir+i];
+				else packed[i] = A[(i0+ir+i)*lda+p0+p];
+			}
+			for(i=mr;i<GEMM_MR;i++) packed[i] = 0;
+			packed += GEMM_MR;
+		}
+	}
+}
+
+//packs a (kc x nc) block of op(B), starting at row p0 and column j0, into panels of GEMM_NR columns
+//within a panel, the GEMM_NR elements of each row are stored consecutively
+//panels at the right edge are padded with zeros
+static void PackB(int transB, double *B, long ldb, long p0, long j0, long kc, long nc, double *packed) {
+	long jr,j,p,nr;
+	for(jr=0;jr<nc;jr+=GEMM_NR) {
+		nr = (nc-jr < GEMM_NR) ? (nc-jr) : GEMM_NR;
+		for(p=0;p<kc;p++) {
+			if(transB == GEMM_TRANS) {
+				for(j=0;j<nr;j++) packed[j] = B[(j0+jr+j)*ldb+p0+p];
+			} else {
+				memcpy(packed,&(B[(p0+p)*ldb+j0+jr]),nr*sizeof(double));
+			}
+			for(j=nr;j<GEMM_NR;j++) packed[j] = 0;
+			packed += GEMM_NR;
+		}
+	}
+}
+
+//cache-blocked matrix multiplication, used when BLAS is not available
+static void gemm_native(int transA, int transB, long m, long n, long k, double alpha, 
+	double *A, long lda, double *B, long ldb, double beta, double *C, long ldc)
+{
+	long i,j,ic,jc,pc,ir,jr,mc,nc,kc,mr,nr;
+	double tile[GEMM_MR*GEMM_NR];
+	double *dst;
+
+	//C = beta*C, the products are then accumulated into C
+	for(i=0;i<m;i++) {
+		dst = &(C[i*ldc]);
+		if(beta == 0) memset(dst,0,n*sizeof(double));
+		else if(beta != 1) for(j=0;j<n;j++) dst[j] *= beta;
+	}
+	if(alpha == 0) return;
+
+	GemmKernel kernel = GemmKernelScalar;
+#ifdef LIBSUBSPACE_X86
+	if(CpuSupportsAVX2()) kernel = GemmKernelAVX2;
+#endif
+
+	double *packedA = (double *)malloc(GEMM_MC*GEMM_KC*sizeof(double));
+	double *packedB = (double *)malloc(GEMM_KC*GEMM_NC*sizeof(double));
+
+	for(jc=0;jc<n;jc+=GEMM_NC) {
+		nc = (n-jc < GEMM_NC) ? (n-jc) : GEMM_NC;
+		for(pc=0;pc<k;pc+=GEMM_KC) {
+			kc = (k-pc < GEMM_KC) ? (k-pc) : GEMM_KC;
+			PackB(transB,B,ldb,pc,jc,kc,nc,packedB);
+			for(ic=0;ic<m;ic+=GEMM_MC) {
+				mc = (m-ic < GEMM_MC) ? (m-ic) : GEMM_MC;
+				PackA(transA,A,lda,ic,pc,mc,kc,packedA);
+				for(jr=0;jr<nc;jr+=GEMM_NR) {
+					nr = (nc-jr < GEMM_NR) ? (nc-jr) : GEMM_NR;
+					for(ir=0;ir<mc;ir+=GEMM_MR) {
+						mr = (mc-ir < GEMM_MR) ? (mc-ir) : GEMM_MR;
+						kernel(kc,&(packedA[ir*kc]),&(packedB[jr*kc]),alpha,tile);
+						for(i=0;i<mr;i++) {
+							dst = &(C[(ic+ir+i)*ldc+jc+jr]);
+							for(j=0;j<nr;j++) dst[j] += tile[i*GEMM_NR+j];
+						}
+					}
+				}
+			}
+		}
+	}
+
+	free(packedA);
+	free(packedB);
+}
+
+#endif
+
+void gemm(int transA, int transB, long m, long n, long k, double alpha, 
+	double *A, long lda, double *B, long ldb, double beta, double *C, long ldc)
+{
+	if((m<=0)||(n<=0)) return;
+
+	if(k<=0) {
+		//the product is empty, only scale C
+		for(long i=0;i<m;i++) {
+			for(long j=0;j<n;j++) {
+				if(beta == 0) C[i*ldc+j] = 0;
+				else C[i*ldc+j] *= beta;
+			}
+		}
+		return;
+	}
+
+#ifndef GEMM_USE_NATIVE
+	//BLAS expects column-ordered matrices
+	//a row-ordered matrix is seen as its transpose by BLAS, so we compute C' = op(B)'*op(A)'
+	int im = (int)m, in = (int)n, ik = (int)k;
+	int ilda = (int)lda, ildb = (int)ldb, ildc = (int)ldc;
+	const char *ta = (transA == GEMM_TRANS) ? "T" : "N";
+	const char *tb = (transB == GEMM_TRANS) ? "T" : "N";
+	dgemm_(tb,ta,&in,&im,&ik,&alpha,B,&ildb,A,&ilda,&beta,C,&ildc);
+#else
+	gemm_native(transA,transB,m,n,k,alpha,A,lda,B,ldb,beta,C,ldc);
+#endif
+}
+
+void syrk(int trans, long n, long k, double alpha, double *A, long lda, double beta, double *C, long ldc) {
+	long i,j;
+
+	if(n<=0) return;
+
+#ifndef GEMM_USE_NATIVE
+	if(k>0) {
+		//BLAS sees the row-ordered A as its transpose, so the transposition flag is reversed
+		//the upper triangle in BLAS (column-ordered) terms is the lower triangle of our C
+		int in = (int)n, ik = (int)k;
+		int ilda = (int)lda, ildc = (int)ldc;
+		const char *t = (trans == GEMM_TRANS) ? "N" : "T";
+		dsyrk_("U",t,&in,&ik,&alpha,A,&ilda,&beta,C,&ildc);
+	} else {
+		gemm(GEMM_NOTRANS,GEMM_TRANS,n,n,0,alpha,A,lda,A,lda,beta,C,ldc);
+	}
+	for(i=0;i<n;i++) {
+		for(j=i+1;j<n;j++) {
+			C[i*ldc+j] = C[j*ldc+i];
+		}
+	}
+#else
+	//computes the upper triangle one strip of rows at a time
+	//each strip also includes its (small) diagonal block in full
+	long ib,nb;
+	const long blocksize = GEMM_MC;
+	for(ib=0;ib<n;ib+=blocksize) {
+		nb = (n-ib < blocksize) ? (n-ib) : blocksize;
+		if(trans == GEMM_TRANS) {
+			gemm(GEMM_TRANS,GEMM_NOTRANS,nb,n-ib,k,alpha,&(A[ib]),lda,&(A[ib]),lda,beta,&(C[ib*ldc+ib]),ldc);
+		} else {
+			gemm(GEMM_NOTRANS,GEMM_TRANS,nb,n-ib,k,alpha,&(A[ib*lda]),lda,&(A[ib*lda]),lda,beta,&(C[ib*ldc+ib]),ldc);
+		}
+	}
+	for(i=0;i<n;i++) {
+		for(j=i+1;j<n;j++) {
+			C[j*ldc+i] = C[i*ldc+j];
+		}
+	}
+#endif
+}
+
+} //namespace
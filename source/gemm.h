@@ -0,0 +1,60 @@
+//Copyright (C) 2011 by Ivan Fratric
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in
+//all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//THE SOFTWARE.
+
+
+#define GEMM_NOTRANS 0
+#define GEMM_TRANS 1
+
+namespace LibSubspace {
+
+//computes the general matrix product C = alpha*op(A)*op(B) + beta*C
+//where op(X) is either X or its transpose X'
+//all matrices are row-ordered
+//by default the product is computed by the BLAS dgemm routine
+//if the library is built with LIBSUBSPACE_NO_BLAS (or LIBSUBSPACE_NATIVE_GEMM, e.g. when only a slow
+//reference BLAS is available) defined, a native cache-blocked implementation is used instead
+//the native implementation uses AVX2/FMA instructions if they are supported by the processor
+//its results differ from the straightforward triple loop only in the order of summation,
+//so each element of the result agrees with it to within 2*k*DBL_EPSILON*|alpha|*sum(|op(A)[i][p]|*|op(B)[p][j]|)
+//Parameters:
+//		transA, transB		:	GEMM_TRANS if the corresponding matrix should be transposed,
+//								GEMM_NOTRANS otherwise
+//		m, n, k				:	op(A) is a (m x k) matrix, op(B) is a (k x n) matrix and C is a (m x n) matrix
+//		alpha, beta			:	scalar multipliers, if beta is 0, C does not need to be initialized
+//		A, B, C				:	matrix data
+//		lda, ldb, ldc		:	row strides (distance in elements between the starts of two rows)
+//								of A, B and C as stored in memory
+void gemm(int transA, int transB, long m, long n, long k, double alpha, 
+	double *A, long lda, double *B, long ldb, double beta, double *C, long ldc);
+
+//computes the symmetric rank-k product C = alpha*op(A)*op(A)' + beta*C
+//where op(A) is either A or its transpose A'
+//all matrices are row-ordered
+//only one triangle of C is computed (by the BLAS dsyrk routine or the native gemm), 
+//the other one is then filled by mirroring it, so this takes about half the flops of gemm
+//Parameters:
+//		trans				:	GEMM_TRANS if A should be transposed, GEMM_NOTRANS otherwise
+//		n, k				:	op(A) is a (n x k) matrix and C is a (n x n) matrix
+//		alpha, beta			:	scalar multipliers, if beta is 0, C does not need to be initialized
+//		A, C				:	matrix data
+//		lda, ldc			:	row strides of A and C as stored in memory
+void syrk(int trans, long n, long k, double alpha, double *A, long lda, double beta, double *C, long ldc);
+
+} //namespace
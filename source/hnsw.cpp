@@ -0,0 +1,619 @@
+//Copyright (C) 2011 by Ivan Fratric
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in
+//all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//THE SOFTWARE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+#include "matrix.h"
+#include "sample.h"
+#include "classifier.h"
+#include "distance.h"
+#include "cpu.h"
+#include "hnsw.h"
+
+#ifdef LIBSUBSPACE_X86
+	#include <xmmintrin.h>
+#endif
+
+namespace LibSubspace {
+
+//binary max-heap of nodes and their distances, grows as needed
+//a min-heap is obtained by pushing negated distances
+struct NodeHeap {
+	long size;
+	long capacity;
+	double *key;
+	long *node;
+
+	NodeHeap(long capacity) {
+		size = 0;
+		this->capacity = capacity;
+		key = (double *)malloc(capacity*sizeof(double));
+		node = (long *)malloc(capacity*sizeof(long));
+	}
+
+	~NodeHeap() {
+		free(key);
+		free(node);
+	}
+
+	void Push(double k, long n) {
+		if(size == capacity) {
+			capacity *= 2;
+			key = (double *)realloc(key,capacity*sizeof(double));
+			node = (long *)realloc(node,capacity*sizeof(long));
+		}
+		long i = size++;
+		while((i > 0) && (key[(i-1)/2] < k)) {
+			key[i] = key[(i-1)/2];
+			node[i] = node[(i-1)/2];
+			i = (i-1)/2;
+		}
+		key[i] = k;
+		node[i] = n;
+	}
+
+	void Pop() {
+		size--;
+		if(size == 0) return;
+		double k = key[size];
+		long n = node[size];
+		long i = 0;
+		for(;;) {
+			long child = 2*i+1;
+			if(child >= size) break;
+			if((child+1 < size) && (key[child+1] > key[child])) child++;
+			if(key[child] <= k) break;
+			key[i] = key[child];
+			node[i] = node[child];
+			i = child;
+		}
+		key[i] = k;
+		node[i] = n;
+	}
+};
+
+//set of the nodes visited by a search, an open addressing hash table that grows as needed
+//a search visits only a small part of the graph, so this is faster than clearing a flag for every node
+struct VisitedNodes {
+	long capacity;	//power of 2
+	long size;
+	long *nodes;	//-1 for empty slots
+
+	//expected : expected number of visited nodes
+	VisitedNodes(long expected) {
+		capacity = 1024;
+		while(capacity < 2*expected) capacity *= 2;
+		size = 0;
+		nodes = (long *)malloc(capacity*sizeof(long));
+		memset(nodes,0xFF,capacity*sizeof(long));
+	}
+
+	~VisitedNodes() {
+		free(nodes);
+	}
+
+	//adds a node, returns false if it was already visited
+	bool Add(long n) {
+		if(2*(size+1) > capacity) Grow();
+		unsigned long long slot = ((unsigned long long)n * 0x9E3779B97F4A7C15ULL) & (capacity-1);
+		while(nodes[slot] >= 0) {
+			if(nodes[slot] == n) return false;
+			slot = (slot+1) & (capacity-1);
+		}
+		nodes[slot] = n;
+		size++;
+		return true;
+	}
+
+	void Grow() {
+		long *old = nodes;
+		long oldCapacity = capacity;
+		capacity *= 2;
+		size = 0;
+		nodes = (long *)malloc(capacity*sizeof(long));
+		memset(nodes,0xFF,capacity*sizeof(long));
+		for(long i = 0; i < oldCapacity; i++) {
+			if(old[i] >= 0) Add(old[i]);
+		}
+		free(old);
+	}
+};
+
+HNSWIndex::HNSWIndex() {
+	gallery = NULL;
+	vectors = NULL;
+	floatVectors = NULL;
+	distanceMeasure = DISTANCE_EUCLIDEAN;
+	numSamples = 0;
+	maxNeighbors = 0;
+	maxLevel = 0;
+	entryPoint = -1;
+	levels = NULL;
+	links0 = NULL;
+	links = NULL;
+
+	M = 16;
+	efConstruction = 200;
+	seed = 1;
+	efSearch = 64;
+	verbose = false;
+}
+
+HNSWIndex::~HNSWIndex() {
+	Clear();
+}
+
+void HNSWIndex::Clear() {
+	if(links) {
+		for(long i = 0; i < numSamples; i++) {
+			if(links[i]) free(links[i]);
+		}
+		free(links);
+	}
+	if(links0) free(links0);
+	if(levels) free(levels);
+	if(vectors) free(vectors);
+	if(floatVectors) free(floatVectors);
+	vectors = NULL;
+	floatVectors = NULL;
+	links = NULL;
+	links0 = NULL;
+	levels = NULL;
+	numSamples = 0;
+	maxLevel = 0;
+	entryPoint = -1;
+}
+
+void HNSWIndex::SetGallery(Gallery *gallery) {
+	this->gallery = gallery;
+	numSamples = gallery->Size();
+	//the pointers are kept in an array, as going through the sample set for every distance costs an additional cache miss
+	if(gallery->GetSamples()) {
+		vectors = (double **)malloc(numSamples*sizeof(double *));
+		for(long i = 0; i < numSamples; i++) vectors[i] = gallery->GetSamples()->GetSample(i)->GetData();
+	} else {
+		floatVectors = (float **)malloc(numSamples*sizeof(float *));
+		for(long i = 0; i < numSamples; i++) floatVectors[i] = gallery->GetFloatSamples()->GetSampleData(i);
+	}
+}
+
+int HNSWIndex::AllocateLinks() {
+	links0 = (int *)calloc(numSamples*(2*maxNeighbors+1),sizeof(int));
+	links = (int **)calloc(numSamples,sizeof(int *));
+	if(!links0 || !links) return 0;
+	for(long i = 0; i < numSamples; i++) {
+		if(!levels[i]) continue;
+		links[i] = (int *)calloc(levels[i]*(maxNeighbors+1),sizeof(int));
+		if(!links[i]) return 0;
+	}
+	return 1;
+}
+
+unsigned long long HNSWIndex::GetFingerprint() {
+	unsigned long long hash = HASH_INIT;
+	long dim = gallery ? gallery->GetDim() : 0;
+	for(long i = 0; i < numSamples; i++) {
+		if(vectors) hash = HashBytes(vectors[i],dim*sizeof(double),hash);
+		else hash = HashBytes(floatVectors[i],dim*sizeof(float),hash);
+	}
+	return hash;
+}
+
+void HNSWIndex::GetQuery(long i, Query *query) {
+	if(vectors) {
+		query->data = vectors[i];
+		query->floatData = NULL;
+		query->invnorm = gallery->GetInverseNorms()[i];
+	} else {
+		query->data = NULL;
+		query->floatData = floatVectors[i];
+		query->invnorm = gallery->GetFloatInverseNorms()[i];
+	}
+}
+
+double HNSWIndex::Distance(Query *query, long i) {
+	const DistanceKernels *kernels = GetDistanceKernels();
+	long dim = gallery->GetDim();
+	if(query->floatData) {
+		float *v = floatVectors[i];
+		if(distanceMeasure == DISTANCE_EUCLIDEAN) return kernels->squaredEuclideanFloat(v,query->floatData,dim);
+		return 1-(kernels->dotFloat(v,query->floatData,dim)*gallery->GetFloatInverseNorms()[i]*query->invnorm);
+	} else {
+		double *v = vectors[i];
+		if(distanceMeasure == DISTANCE_EUCLIDEAN) return kernels->squaredEuclidean(v,query->data,dim);
+		return 1-(kernels->dot(v,query->data,dim)*gallery->GetInverseNorms()[i]*query->invnorm);
+	}
+}
+
+void HNSWIndex::Prefetch(long i) {
+#ifdef LIBSUBSPACE_X86
+	char *v;
+	long size;
+	if(vectors) {
+		v = (char *)vectors[i];
+		size = gallery->GetDim()*sizeof(double);
+	} else {
+		v = (char *)floatVectors[i];
+		size = gallery->GetDim()*sizeof(float);
+	}
+	for(long offset = 0; offset < size; offset += 64) _mm_prefetch(v+offset,_MM_HINT_T0);
+#endif
+}
+
+double HNSWIndex::Distance(long i, long j) {
+	Query query;
+	GetQuery(i,&query);
+	return Distance(&query,j);
+}
+
+long HNSWIndex::SearchGreedy(Query *query, long start, int level) {
+	long current = start;
+	double dist = Distance(query,current);
+	bool changed = true;
+	while(changed) {
+		changed = false;
+		int *l = GetLinks(current,level);
+		for(long k = 1; k <= l[0]; k++) {
+			double d = Distance(query,l[k]);
+			if(d < dist) {
+				dist = d;
+				current = l[k];
+				changed = true;
+			}
+		}
+	}
+	return current;
+}
+
+long HNSWIndex::SearchLayer(Query *query, long start, long ef, int level, long *nearest, double *distances) {
+	VisitedNodes visited(ef*maxNeighbors);
+	NodeHeap candidates(ef);	//nodes whose links are still to be followed, closest first (negated distances)
+	NodeHeap results(ef+1);	//the ef closest nodes found so far, farthest first
+	long *pending = (long *)malloc(2*maxNeighbors*sizeof(long));	//unvisited links of the current node
+
+	double d = Distance(query,start);
+	visited.Add(start);
+	candidates.Push(-d,start);
+	results.Push(d,start);
+
+	while(candidates.size) {
+		//stop when the closest remaining candidate is farther than all of the results
+		if((-candidates.key[0] > results.key[0]) && (results.size == ef)) break;
+		long c = candidates.node[0];
+		candidates.Pop();
+
+		//the feature vectors of all unvisited links are requested from memory before the distances are computed,
+		//so that their cache misses overlap
+		int *l = GetLinks(c,level);
+		long numPending = 0;
+		for(long k = 1; k <= l[0]; k++) {
+			if(!visited.Add(l[k])) continue;
+			pending[numPending++] = l[k];
+			Prefetch(l[k]);
+		}
+
+		for(long k = 0; k < numPending; k++) {
+			long e = pending[k];
+			d = Distance(query,e);
+			if((results.size < ef) || (d < results.key[0])) {
+				candidates.Push(-d,e);
+				results.Push(d,e);
+				if(results.size > ef) results.Pop();
+			}
+		}
+	}
+
+	free(pending);
+
+	long found = results.size;
+	for(long k = found-1; k >= 0; k--) {
+		nearest[k] = results.node[0];
+		distances[k] = results.key[0];
+		results.Pop();
+	}
+	return found;
+}
+
+long HNSWIndex::SelectNeighbors(long *candidates, double *distances, long n, long maxLinks) {
+	long selected = 0;
+	for(long c = 0; (c < n) && (selected < maxLinks); c++) {
+		bool keep = true;
+		for(long s = 0; s < selected; s++) {
+			if(Distance(candidates[c],candidates[s]) < distances[c]) {
+				keep = false;
+				break;
+			}
+		}
+		if(!keep) continue;
+		long tmp = candidates[selected];
+		candidates[selected] = candidates[c];
+		candidates[c] = tmp;
+		double tmpd = distances[selected];
+		distances[selected] = distances[c];
+		distances[c] = tmpd;
+		selected++;
+	}
+	return selected;
+}
+
+void HNSWIndex::AddLink(long j, long i, int level) {
+	int *l = GetLinks(j,level);
+	long maxLinks = level ? maxNeighbors : 2*maxNeighbors;
+	if(l[0] < maxLinks) {
+		l[l[0]+1] = (int)i;
+		l[0]++;
+		return;
+	}
+
+	//the links of j are reselected from its current links and i, ordered by their distance to j
+	long n = maxLinks+1;
+	long *candidates = (long *)malloc(n*sizeof(long));
+	double *distances = (double *)malloc(n*sizeof(double));
+	Query query;
+	GetQuery(j,&query);
+	for(long k = 0; k < n; k++) {
+		long c = (k < maxLinks) ? l[k+1] : i;
+		double d = Distance(&query,c);
+		long pos = k;
+		while((pos > 0) && (distances[pos-1] > d)) {
+			candidates[pos] = candidates[pos-1];
+			distances[pos] = distances[pos-1];
+			pos--;
+		}
+		candidates[pos] = c;
+		distances[pos] = d;
+	}
+	long selected = SelectNeighbors(candidates,distances,n,maxLinks);
+	for(long k = 0; k < selected; k++) l[k+1] = (int)candidates[k];
+	l[0] = (int)selected;
+	free(distances);
+	free(candidates);
+}
+
+void HNSWIndex::Insert(long i, long *nearest, double *distances) {
+	int level = levels[i];
+	if(entryPoint < 0) {
+		entryPoint = i;
+		maxLevel = level;
+		return;
+	}
+
+	Query query;
+	GetQuery(i,&query);
+	long ef = (efConstruction > maxNeighbors) ? efConstruction : maxNeighbors;
+	long start = entryPoint;
+	int l;
+	for(l = maxLevel; l > level; l--) start = SearchGreedy(&query,start,l);
+	for(l = (level < maxLevel) ? level : maxLevel; l >= 0; l--) {
+		long found = SearchLayer(&query,start,ef,l,nearest,distances);
+		long selected = SelectNeighbors(nearest,distances,found,maxNeighbors);
+		int *own = GetLinks(i,l);
+		for(long k = 0; k < selected; k++) {
+			own[k+1] = (int)nearest[k];
+			AddLink(nearest[k],i,l);
+		}
+		own[0] = (int)selected;
+		start = nearest[0];
+	}
+
+	if(level > maxLevel) {
+		maxLevel = level;
+		entryPoint = i;
+	}
+}
+
+int HNSWIndex::Build(Gallery *gallery, int distanceMeasure) {
+	if((distanceMeasure != DISTANCE_EUCLIDEAN) && (distanceMeasure != DISTANCE_COSINE)) {
+		if(verbose) printf("Error: the index supports only the Euclidean and the cosine distance\n");
+		return 0;
+	}
+
+	Clear();
+	SetGallery(gallery);
+	this->distanceMeasure = distanceMeasure;
+	maxNeighbors = (M < 2) ? 2 : M;
+	if(maxNeighbors > HNSW_MAX_NEIGHBORS) maxNeighbors = HNSW_MAX_NEIGHBORS;
+
+	//the top layer of each node is drawn from a geometric distribution,
+	//a node on a layer is also on the next one with the probability 1/M
+	unsigned long long state = 0x9E3779B97F4A7C15ULL ^ (unsigned long long)seed;
+	if(!state) state = 1;
+	double levelFactor = 1/log((double)maxNeighbors);
+	levels = (int *)malloc(numSamples*sizeof(int));
+	if(!levels) {
+		if(verbose) printf("Error: not enough memory for the index\n");
+		Clear();
+		return 0;
+	}
+	for(long i = 0; i < numSamples; i++) {
+		levels[i] = (int)(-log(RandomUniform(&state))*levelFactor);
+		if(levels[i] >= HNSW_MAX_LEVELS) levels[i] = HNSW_MAX_LEVELS-1;
+	}
+	if(!AllocateLinks()) {
+		if(verbose) printf("Error: not enough memory for the index\n");
+		Clear();
+		return 0;
+	}
+
+	long ef = (efConstruction > maxNeighbors) ? efConstruction : maxNeighbors;
+	long *nearest = (long *)malloc(ef*sizeof(long));
+	double *distances = (double *)malloc(ef*sizeof(double));
+	for(long i = 0; i < numSamples; i++) {
+		Insert(i,nearest,distances);
+		if(verbose && ((i+1)%10000 == 0)) printf("%ld samples indexed\n",i+1);
+	}
+	free(distances);
+	free(nearest);
+
+	return 1;
+}
+
+long HNSWIndex::Search(Query *query, void *exclude, long k, long *nearest, double *distances) {
+	if((entryPoint < 0) || (k <= 0)) return 0;
+
+	//one more sample is searched for, in case the query itself is found
+	long ef = (efSearch > k) ? efSearch : k+1;
+	long start = entryPoint;
+	for(int l = maxLevel; l > 0; l--) start = SearchGreedy(query,start,l);
+
+	long *found = (long *)malloc(ef*sizeof(long));
+	double *d = (double *)malloc(ef*sizeof(double));
+	long n = SearchLayer(query,start,ef,0,found,d);
+
+	long count = 0;
+	for(long j = 0; (j < n) && (count < k); j++) {
+		void *data = query->floatData ? (void *)floatVectors[found[j]] : (void *)vectors[found[j]];
+		if(data == exclude) continue;
+		nearest[count] = found[j];
+		if(distances) distances[count] = (distanceMeasure == DISTANCE_EUCLIDEAN) ? sqrt(d[j]) : d[j];
+		count++;
+	}
+
+	free(d);
+	free(found);
+	return count;
+}
+
+long HNSWIndex::Search(double *query, long k, long *nearest, double *distances) {
+	if(!vectors) return 0;
+	Query q;
+	q.data = query;
+	q.floatData = NULL;
+	q.invnorm = 0;
+	if(distanceMeasure == DISTANCE_COSINE) q.invnorm = 1/sqrt(GetDistanceKernels()->dot(query,query,gallery->GetDim()));
+	return Search(&q,query,k,nearest,distances);
+}
+
+long HNSWIndex::Search(float *query, long k, long *nearest, double *distances) {
+	if(!floatVectors) return 0;
+	Query q;
+	q.data = NULL;
+	q.floatData = query;
+	q.invnorm = 0;
+	if(distanceMeasure == DISTANCE_COSINE) q.invnorm = 1/sqrtf(GetDistanceKernels()->dotFloat(query,query,gallery->GetDim()));
+	return Search(&q,query,k,nearest,distances);
+}
+
+void HNSWIndex::Save(FILE *fp) {
+	long dim = gallery ? gallery->GetDim() : 0;
+	long measure = distanceMeasure;
+	long level = maxLevel;
+	fwrite(&numSamples,1,sizeof(long),fp);
+	fwrite(&dim,1,sizeof(long),fp);
+	fwrite(&measure,1,sizeof(long),fp);
+	fwrite(&maxNeighbors,1,sizeof(long),fp);
+	fwrite(&level,1,sizeof(long),fp);
+	fwrite(&entryPoint,1,sizeof(long),fp);
+	unsigned long long fingerprint = GetFingerprint();
+	fwrite(&fingerprint,1,sizeof(unsigned long long),fp);
+	if(!numSamples) return;
+	fwrite(levels,numSamples,sizeof(int),fp);
+	fwrite(links0,numSamples*(2*maxNeighbors+1),sizeof(int),fp);
+	for(long i = 0; i < numSamples; i++) {
+		if(levels[i]) fwrite(links[i],levels[i]*(maxNeighbors+1),sizeof(int),fp);
+	}
+}
+
+int HNSWIndex::Save(char *filename) {
+	FILE *fp;
+	fp = fopen(filename,"wb");
+	if(!fp) return 0;
+	Save(fp);
+	fclose(fp);
+	return 1;
+}
+
+int HNSWIndex::Load(FILE *fp, Gallery *gallery) {
+	long header[6];
+	if(fread(header,sizeof(long),6,fp) != 6) return 0;
+	unsigned long long fingerprint;
+	if(fread(&fingerprint,sizeof(unsigned long long),1,fp) != 1) return 0;
+	if((header[0] != gallery->Size()) || (header[1] != gallery->GetDim())) {
+		if(verbose) printf("Error: the index was built for a different gallery\n");
+		return 0;
+	}
+	if((header[2] != DISTANCE_EUCLIDEAN) && (header[2] != DISTANCE_COSINE)) return 0;
+	if((header[3] < 2) || (header[3] > HNSW_MAX_NEIGHBORS) || (header[4] < 0) || (header[4] >= HNSW_MAX_LEVELS)) return 0;
+	if(header[0] && ((header[5] < 0) || (header[5] >= header[0]))) return 0;
+
+	Clear();
+	SetGallery(gallery);
+	if(GetFingerprint() != fingerprint) {
+		if(verbose) printf("Error: the index was built for a different gallery\n");
+		Clear();
+		return 0;
+	}
+	distanceMeasure = (int)header[2];
+	maxNeighbors = header[3];
+	maxLevel = (int)header[4];
+	entryPoint = header[5];
+	if(!numSamples) return 1;
+
+	levels = (int *)malloc(numSamples*sizeof(int));
+	if(!levels || (fread(levels,sizeof(int),numSamples,fp) != (size_t)numSamples)) {
+		Clear();
+		return 0;
+	}
+	for(long i = 0; i < numSamples; i++) {
+		if((levels[i] < 0) || (levels[i] > maxLevel)) {
+			Clear();
+			return 0;
+		}
+	}
+	if(!AllocateLinks()) {
+		Clear();
+		return 0;
+	}
+	bool ok = (fread(links0,sizeof(int),numSamples*(2*maxNeighbors+1),fp) == (size_t)(numSamples*(2*maxNeighbors+1)));
+	for(long i = 0; ok && (i < numSamples); i++) {
+		if(levels[i]) ok = (fread(links[i],sizeof(int),levels[i]*(maxNeighbors+1),fp) == (size_t)(levels[i]*(maxNeighbors+1)));
+	}
+	//the numbers of links and the linked nodes are used as indices by the search, so they are checked
+	ok = ok && (levels[entryPoint] == maxLevel);
+	for(long i = 0; ok && (i < numSamples); i++) {
+		for(int level = 0; ok && (level <= levels[i]); level++) {
+			int *l = GetLinks(i,level);
+			long maxLinks = level ? maxNeighbors : 2*maxNeighbors;
+			ok = (l[0] >= 0) && (l[0] <= maxLinks);
+			for(int j = 1; ok && (j <= l[0]); j++) {
+				ok = (l[j] >= 0) && (l[j] < numSamples);
+			}
+		}
+	}
+	if(!ok) {
+		Clear();
+		return 0;
+	}
+	return 1;
+}
+
+int HNSWIndex::Load(char *filename, Gallery *gallery) {
+	FILE *fp;
+	fp = fopen(filename,"rb");
+	if(!fp) return 0;
+	int ret = Load(fp,gallery);
+	fclose(fp);
+	return ret;
+}
+
+} //namespace
@@ -0,0 +1,176 @@
+//Copyright (C) 2011 by Ivan Fratric
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in
+//all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//THE SOFTWARE.
+
+
+//largest M of an index
+#define HNSW_MAX_NEIGHBORS 65536
+
+//number of layers of an index, the top layer of a node is below it
+//with M = 2, a node reaches the layer 53 only with the probability 2^-53
+#define HNSW_MAX_LEVELS 64
+
+namespace LibSubspace {
+
+//approximate nearest neighbor index of the base samples of a gallery
+//the base samples are the nodes of a hierarchical navigable small world (HNSW) graph, see
+//Y. A. Malkov, D. A. Yashunin, "Efficient and robust approximate nearest neighbor search using
+//Hierarchical Navigable Small World graphs", IEEE TPAMI, Vol. 42, No. 4, 2020, pp. 824-836.
+//each sample is linked to its close neighbors on the bottom layer and on a random number of sparser upper layers
+//a search descends greedily through the upper layers and then explores the bottom layer,
+//visiting only a small part of the gallery, so the nearest sample found is not always the exact nearest sample
+//supports the Euclidean and the cosine distance, in the precision of the gallery samples
+//the index refers to the gallery, which must not be changed or deleted while the index is used
+//searches do not change the index and can be performed by several threads at once
+class HNSWIndex {
+protected:
+	Gallery *gallery;
+	double **vectors;	//feature vectors of the base samples, if the gallery is of double precision samples
+	float **floatVectors;	//feature vectors of the base samples, if the gallery is of single precision samples
+	int distanceMeasure;
+	long numSamples;
+	long maxNeighbors;	//M of the index, maximum number of links of a node on the upper layers, 2*M on the bottom layer
+	int maxLevel;	//top layer of the graph
+	long entryPoint;	//node on the top layer where the searches start, -1 if the index is empty
+	int *levels;	//top layer of each node
+	int *links0;	//bottom layer links, (2*M+1) ints for each node: the number of links followed by the linked nodes
+	int **links;	//upper layer links of each node, (M+1) ints for each of its upper layers, NULL for nodes only on the bottom layer
+
+	//feature vector compared with the base samples, in the precision of the gallery
+	struct Query {
+		double *data;
+		float *floatData;
+		double invnorm;	//inverse norm of the vector, used with the cosine distance
+	};
+
+	//frees the graph
+	void Clear();
+
+	//sets the gallery and the feature vectors of its samples
+	void SetGallery(Gallery *gallery);
+
+	//allocates the links of the nodes, levels must be set
+	//returns 0 if there is not enough memory
+	int AllocateLinks();
+
+	//returns the links of node i on the given layer, the first element is the number of links
+	int *GetLinks(long i, int level) {
+		return level ? &(links[i][(level-1)*(maxNeighbors+1)]) : &(links0[i*(2*maxNeighbors+1)]);
+	}
+
+	//returns a hash of the feature vectors of the base samples (see HashBytes), stored in the index file
+	//so that an index is not loaded for other samples of the same number and dimensionality
+	unsigned long long GetFingerprint();
+
+	//sets up a query for the feature vector of the i-th base sample
+	void GetQuery(long i, Query *query);
+
+	//starts loading the feature vector of the i-th base sample into the cache
+	void Prefetch(long i);
+
+	//returns the distance of a query to the i-th base sample, the Euclidean distance is squared
+	double Distance(Query *query, long i);
+
+	//returns the distance of the i-th and the j-th base sample, the Euclidean distance is squared
+	double Distance(long i, long j);
+
+	//returns the node closest to the query on the given layer, reached by moving greedily from node start
+	long SearchGreedy(Query *query, long start, int level);
+
+	//finds the ef nodes closest to the query on the given layer, starting from node start
+	//on return, the nodes are in nearest and their distances in distances, ordered by increasing distance
+	//returns the number of nodes found
+	long SearchLayer(Query *query, long start, long ef, int level, long *nearest, double *distances);
+
+	//selects at most maxLinks of the n candidates (ordered by increasing distance) as the links of a node,
+	//a candidate is skipped if it is closer to a selected candidate than to the node, which keeps links in different directions
+	//the selected candidates are moved to the front of the arrays, returns their number
+	long SelectNeighbors(long *candidates, double *distances, long n, long maxLinks);
+
+	//links node i to node j on the given layer, if j already has the maximum number of links they are reselected
+	void AddLink(long j, long i, int level);
+
+	//inserts the i-th base sample into the graph
+	void Insert(long i, long *nearest, double *distances);
+
+	//searches the index, see Search
+	long Search(Query *query, void *exclude, long k, long *nearest, double *distances);
+
+public:
+	//build parameters, used by Build
+	//maximum number of links of a node on the upper layers, nodes on the bottom layer have up to 2*M links
+	//larger values improve recall, but increase the size of the index and the time of searches, 16 by default
+	//values are limited to 2..HNSW_MAX_NEIGHBORS
+	long M;
+	//number of candidate neighbors examined when a sample is inserted, larger values give a better graph
+	//at the cost of a slower build, 200 by default
+	long efConstruction;
+	//seed of the random number generator that assigns the samples to layers
+	unsigned long seed;
+
+	//search parameter, the number of candidates examined by a search (at least the number of samples searched for)
+	//larger values improve recall at the cost of slower searches, 64 by default
+	long efSearch;
+
+	//if true, prints progress information while building
+	bool verbose;
+
+	//constructor/destructor
+	HNSWIndex();
+	~HNSWIndex();
+
+	//builds the index over the base samples of a gallery
+	//distanceMeasure is DISTANCE_EUCLIDEAN or DISTANCE_COSINE
+	//the samples are inserted in order, so the index is the same for the same parameters
+	//returns 0 if the distance measure is not supported or there is not enough memory
+	int Build(Gallery *gallery, int distanceMeasure);
+
+	//finds approximately the k base samples closest to a feature vector of the precision of the gallery samples
+	//nearest receives the indices of the samples, ordered by increasing distance, and distances (if not NULL) their distances
+	//a base sample whose feature vector is the query itself is never returned, as in OneNNClassifier,
+	//which enables leave-one-out tests
+	//returns the number of samples found, at most k
+	long Search(double *query, long k, long *nearest, double *distances = NULL);
+	long Search(float *query, long k, long *nearest, double *distances = NULL);
+
+	//property getters
+	Gallery *GetGallery() {
+		return gallery;
+	}
+
+	int GetDistanceMeasure() {
+		return distanceMeasure;
+	}
+
+	//saves the index to a file given as filename, returns 0 on error
+	//the base samples are not stored, the index is loaded for the same gallery
+	int Save(char *filename);
+
+	//saves the index to a file given as file pointer, for example after the subspace the samples were projected into
+	void Save(FILE *fp);
+
+	//loads an index of the samples of the gallery from a file given as filename
+	//returns 0 on error, or if the index was not built for a gallery with the same feature vectors
+	int Load(char *filename, Gallery *gallery);
+
+	//loads an index from a file given as file pointer
+	int Load(FILE *fp, Gallery *gallery);
+};
+
+} //namespace
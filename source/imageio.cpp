@@ -60,7 +60,7 @@ int ImageIO::GetImageType(char *filename) {
 void ImageIO::LoadImage(char *filename, Image *image) {
 	int imgType = GetImageType(filename);
 	if(imgType == IMGTYPE_UNSUPPORTED) {
-		printf("Error loading image %s, unsupported image type!\n", filename);
+		if(verbose) printf("Error loading image %s, unsupported image type!\n", filename);
 		return;
 	}
 	LoadImage(filename, image, imgType);
@@ -86,7 +86,7 @@ void ImageIO::LoadImage(char *filename, Image *image, int imageType) {
 void ImageIO::LoadImageBMP(char *filename, Image *image) {
 	FILE *fp = fopen(filename,"rb");
 	if(!fp) {
-		printf("Error opening %s!\n", filename);
+		if(verbose) printf("Error opening %s!\n", filename);
 		return;
 	}
 
@@ -94,7 +94,7 @@ void ImageIO::LoadImageBMP(char *filename, Image *image) {
 	fread(header,1,2,fp);
 	if(!((header[0]=='B')&&(header[1]=='M'))) {
 		fclose(fp);
-		printf("Error loading image %s, wrong file format!\n",filename);
+		if(verbose) printf("Error loading image %s, wrong file format!\n",filename);
 		return;
 	}
 
@@ -111,7 +111,7 @@ void ImageIO::LoadImageBMP(char *filename, Image *image) {
 	fread(&bpp,2,1,fp);
 	if(!((bpp==8)||(bpp==24))) {
 		fclose(fp);
-		printf("Error loading image %s, can only load BMP files with 8 or 24 bpp!\n",filename);
+		if(verbose) printf("Error loading image %s, can only load BMP files with 8 or 24 bpp!\n",filename);
 		return;
 	}
 
@@ -119,7 +119,7 @@ void ImageIO::LoadImageBMP(char *filename, Image *image) {
 	fread(&compression,4,1,fp);
 	if(compression) {
 		fclose(fp);
-		printf("Error loading image %s, can only load uncompressed BMP files!\n",filename);
+		if(verbose) printf("Error loading image %s, can only load uncompressed BMP files!\n",filename);
 		return;
 	}
 
@@ -287,7 +287,7 @@ void ImageIO::SaveImageBMP(char *filename, Image *image) {
 void ImageIO::LoadImagePPM(char *filename, Image *image) {
 	FILE *fp = fopen(filename,"rb");
 	if(!fp) {
-		printf("Error opening %s!\n", filename);
+		if(verbose) printf("Error opening %s!\n", filename);
 		return;
 	}
 
@@ -306,7 +306,7 @@ void ImageIO::LoadImagePPM(char *filename, Image *image) {
 	if((strncmp(id,"P6",2)!=0)||(levels!=255)) {
 		free(buffer);
 		fclose(fp);
-		printf("Error loading image %s, wrong file format!\n",filename);
+		if(verbose) printf("Error loading image %s, wrong file format!\n",filename);
 		return;
 	}
 
@@ -335,7 +335,7 @@ void ImageIO::LoadImagePPM(char *filename, Image *image) {
 void ImageIO::LoadImagePGM(char *filename, Image *image) {
 	FILE *fp = fopen(filename,"rb");
 	if(!fp) {
-		printf("Error opening %s!\n", filename);
+		if(verbose) printf("Error opening %s!\n", filename);
 		return;
 	}
 
@@ -354,7 +354,7 @@ void ImageIO::LoadImagePGM(char *filename, Image *image) {
 	if((strncmp(id,"P5",2)!=0)||(levels!=255)) {
 		free(buffer);
 		fclose(fp);
-		printf("Error loading image %s, wrong file format!\n",filename);
+		if(verbose) printf("Error loading image %s, wrong file format!\n",filename);
 		return;
 	}
 
@@ -433,7 +433,7 @@ void ImageIO::SaveImagePGM(char *filename, Image *image) {
 void ImageIO::LoadImageRAW(char *filename, Image *image, long width, long height) {
 	FILE *fp = fopen(filename,"rb");
 	if(!fp) {
-		printf("Error opening %s!\n", filename);
+		if(verbose) printf("Error opening %s!\n", filename);
 		return;
 	}
 
@@ -446,7 +446,7 @@ void ImageIO::LoadImageRAW(char *filename, Image *image, long width, long height
 		height = width;
 		if((height*width)!=filesize) {
 			fclose(fp);
-			printf("Error loading image %s, wrong file format!\n",filename);
+			if(verbose) printf("Error loading image %s, wrong file format!\n",filename);
 			return;	
 		}
 	}
@@ -41,6 +41,12 @@ protected:
 	int GetImageType(char *filename);
 
 public:
+	//prints the reason when an image can not be loaded, true by default
+	bool verbose;
+
+	ImageIO() {
+		verbose = true;
+	}
 
 	//loads the image from filename into image
 	//automatically determines the image format
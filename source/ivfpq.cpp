@@ -0,0 +1,663 @@
+//Copyright (C) 2011 by Ivan Fratric
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in
+//all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//THE SOFTWARE.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+#include "matrix.h"
+#include "sample.h"
+#include "classifier.h"
+#include "distance.h"
+#include "gemm.h"
+#include "parallel.h"
+#include "ivfpq.h"
+
+//number of vectors assigned to centroids at once
+#define IVFPQ_BLOCK_SIZE 64
+
+//number of code blocks whose distances are computed at once by a search
+#define IVFPQ_SCAN_BLOCKS 64
+
+namespace LibSubspace {
+
+//moves k randomly chosen elements of an array of n elements to its front
+static void RandomSubset(long *elements, long n, long k, unsigned long long *state) {
+	for(long i = 0; i < k; i++) {
+		long j = i + (long)(RandomUniform(state)*(n-i));
+		if(j >= n) j = n-1;
+		long t = elements[i]; elements[i] = elements[j]; elements[j] = t;
+	}
+}
+
+//finds the closest of k centroids (rows of centroids) for each of the n vectors in the rows of data
+//ldd is the row stride of data, norms are the squared norms of the centroids, tile is a buffer of n*k doubles
+//||x-c||^2 = ||x||^2 - 2*x.c + ||c||^2, where ||x||^2 does not change the closest centroid
+static void NearestCentroids(double *data, long ldd, long n, long d, double *centroids, double *norms, long k, double *tile, long *nearest) {
+	gemm(GEMM_NOTRANS,GEMM_TRANS,n,k,d,-2.0,data,ldd,centroids,d,0.0,tile,k);
+	for(long i = 0; i < n; i++) {
+		double *row = &(tile[i*k]);
+		long best = 0;
+		for(long c = 1; c < k; c++) {
+			if(row[c]+norms[c] < row[best]+norms[best]) best = c;
+		}
+		nearest[i] = best;
+	}
+}
+
+//state of a parallel assignment of vectors to centroids, see AssignToCentroids
+struct CentroidAssignment {
+	double *data;
+	long ldd;
+	long n;
+	long d;
+	double *centroids;
+	double *norms;
+	long k;
+	long *nearest;
+};
+
+static void AssignBlock(long i, void *context) {
+	CentroidAssignment *a = (CentroidAssignment *)context;
+	long first = i*IVFPQ_BLOCK_SIZE;
+	long n = (a->n-first < IVFPQ_BLOCK_SIZE) ? (a->n-first) : IVFPQ_BLOCK_SIZE;
+	double *tile = (double *)malloc(n*a->k*sizeof(double));
+	NearestCentroids(&(a->data[first*a->ldd]),a->ldd,n,a->d,a->centroids,a->norms,a->k,tile,&(a->nearest[first]));
+	free(tile);
+}
+
+//finds the closest of k centroids for each of the n vectors in the rows of data, in parallel
+static void AssignToCentroids(double *data, long ldd, long n, long d, double *centroids, long k, int numThreads, long *nearest) {
+	const DistanceKernels *kernels = GetDistanceKernels();
+	double *norms = (double *)malloc(k*sizeof(double));
+	for(long c = 0; c < k; c++) norms[c] = kernels->dot(&(centroids[c*d]),&(centroids[c*d]),d);
+	CentroidAssignment a = {data,ldd,n,d,centroids,norms,k,nearest};
+	ParallelFor((n+IVFPQ_BLOCK_SIZE-1)/IVFPQ_BLOCK_SIZE,numThreads,AssignBlock,&a);
+	free(norms);
+}
+
+//clusters the n vectors in the rows of data (row stride ldd, dimensionality d) into k clusters by k-means, k <= n
+//centroids receives the (k x d) cluster centroids, assignment the cluster of each vector
+//the initial centroids are randomly chosen vectors, an empty cluster is moved to another random vector
+static void KMeans(double *data, long ldd, long n, long d, long k, long iterations, int numThreads,
+	unsigned long long *state, double *centroids, long *assignment) {
+	long i,c;
+	long *order = (long *)malloc(n*sizeof(long));
+	for(i = 0; i < n; i++) order[i] = i;
+	RandomSubset(order,n,k,state);
+	for(c = 0; c < k; c++) memcpy(&(centroids[c*d]),&(data[order[c]*ldd]),d*sizeof(double));
+	free(order);
+
+	long *previous = (long *)malloc(n*sizeof(long));
+	long *counts = (long *)malloc(k*sizeof(long));
+	for(long it = 0; ; it++) {
+		AssignToCentroids(data,ldd,n,d,centroids,k,numThreads,assignment);
+		if(it == iterations) break;
+		if(it && !memcmp(previous,assignment,n*sizeof(long))) break;
+		memcpy(previous,assignment,n*sizeof(long));
+
+		memset(centroids,0,k*d*sizeof(double));
+		memset(counts,0,k*sizeof(long));
+		for(i = 0; i < n; i++) {
+			double *v = &(data[i*ldd]);
+			double *centroid = &(centroids[assignment[i]*d]);
+			for(long j = 0; j < d; j++) centroid[j] += v[j];
+			counts[assignment[i]]++;
+		}
+		for(c = 0; c < k; c++) {
+			double *centroid = &(centroids[c*d]);
+			if(counts[c]) {
+				for(long j = 0; j < d; j++) centroid[j] /= counts[c];
+			} else {
+				long r = (long)(RandomUniform(state)*n);
+				if(r >= n) r = n-1;
+				memcpy(centroid,&(data[r*ldd]),d*sizeof(double));
+			}
+		}
+	}
+	free(counts);
+	free(previous);
+}
+
+//bounded max-heap of the candidates closest to a query
+struct CandidateHeap {
+	long size;
+	long capacity;
+	float *key;
+	long *id;
+
+	CandidateHeap(long capacity) {
+		size = 0;
+		this->capacity = capacity;
+		key = (float *)malloc(capacity*sizeof(float));
+		id = (long *)malloc(capacity*sizeof(long));
+	}
+
+	~CandidateHeap() {
+		free(key);
+		free(id);
+	}
+
+	//returns true if a candidate at distance k would be added
+	bool Accepts(float k) {
+		return (size < capacity) || (k < key[0]);
+	}
+
+	void Push(float k, long n) {
+		long i;
+		if(size < capacity) {
+			i = size++;
+			while((i > 0) && (key[(i-1)/2] < k)) {
+				key[i] = key[(i-1)/2];
+				id[i] = id[(i-1)/2];
+				i = (i-1)/2;
+			}
+		} else {
+			//replaces the farthest candidate
+			i = 0;
+			for(;;) {
+				long child = 2*i+1;
+				if(child >= size) break;
+				if((child+1 < size) && (key[child+1] > key[child])) child++;
+				if(key[child] <= k) break;
+				key[i] = key[child];
+				id[i] = id[child];
+				i = child;
+			}
+		}
+		key[i] = k;
+		id[i] = n;
+	}
+};
+
+//a search result, ordered by distance and then by index
+struct IndexedDistance {
+	double distance;
+	long id;
+};
+
+static int IndexedDistanceCompare(const void *a, const void *b) {
+	const IndexedDistance *x = (const IndexedDistance *)a;
+	const IndexedDistance *y = (const IndexedDistance *)b;
+	if(x->distance < y->distance) return -1;
+	if(x->distance > y->distance) return 1;
+	if(x->id < y->id) return -1;
+	if(x->id > y->id) return 1;
+	return 0;
+}
+
+IVFPQIndex::IVFPQIndex() {
+	baseSamples = NULL;
+	distanceMeasure = DISTANCE_EUCLIDEAN;
+	dim = 0;
+	numCells = 0;
+	numParts = 0;
+	partOffsets = NULL;
+	centroids = NULL;
+	codebooks = NULL;
+	tableCodebooks = NULL;
+	numSamples = 0;
+	listStart = NULL;
+	ids = NULL;
+	codes = NULL;
+
+	numLists = 256;
+	numSubquantizers = 16;
+	iterations = 20;
+	maxTrainingSamples = 65536;
+	seed = 1;
+	numProbes = 8;
+	numRerank = 100;
+	numThreads = 0;
+	verbose = false;
+}
+
+IVFPQIndex::~IVFPQIndex() {
+	Clear();
+}
+
+void IVFPQIndex::ClearLists() {
+	if(listStart) free(listStart);
+	if(ids) free(ids);
+	if(codes) free(codes);
+	listStart = NULL;
+	ids = NULL;
+	codes = NULL;
+	numSamples = 0;
+	baseSamples = NULL;
+}
+
+void IVFPQIndex::Clear() {
+	ClearLists();
+	if(partOffsets) free(partOffsets);
+	if(centroids) free(centroids);
+	if(codebooks) free(codebooks);
+	if(tableCodebooks) free(tableCodebooks);
+	partOffsets = NULL;
+	centroids = NULL;
+	codebooks = NULL;
+	tableCodebooks = NULL;
+	numCells = 0;
+	numParts = 0;
+	dim = 0;
+}
+
+void IVFPQIndex::InitTableCodebooks() {
+	tableCodebooks = (float *)malloc(256*dim*sizeof(float));
+	for(long j = 0; j < numParts; j++) {
+		long d = partOffsets[j+1]-partOffsets[j];
+		double *codebook = &(codebooks[256*partOffsets[j]]);
+		for(long t = 0; t < d; t++) {
+			float *values = &(tableCodebooks[256*(partOffsets[j]+t)]);
+			for(long c = 0; c < 256; c++) values[c] = (float)codebook[c*d+t];
+		}
+	}
+}
+
+unsigned long long IVFPQIndex::GetFingerprint(SampleSet *samples) {
+	unsigned long long hash = HASH_INIT;
+	for(long i = 0; i < samples->Size(); i++) {
+		Sample *sample = samples->GetSample(i);
+		long n = (sample->Size() < dim) ? sample->Size() : dim;
+		hash = HashBytes(sample->GetData(),n*sizeof(double),hash);
+	}
+	return hash;
+}
+
+void IVFPQIndex::GetVector(double *data, double *vector) {
+	memcpy(vector,data,dim*sizeof(double));
+	if(distanceMeasure != DISTANCE_COSINE) return;
+	double norm = GetDistanceKernels()->dot(vector,vector,dim);
+	if(norm <= 0) return;
+	double invnorm = 1/sqrt(norm);
+	for(long i = 0; i < dim; i++) vector[i] *= invnorm;
+}
+
+int IVFPQIndex::Train(SampleSet *samples, int distanceMeasure, long dim) {
+	long i,j;
+	if((distanceMeasure != DISTANCE_EUCLIDEAN) && (distanceMeasure != DISTANCE_COSINE)) {
+		if(verbose) printf("Error: the index supports only the Euclidean and the cosine distance\n");
+		return 0;
+	}
+	if(!samples->Size()) return 0;
+	if((!dim)||(dim>(*samples)[0].Size())) dim = (*samples)[0].Size();
+	if(!dim) return 0;
+
+	Clear();
+	this->distanceMeasure = distanceMeasure;
+	this->dim = dim;
+
+	//the training vectors are a random subset of the samples
+	unsigned long long state = 0x9E3779B97F4A7C15ULL ^ (unsigned long long)seed;
+	if(!state) state = 1;
+	long n = samples->Size();
+	long *order = (long *)malloc(n*sizeof(long));
+	for(i = 0; i < n; i++) order[i] = i;
+	if((maxTrainingSamples > 0) && (n > maxTrainingSamples)) {
+		RandomSubset(order,n,maxTrainingSamples,&state);
+		n = maxTrainingSamples;
+	}
+	double *data = (double *)malloc(n*dim*sizeof(double));
+	for(i = 0; i < n; i++) GetVector(samples->GetSample(order[i])->GetData(),&(data[i*dim]));
+	free(order);
+
+	numCells = (numLists < 1) ? 1 : numLists;
+	if(numCells > n) numCells = n;
+	numParts = (numSubquantizers < 1) ? 1 : numSubquantizers;
+	if(numParts > dim) numParts = dim;
+	partOffsets = (long *)malloc((numParts+1)*sizeof(long));
+	for(j = 0; j <= numParts; j++) partOffsets[j] = j*dim/numParts;
+
+	if(verbose) printf("Learning %ld cells from %ld samples\n",numCells,n);
+	centroids = (double *)malloc(numCells*dim*sizeof(double));
+	long *assignment = (long *)malloc(n*sizeof(long));
+	KMeans(data,dim,n,dim,numCells,iterations,numThreads,&state,centroids,assignment);
+
+	//the part centroids are learned from the residuals
+	for(i = 0; i < n; i++) {
+		double *v = &(data[i*dim]);
+		double *centroid = &(centroids[assignment[i]*dim]);
+		for(j = 0; j < dim; j++) v[j] -= centroid[j];
+	}
+	if(verbose) printf("Learning the centroids of %ld parts\n",numParts);
+	codebooks = (double *)malloc(256*dim*sizeof(double));
+	long numCodes = (n < 256) ? n : 256;
+	for(j = 0; j < numParts; j++) {
+		long d = partOffsets[j+1]-partOffsets[j];
+		double *codebook = &(codebooks[256*partOffsets[j]]);
+		KMeans(&(data[partOffsets[j]]),dim,n,d,numCodes,iterations,numThreads,&state,codebook,assignment);
+		//with fewer than 256 training samples, the remaining codes repeat the first one and are never used
+		for(long c = numCodes; c < 256; c++) memcpy(&(codebook[c*d]),codebook,d*sizeof(double));
+	}
+	InitTableCodebooks();
+
+	free(assignment);
+	free(data);
+	return 1;
+}
+
+void IVFPQIndex::Encode(double *data, long n, long *cells, unsigned char *codes) {
+	long i,j;
+	const DistanceKernels *kernels = GetDistanceKernels();
+	double *tile = (double *)malloc(n*((numCells > 256) ? numCells : 256)*sizeof(double));
+	double *norms = (double *)malloc(((numCells > 256) ? numCells : 256)*sizeof(double));
+	long *nearest = (long *)malloc(n*sizeof(long));
+
+	for(long c = 0; c < numCells; c++) norms[c] = kernels->dot(&(centroids[c*dim]),&(centroids[c*dim]),dim);
+	NearestCentroids(data,dim,n,dim,centroids,norms,numCells,tile,cells);
+	for(i = 0; i < n; i++) {
+		double *v = &(data[i*dim]);
+		double *centroid = &(centroids[cells[i]*dim]);
+		for(j = 0; j < dim; j++) v[j] -= centroid[j];
+	}
+
+	for(j = 0; j < numParts; j++) {
+		long d = partOffsets[j+1]-partOffsets[j];
+		double *codebook = &(codebooks[256*partOffsets[j]]);
+		for(long c = 0; c < 256; c++) norms[c] = kernels->dot(&(codebook[c*d]),&(codebook[c*d]),d);
+		NearestCentroids(&(data[partOffsets[j]]),dim,n,d,codebook,norms,256,tile,nearest);
+		for(i = 0; i < n; i++) codes[i*numParts+j] = (unsigned char)nearest[i];
+	}
+
+	free(nearest);
+	free(norms);
+	free(tile);
+}
+
+//state of the parallel encoding of the base samples
+struct EncodingLoop {
+	IVFPQIndex *index;
+	SampleSet *samples;
+	long *cells;
+	unsigned char *codes;
+};
+
+void IVFPQIndex::EncodeBody(long i, void *context) {
+	EncodingLoop *loop = (EncodingLoop *)context;
+	IVFPQIndex *index = loop->index;
+	long first = i*IVFPQ_BLOCK_SIZE;
+	long n = (index->numSamples-first < IVFPQ_BLOCK_SIZE) ? (index->numSamples-first) : IVFPQ_BLOCK_SIZE;
+	double *data = (double *)malloc(n*index->dim*sizeof(double));
+	for(long j = 0; j < n; j++) index->GetVector(loop->samples->GetSample(first+j)->GetData(),&(data[j*index->dim]));
+	index->Encode(data,n,&(loop->cells[first]),&(loop->codes[first*index->numParts]));
+	free(data);
+}
+
+int IVFPQIndex::SetBaseSamples(SampleSet *baseSamples) {
+	long i,j;
+	if(!numCells) return 0;
+	for(i = 0; i < baseSamples->Size(); i++) {
+		if(baseSamples->GetSample(i)->Size() < dim) {
+			if(verbose) printf("Error: the base samples are shorter than the dimensionality of the index\n");
+			return 0;
+		}
+	}
+
+	ClearLists();
+	this->baseSamples = baseSamples;
+	numSamples = baseSamples->Size();
+
+	long *cells = (long *)malloc((numSamples ? numSamples : 1)*sizeof(long));
+	unsigned char *sampleCodes = (unsigned char *)malloc((numSamples ? numSamples : 1)*numParts);
+	EncodingLoop loop = {this,baseSamples,cells,sampleCodes};
+	ParallelFor((numSamples+IVFPQ_BLOCK_SIZE-1)/IVFPQ_BLOCK_SIZE,numThreads,EncodeBody,&loop);
+
+	//each list is padded to whole blocks of codes, the samples are in increasing order within a list
+	listStart = (long *)malloc((numCells+1)*sizeof(long));
+	memset(listStart,0,(numCells+1)*sizeof(long));
+	for(i = 0; i < numSamples; i++) listStart[cells[i]+1]++;
+	for(long c = 0; c < numCells; c++) {
+		long size = ((listStart[c+1]+PQ_BLOCK_SIZE-1)/PQ_BLOCK_SIZE)*PQ_BLOCK_SIZE;
+		listStart[c+1] = listStart[c] + size;
+	}
+	long numSlots = listStart[numCells];
+	ids = (int *)malloc((numSlots ? numSlots : 1)*sizeof(int));
+	codes = (unsigned char *)malloc((numSlots ? numSlots : 1)*numParts);
+	memset(ids,0xFF,numSlots*sizeof(int));
+	memset(codes,0,numSlots*numParts);
+	long *next = (long *)malloc(numCells*sizeof(long));
+	memcpy(next,listStart,numCells*sizeof(long));
+	for(i = 0; i < numSamples; i++) {
+		long slot = next[cells[i]]++;
+		ids[slot] = (int)i;
+		unsigned char *block = &(codes[(slot/PQ_BLOCK_SIZE)*PQ_BLOCK_SIZE*numParts]);
+		for(j = 0; j < numParts; j++) block[j*PQ_BLOCK_SIZE+(slot%PQ_BLOCK_SIZE)] = sampleCodes[i*numParts+j];
+	}
+
+	free(next);
+	free(sampleCodes);
+	free(cells);
+	return 1;
+}
+
+long IVFPQIndex::Search(double *vector, void *exclude, long k, long *nearest, double *distances) {
+	long i,j,c;
+	if(!numSamples || (k <= 0)) return 0;
+	const DistanceKernels *kernels = GetDistanceKernels();
+
+	//the cells to search, ordered by increasing distance of their centroids
+	long probes = (numProbes < 1) ? 1 : numProbes;
+	if(probes > numCells) probes = numCells;
+	IndexedDistance *cells = (IndexedDistance *)malloc(probes*sizeof(IndexedDistance));
+	long numFound = 0;
+	for(c = 0; c < numCells; c++) {
+		double d = kernels->squaredEuclidean(&(centroids[c*dim]),vector,dim);
+		if((numFound == probes) && (d >= cells[probes-1].distance)) continue;
+		long pos = (numFound < probes) ? numFound++ : probes-1;
+		for(; (pos > 0) && (cells[pos-1].distance > d); pos--) cells[pos] = cells[pos-1];
+		cells[pos].distance = d;
+		cells[pos].id = c;
+	}
+
+	//one more candidate is kept, in case the query itself is found
+	long numCandidates = (numRerank > k) ? numRerank : k;
+	CandidateHeap heap(numCandidates+1);
+	float *lut = (float *)malloc(256*numParts*sizeof(float));
+	float *blockDistances = (float *)malloc(IVFPQ_SCAN_BLOCKS*PQ_BLOCK_SIZE*sizeof(float));
+	long blockSize = PQ_BLOCK_SIZE*numParts;
+
+	for(long p = 0; p < probes; p++) {
+		long cell = cells[p].id;
+		if(listStart[cell] == listStart[cell+1]) continue;
+
+		//table of the squared distances of the parts of the residual to the part centroids,
+		//computed for all 256 centroids of a part at once (in a local array, which the compiler vectorizes)
+		double *centroid = &(centroids[cell*dim]);
+		for(j = 0; j < numParts; j++) {
+			float table[256];
+			for(c = 0; c < 256; c++) table[c] = 0;
+			for(long t = partOffsets[j]; t < partOffsets[j+1]; t++) {
+				float *values = &(tableCodebooks[256*t]);
+				float r = (float)(vector[t]-centroid[t]);
+				for(c = 0; c < 256; c++) table[c] += (values[c]-r)*(values[c]-r);
+			}
+			memcpy(&(lut[j*256]),table,256*sizeof(float));
+		}
+
+		long firstBlock = listStart[cell]/PQ_BLOCK_SIZE;
+		long numBlocks = (listStart[cell+1]-listStart[cell])/PQ_BLOCK_SIZE;
+		for(long b = 0; b < numBlocks; b += IVFPQ_SCAN_BLOCKS) {
+			long nb = (numBlocks-b < IVFPQ_SCAN_BLOCKS) ? (numBlocks-b) : IVFPQ_SCAN_BLOCKS;
+			kernels->pqDistances(lut,&(codes[(firstBlock+b)*blockSize]),numParts,nb,blockDistances);
+			int *slotIds = &(ids[(firstBlock+b)*PQ_BLOCK_SIZE]);
+			for(i = 0; i < nb*PQ_BLOCK_SIZE; i++) {
+				if((slotIds[i] >= 0) && heap.Accepts(blockDistances[i])) heap.Push(blockDistances[i],slotIds[i]);
+			}
+		}
+	}
+
+	//the query itself is removed from the candidates, otherwise the farthest candidate (the top of the heap)
+	long skip = -1;
+	for(i = 0; i < heap.size; i++) {
+		if(baseSamples->GetSample(heap.id[i])->GetData() == exclude) skip = i;
+	}
+	if((skip < 0) && (heap.size > numCandidates)) skip = 0;
+
+	//the candidates are ordered by their exact distances, or by the distances of their codes
+	IndexedDistance *found = (IndexedDistance *)malloc((heap.size ? heap.size : 1)*sizeof(IndexedDistance));
+	numFound = 0;
+	for(i = 0; i < heap.size; i++) {
+		if(i == skip) continue;
+		IndexedDistance *f = &(found[numFound++]);
+		f->id = heap.id[i];
+		if(numRerank > 0) {
+			double *v = baseSamples->GetSample(heap.id[i])->GetData();
+			if(distanceMeasure == DISTANCE_EUCLIDEAN) {
+				f->distance = sqrt(kernels->squaredEuclidean(v,vector,dim));
+			} else {
+				//the query is normalized
+				double norm = kernels->dot(v,v,dim);
+				f->distance = 1-((norm > 0) ? kernels->dot(v,vector,dim)/sqrt(norm) : 0);
+			}
+		} else {
+			//for normalized vectors, the squared Euclidean distance is twice the cosine distance
+			f->distance = (distanceMeasure == DISTANCE_EUCLIDEAN) ? sqrt(heap.key[i]) : heap.key[i]/2;
+		}
+	}
+	qsort(found,numFound,sizeof(IndexedDistance),IndexedDistanceCompare);
+
+	long count = (numFound < k) ? numFound : k;
+	for(i = 0; i < count; i++) {
+		nearest[i] = found[i].id;
+		if(distances) distances[i] = found[i].distance;
+	}
+
+	free(found);
+	free(blockDistances);
+	free(lut);
+	free(cells);
+	return count;
+}
+
+long IVFPQIndex::Search(double *query, long k, long *nearest, double *distances) {
+	if(!numSamples) return 0;
+	double *vector = (double *)malloc(dim*sizeof(double));
+	GetVector(query,vector);
+	long count = Search(vector,query,k,nearest,distances);
+	free(vector);
+	return count;
+}
+
+long IVFPQIndex::GetMemorySize() {
+	long size = (numParts+1)*sizeof(long) + numCells*dim*sizeof(double) + 256*dim*(sizeof(double)+sizeof(float));
+	if(listStart) size += (numCells+1)*sizeof(long) + listStart[numCells]*(sizeof(int)+numParts);
+	return size;
+}
+
+void IVFPQIndex::Save(FILE *fp) {
+	long measure = distanceMeasure;
+	long numSlots = listStart ? listStart[numCells] : 0;
+	fwrite(&numSamples,1,sizeof(long),fp);
+	fwrite(&dim,1,sizeof(long),fp);
+	fwrite(&measure,1,sizeof(long),fp);
+	fwrite(&numCells,1,sizeof(long),fp);
+	fwrite(&numParts,1,sizeof(long),fp);
+	fwrite(&numSlots,1,sizeof(long),fp);
+	unsigned long long fingerprint = baseSamples ? GetFingerprint(baseSamples) : HASH_INIT;
+	fwrite(&fingerprint,1,sizeof(unsigned long long),fp);
+	if(!numCells) return;
+	fwrite(partOffsets,numParts+1,sizeof(long),fp);
+	fwrite(centroids,numCells*dim,sizeof(double),fp);
+	fwrite(codebooks,256*dim,sizeof(double),fp);
+	if(!listStart) return;
+	fwrite(listStart,numCells+1,sizeof(long),fp);
+	fwrite(ids,numSlots,sizeof(int),fp);
+	fwrite(codes,numSlots,numParts,fp);
+}
+
+int IVFPQIndex::Save(char *filename) {
+	FILE *fp;
+	fp = fopen(filename,"wb");
+	if(!fp) return 0;
+	Save(fp);
+	fclose(fp);
+	return 1;
+}
+
+int IVFPQIndex::Load(FILE *fp, SampleSet *baseSamples) {
+	long i;
+	long header[6];
+	unsigned long long fingerprint;
+	if(fread(header,sizeof(long),6,fp) != 6) return 0;
+	if(fread(&fingerprint,sizeof(unsigned long long),1,fp) != 1) return 0;
+	if((header[1] < 1) || (header[3] < 1) || (header[4] < 1) || (header[4] > header[1]) || (header[5] < 0)) return 0;
+	if((header[2] != DISTANCE_EUCLIDEAN) && (header[2] != DISTANCE_COSINE)) return 0;
+	if((header[0] != baseSamples->Size()) || (header[0] && ((*baseSamples)[0].Size() < header[1]))) {
+		if(verbose) printf("Error: the index was built for different base samples\n");
+		return 0;
+	}
+
+	Clear();
+	dim = header[1];
+	if(header[0] && (GetFingerprint(baseSamples) != fingerprint)) {
+		if(verbose) printf("Error: the index was built for different base samples\n");
+		Clear();
+		return 0;
+	}
+	distanceMeasure = (int)header[2];
+	numCells = header[3];
+	numParts = header[4];
+	long numSlots = header[5];
+	partOffsets = (long *)malloc((numParts+1)*sizeof(long));
+	centroids = (double *)malloc(numCells*dim*sizeof(double));
+	codebooks = (double *)malloc(256*dim*sizeof(double));
+	bool ok = (fread(partOffsets,sizeof(long),numParts+1,fp) == (size_t)(numParts+1));
+	ok = ok && (fread(centroids,sizeof(double),numCells*dim,fp) == (size_t)(numCells*dim));
+	ok = ok && (fread(codebooks,sizeof(double),256*dim,fp) == (size_t)(256*dim));
+	ok = ok && (partOffsets[0] == 0) && (partOffsets[numParts] == dim);
+	for(i = 0; ok && (i < numParts); i++) ok = (partOffsets[i] < partOffsets[i+1]);
+	if(!ok) {
+		Clear();
+		return 0;
+	}
+	InitTableCodebooks();
+	if(!header[0]) return 1;
+
+	this->baseSamples = baseSamples;
+	numSamples = header[0];
+	listStart = (long *)malloc((numCells+1)*sizeof(long));
+	ids = (int *)malloc((numSlots ? numSlots : 1)*sizeof(int));
+	codes = (unsigned char *)malloc((numSlots ? numSlots : 1)*numParts);
+	ok = (fread(listStart,sizeof(long),numCells+1,fp) == (size_t)(numCells+1));
+	ok = ok && (fread(ids,sizeof(int),numSlots,fp) == (size_t)numSlots);
+	ok = ok && (fread(codes,numParts,numSlots,fp) == (size_t)numSlots);
+	ok = ok && (listStart[0] == 0) && (listStart[numCells] == numSlots);
+	for(i = 0; ok && (i < numCells); i++) {
+		ok = (listStart[i] <= listStart[i+1]) && ((listStart[i+1]%PQ_BLOCK_SIZE) == 0);
+	}
+	for(i = 0; ok && (i < numSlots); i++) ok = (ids[i] < numSamples);
+	if(!ok) {
+		Clear();
+		return 0;
+	}
+	return 1;
+}
+
+int IVFPQIndex::Load(char *filename, SampleSet *baseSamples) {
+	FILE *fp;
+	fp = fopen(filename,"rb");
+	if(!fp) return 0;
+	int ret = Load(fp,baseSamples);
+	fclose(fp);
+	return ret;
+}
+
+} //namespace
@@ -0,0 +1,157 @@
+//Copyright (C) 2011 by Ivan Fratric
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in
+//all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//THE SOFTWARE.
+
+namespace LibSubspace {
+
+//approximate nearest neighbor index of a set of base samples, which stores the samples compressed by product quantization, see
+//H. Jegou, M. Douze, C. Schmid, "Product Quantization for Nearest Neighbor Search", IEEE TPAMI, Vol. 33, No. 1, 2011, pp. 117-128.
+//the feature space is divided into cells by k-means clustering, each cell has an inverted list of the base samples in it
+//the residual of a sample (its difference from the centroid of its cell) is divided into parts, and each part is
+//replaced by the index of the closest of the 256 centroids learned for it, so a sample is stored in one byte per part
+//a search scans the lists of the cells closest to the query and computes the distances to their samples from tables of
+//the distances of the query parts to the part centroids, then it recomputes the exact distances of the closest candidates
+//the original feature vectors are needed only for the exact distances, if the base samples are loaded from a binary
+//sample set (see SampleSet::LoadBinary) they are mapped into memory, so only the vectors of the candidates are read
+//supports the Euclidean and the cosine distance of double precision samples
+//the index refers to the base samples, which must not be changed or deleted while the index is used
+//searches do not change the index and can be performed by several threads at once
+class IVFPQIndex {
+protected:
+	SampleSet *baseSamples;
+	int distanceMeasure;
+	long dim;
+	long numCells;	//number of coarse centroids, 0 if the index is not trained
+	long numParts;	//number of parts of a vector, the number of bytes of a code
+	long *partOffsets;	//first feature of each part, numParts+1 elements
+	double *centroids;	//coarse centroids, (numCells x dim)
+	double *codebooks;	//the 256 centroids of each part, part j starts at 256*partOffsets[j] and has a row for each centroid
+	float *tableCodebooks;	//the part centroids in single precision, for each feature the values of the 256 centroids are consecutive
+	long numSamples;
+	long *listStart;	//first slot of the inverted list of each cell, numCells+1 elements, a multiple of PQ_BLOCK_SIZE
+	int *ids;	//index of the base sample in each slot, -1 for the unused slots at the end of a list
+	unsigned char *codes;	//codes of the slots, in blocks of PQ_BLOCK_SIZE codes (see DistanceKernels::pqDistances)
+
+	//frees the index
+	void Clear();
+
+	//frees the inverted lists
+	void ClearLists();
+
+	//sets tableCodebooks from codebooks
+	void InitTableCodebooks();
+
+	//returns a hash of the first dim features of the samples (see HashBytes), stored in the index file
+	//so that an index is not loaded for other samples of the same number
+	unsigned long long GetFingerprint(SampleSet *samples);
+
+	//copies the first dim features of a vector, normalized for the cosine distance
+	void GetVector(double *data, double *vector);
+
+	//encodes n vectors (rows of data), cells receives the cell of each vector and codes its code (numParts bytes)
+	//the vectors are changed into their residuals
+	void Encode(double *data, long n, long *cells, unsigned char *codes);
+
+	//encodes the base samples of one of the blocks of SetBaseSamples
+	static void EncodeBody(long i, void *context);
+
+	//searches the index, see Search, exclude is the feature vector of the sample that is skipped
+	long Search(double *vector, void *exclude, long k, long *nearest, double *distances);
+
+public:
+	//training parameters, used by Train
+	//number of cells, larger values make searches faster, but fewer samples are found in the searched cells, 256 by default
+	long numLists;
+	//number of parts of a vector (bytes of a code), at most the dimensionality
+	//larger values make the distances more precise and the index larger, 16 by default
+	long numSubquantizers;
+	//number of k-means iterations, 20 by default
+	long iterations;
+	//the centroids are learned from a random subset of at most this many training samples, 65536 by default
+	long maxTrainingSamples;
+	//seed of the random number generator that selects the training samples and the initial centroids
+	unsigned long seed;
+
+	//search parameters
+	//number of cells whose lists are searched, 8 by default
+	long numProbes;
+	//number of the closest candidates whose exact distance is computed from the base samples, 100 by default
+	//if 0, the distances of the compressed samples are returned
+	long numRerank;
+
+	//number of threads used to train the index and to encode the base samples, 0 (default) uses one thread per processor
+	int numThreads;
+
+	//if true, prints progress information while training
+	bool verbose;
+
+	//constructor/destructor
+	IVFPQIndex();
+	~IVFPQIndex();
+
+	//learns the cells and the part centroids from a set of samples, for example the base samples
+	//removes any base samples from the index
+	//distanceMeasure is DISTANCE_EUCLIDEAN or DISTANCE_COSINE
+	//dim : sample dimensionality, if 0 the dimensionality of the first sample will be used
+	//returns 0 if the distance measure is not supported or there are no samples
+	int Train(SampleSet *samples, int distanceMeasure, long dim = 0);
+
+	//compresses the base samples into the index, replacing the previous ones
+	//returns 0 if the index is not trained or the samples are shorter than its dimensionality
+	int SetBaseSamples(SampleSet *baseSamples);
+
+	//finds approximately the k base samples closest to a feature vector
+	//nearest receives the indices of the samples, ordered by increasing distance, and distances (if not NULL) their distances
+	//a base sample whose feature vector is the query itself is never returned, as in OneNNClassifier,
+	//which enables leave-one-out tests
+	//returns the number of samples found, at most k
+	long Search(double *query, long k, long *nearest, double *distances = NULL);
+
+	//property getters
+	SampleSet *GetBaseSamples() {
+		return baseSamples;
+	}
+
+	int GetDistanceMeasure() {
+		return distanceMeasure;
+	}
+
+	long GetDim() {
+		return dim;
+	}
+
+	//returns the number of bytes of memory used by the index, not counting the base samples
+	long GetMemorySize();
+
+	//saves the index to a file given as filename, returns 0 on error
+	//the original feature vectors are not stored, the index is loaded for the same base samples
+	int Save(char *filename);
+
+	//saves the index to a file given as file pointer
+	void Save(FILE *fp);
+
+	//loads an index of the base samples from a file given as filename
+	//returns 0 on error, or if the index was not built for base samples with the same feature vectors
+	int Load(char *filename, SampleSet *baseSamples);
+
+	//loads an index from a file given as file pointer
+	int Load(FILE *fp, SampleSet *baseSamples);
+};
+
+} //namespace
@@ -0,0 +1,120 @@
+//Copyright (C) 2011 by Ivan Fratric
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in
+//all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//THE SOFTWARE.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "mappedfile.h"
+
+namespace LibSubspace {
+
+MappedFile::MappedFile() {
+	data = NULL;
+	size = 0;
+#ifdef _WIN32
+	file = NULL;
+	mapping = NULL;
+#endif
+}
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+#ifdef _WIN32
+
+int MappedFile::Open(char *filename) {
+	Close();
+	HANDLE f = CreateFileA(filename,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+	if(f == INVALID_HANDLE_VALUE) return 0;
+	LARGE_INTEGER filesize;
+	if((!GetFileSizeEx(f,&filesize)) || (filesize.QuadPart == 0)) {
+		CloseHandle(f);
+		return 0;
+	}
+	//copy-on-write mapping, see the class description
+	HANDLE m = CreateFileMappingA(f,NULL,PAGE_WRITECOPY,0,0,NULL);
+	if(!m) {
+		CloseHandle(f);
+		return 0;
+	}
+	void *p = MapViewOfFile(m,FILE_MAP_COPY,0,0,0);
+	if(!p) {
+		CloseHandle(m);
+		CloseHandle(f);
+		return 0;
+	}
+	file = f;
+	mapping = m;
+	data = p;
+	size = (long)filesize.QuadPart;
+	return 1;
+}
+
+void MappedFile::Close() {
+	if(data) UnmapViewOfFile(data);
+	if(mapping) CloseHandle((HANDLE)mapping);
+	if(file) CloseHandle((HANDLE)file);
+	data = NULL;
+	size = 0;
+	file = NULL;
+	mapping = NULL;
+}
+
+#else
+
+int MappedFile::Open(char *filename) {
+	Close();
+	int fd = open(filename,O_RDONLY);
+	if(fd < 0) return 0;
+	struct stat st;
+	if((fstat(fd,&st) != 0) || (st.st_size == 0)) {
+		close(fd);
+		return 0;
+	}
+	//copy-on-write mapping, see the class description
+	void *p = mmap(NULL,st.st_size,PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,0);
+	//the mapping remains valid after the file is closed
+	close(fd);
+	if(p == MAP_FAILED) return 0;
+	data = p;
+	size = (long)st.st_size;
+	return 1;
+}
+
+void MappedFile::Close() {
+	if(data) munmap(data,size);
+	data = NULL;
+	size = 0;
+}
+
+#endif
+
+} //namespace
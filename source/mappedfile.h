@@ -0,0 +1,56 @@
+//Copyright (C) 2011 by Ivan Fratric
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in
+//all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//THE SOFTWARE.
+
+namespace LibSubspace {
+
+//implements a file mapped into memory
+//the mapping is private, the mapped memory can be modified but the changes are not written to the file
+class MappedFile {
+protected:
+	void *data;	//the mapped file contents, NULL if no file is mapped
+	long size;	//size of the mapped file in bytes
+#ifdef _WIN32
+	void *file;	//handle of the file
+	void *mapping;	//handle of the file mapping
+#endif
+
+public:
+	//constructor/destructor
+	MappedFile();
+	~MappedFile();
+
+	//maps the file given as filename into memory
+	//returns 1 on success, 0 on failure
+	int Open(char *filename);
+
+	//unmaps the file
+	void Close();
+
+	//property getters
+	void *GetData() {
+		return data;
+	}
+
+	long Size() {
+		return size;
+	}
+};
+
+} //namespace
@@ -25,6 +25,7 @@
 #include <math.h>
 
 #include "matrix.h"
+#include "gemm.h"
 
 namespace LibSubspace {
 
@@ -88,41 +89,24 @@ Matrix Matrix::operator*(Matrix& src) {
 		Matrix ret;
 		return ret;
 	}
-	long i,j,k;
-	double sum;
-
 	Matrix ret(nrows, src.ncols);
-
-	if(ncols >= 100) { 	//use more efficient caching for large matrices
-		Matrix srct = src.Transpose();
-		double *row1,*row2;
-
-		for(i=0;i<nrows;i++) {
-			row1 = &(data[i*ncols]);
-			for(j=0;j<src.ncols;j++) {
-				row2 = &(srct.data[j*srct.ncols]);
-				sum=0;
-				for(k=0;k<ncols;k++) {
-					sum+=row1[k]*row2[k];
-				}
-				ret.data[i*src.ncols+j]=sum;
-			}
-		}
-	} else { //standard matrix multiplication
-		for(i=0;i<nrows;i++) {
-			for(j=0;j<src.ncols;j++) {
-				sum=0;
-				for(k=0;k<ncols;k++) {
-					sum+=data[i*ncols+k]*src.data[k*src.ncols+j];
-				}
-				ret.data[i*src.ncols+j]=sum;
-			}
-		}
-	}
+	gemm(GEMM_NOTRANS,GEMM_NOTRANS,nrows,src.ncols,ncols,1.0,data,ncols,src.data,src.ncols,0.0,ret.data,src.ncols);
 
 	return ret;
 }
 
+Matrix Matrix::SymmetricProduct(bool transposeFirst) {
+	if(transposeFirst) {
+		Matrix ret(ncols, ncols);
+		syrk(GEMM_TRANS,ncols,nrows,1.0,data,ncols,0.0,ret.data,ncols);
+		return ret;
+	} else {
+		Matrix ret(nrows, nrows);
+		syrk(GEMM_NOTRANS,nrows,ncols,1.0,data,ncols,0.0,ret.data,nrows);
+		return ret;
+	}
+}
+
 Matrix Matrix::operator+(Matrix& src) {
 	if((nrows != src.nrows)||(ncols != src.ncols)) {
 		printf("Matrix addition error: matrix dimensions don't match.\n");
@@ -174,4 +158,23 @@ void Matrix::Load(char *filename) {
 	fclose(fp);
 }
 
+double RandomUniform(unsigned long long *state) {
+	unsigned long long x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	//53 random bits, shifted to (0,1)
+	return ((double)((x * 2685821657736338717ULL) >> 11) + 0.5) / 9007199254740992.0;
+}
+
+unsigned long long HashBytes(void *data, long n, unsigned long long hash) {
+	unsigned char *bytes = (unsigned char *)data;
+	for(long i=0;i<n;i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
 } //namespace
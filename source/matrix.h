@@ -67,11 +67,30 @@ public:
 	//returns the transposed matrix
 	Matrix Transpose();
 
+	//returns the symmetric product of the matrix and its transpose
+	//(this)*(this)' if transposeFirst is false, (this)'*(this) otherwise
+	//only one triangle of the result is computed, the other one is mirrored
+	//if each row of the matrix is a (centered) sample, the former gives the Gram matrix of the samples
+	//and the latter gives their scatter (unnormalized covariance) matrix
+	Matrix SymmetricProduct(bool transposeFirst = false);
+
 	//saves the matrix to file with the name 'filename'
 	void Save(char *filename);
 	//loads the matrix from file with the name 'filename'
 	void Load(char *filename);
 };
 
+//reproducible pseudo-random number generator (xorshift64*)
+//used instead of rand() so that the results do not depend on the C library
+//returns a uniformly distributed number in (0,1) and advances the generator state, which must not be 0
+double RandomUniform(unsigned long long *state);
+
+//initial value of HashBytes, the 64-bit FNV-1a offset basis
+#define HASH_INIT 14695981039346656037ULL
+
+//64-bit FNV-1a hash of n bytes, continuing from the hash of the preceding data (HASH_INIT if there is none)
+//used to recognize the samples an index file was built for
+unsigned long long HashBytes(void *data, long n, unsigned long long hash);
+
 } //namespace
 
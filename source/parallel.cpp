@@ -0,0 +1,71 @@
+//Copyright (C) 2011 by Ivan Fratric
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in
+//all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//THE SOFTWARE.
+
+#include <thread>
+#include <atomic>
+
+#include "parallel.h"
+
+namespace LibSubspace {
+
+int GetNumberOfProcessors() {
+	int n = (int)std::thread::hardware_concurrency();
+	return (n > 0) ? n : 1;
+}
+
+//state shared by the threads of a ParallelFor loop
+struct ParallelForLoop {
+	long n;
+	std::atomic<long> next;	//next iteration to be handed out
+	void (*body)(long i, void *context);
+	void *context;
+};
+
+static void ParallelForThread(ParallelForLoop *loop) {
+	long i;
+	while((i = loop->next++) < loop->n) {
+		loop->body(i,loop->context);
+	}
+}
+
+void ParallelFor(long n, int numThreads, void (*body)(long i, void *context), void *context) {
+	long i;
+	if(numThreads <= 0) numThreads = GetNumberOfProcessors();
+	if(numThreads > n) numThreads = (int)n;
+	if(numThreads <= 1) {
+		for(i=0;i<n;i++) body(i,context);
+		return;
+	}
+
+	ParallelForLoop loop;
+	loop.n = n;
+	loop.next = 0;
+	loop.body = body;
+	loop.context = context;
+
+	//the calling thread is one of the workers
+	std::thread *threads = new std::thread[numThreads-1];
+	for(i=0;i<numThreads-1;i++) threads[i] = std::thread(ParallelForThread,&loop);
+	ParallelForThread(&loop);
+	for(i=0;i<numThreads-1;i++) threads[i].join();
+	delete [] threads;
+}
+
+} //namespace
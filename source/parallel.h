@@ -0,0 +1,34 @@
+//Copyright (C) 2011 by Ivan Fratric
+//
+//Permission is hereby granted, free of charge, to any person obtaining a copy
+//of this software and associated documentation files (the "Software"), to deal
+//in the Software without restriction, including without limitation the rights
+//to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+//copies of the Software, and to permit persons to whom the Software is
+//furnished to do so, subject to the following conditions:
+//
+//The above copyright notice and this permission notice shall be included in
+//all copies or substantial portions of the Software.
+//
+//THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+//IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+//FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+//AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+//LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+//OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+//THE SOFTWARE.
+
+namespace LibSubspace {
+
+//returns the number of processors available to the program
+int GetNumberOfProcessors();
+
+//calls body(i, context) for every i from 0 to n-1, using numThreads threads
+//the iterations are handed out to the threads one by one in increasing order of i,
+//so that iterations of very different duration are balanced between the threads
+//body must be safe to call concurrently for different values of i
+//if numThreads is 0, the number of processors is used
+//with a single thread (or n < 2) the loop runs in the calling thread
+void ParallelFor(long n, int numThreads, void (*body)(long i, void *context), void *context);
+
+} //namespace
@@ -22,76 +22,381 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <ctype.h>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
 
 #include "sample.h"
 #include "matrix.h"
+#include "gemm.h"
 #include "image.h"
 #include "imageio.h"
+#include "mappedfile.h"
+#include "parallel.h"
+#include "convert.h"
 
 namespace LibSubspace {
 
 long typesize[] = {sizeof(char), sizeof(unsigned char), sizeof(long), sizeof(unsigned long), sizeof(float),sizeof(double)};
 
+//alignment of the sample set feature blocks, in bytes
+#define SAMPLE_DATA_ALIGNMENT 64
+
+static void *AlignedAlloc(long bytes) {
+#ifdef _WIN32
+	return _aligned_malloc(bytes,SAMPLE_DATA_ALIGNMENT);
+#else
+	void *p = NULL;
+	if(posix_memalign(&p,SAMPLE_DATA_ALIGNMENT,bytes)) return NULL;
+	return p;
+#endif
+}
+
+static void AlignedFree(void *p) {
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+//returned for samples without a name
+static char emptyname[] = "";
+
+static const char binaryMagic[8] = {'L','S','S','E','T',0,0,0};
+
+#define BINARY_SAMPLESET_VERSION 1
+
+//position of the features in a binary sample set file, a multiple of the feature block alignment
+#define BINARY_SAMPLESET_DATA_OFFSET 128
+
+//returns the size of a feature of the given type in a binary sample set file, 0 if the type is not supported
+static long BinaryTypeSize(int type) {
+	switch(type) {
+		case TYPE_CHAR: return 1;
+		case TYPE_UCHAR: return 1;
+		case TYPE_INT: return 4;
+		case TYPE_UINT: return 4;
+		case TYPE_FLOAT: return 4;
+		case TYPE_DOUBLE: return 8;
+	}
+	return 0;
+}
+
+//converts n features of the given binary file type to double
+static void ConvertFromBinaryType(void *src, int type, double *dst, long n) {
+	switch(type) {
+		case TYPE_CHAR:
+			ConvertToDouble((signed char *)src,dst,n);
+			break;
+		case TYPE_UCHAR:
+			ConvertToDouble((unsigned char *)src,dst,n);
+			break;
+		case TYPE_INT:
+			ConvertToDouble((int *)src,dst,n);
+			break;
+		case TYPE_UINT:
+			for(long i=0;i<n;i++) dst[i] = ((unsigned int *)src)[i];
+			break;
+		case TYPE_FLOAT:
+			ConvertToDouble((float *)src,dst,n);
+			break;
+		case TYPE_DOUBLE:
+			memcpy(dst,src,n*sizeof(double));
+			break;
+	}
+}
+
+//converts n features of the given binary file type to float
+static void ConvertFromBinaryType(void *src, int type, float *dst, long n) {
+	switch(type) {
+		case TYPE_CHAR:
+			ConvertToFloat((signed char *)src,dst,n);
+			break;
+		case TYPE_UCHAR:
+			ConvertToFloat((unsigned char *)src,dst,n);
+			break;
+		case TYPE_INT:
+			ConvertToFloat((int *)src,dst,n);
+			break;
+		case TYPE_UINT:
+			for(long i=0;i<n;i++) dst[i] = (float)((unsigned int *)src)[i];
+			break;
+		case TYPE_FLOAT:
+			memcpy(dst,src,n*sizeof(float));
+			break;
+		case TYPE_DOUBLE:
+			ConvertToFloat((double *)src,dst,n);
+			break;
+	}
+}
+
+//converts n features to the given binary file type
+static void ConvertToBinaryType(double *src, int type, void *dst, long n) {
+	long i;
+	switch(type) {
+		case TYPE_CHAR:
+			for(i=0;i<n;i++) ((signed char *)dst)[i] = (signed char)src[i];
+			break;
+		case TYPE_UCHAR:
+			for(i=0;i<n;i++) ((unsigned char *)dst)[i] = (unsigned char)src[i];
+			break;
+		case TYPE_INT:
+			for(i=0;i<n;i++) ((int *)dst)[i] = (int)src[i];
+			break;
+		case TYPE_UINT:
+			for(i=0;i<n;i++) ((unsigned int *)dst)[i] = (unsigned int)src[i];
+			break;
+		case TYPE_FLOAT:
+			ConvertToFloat(src,(float *)dst,n);
+			break;
+		case TYPE_DOUBLE:
+			memcpy(dst,src,n*sizeof(double));
+			break;
+	}
+}
+
+bool IsBinarySampleSet(char *filename) {
+	char magic[8];
+	FILE *fp = fopen(filename,"rb");
+	if(!fp) return false;
+	bool binary = (fread(magic,1,8,fp) == 8) && (memcmp(magic,binaryMagic,8) == 0);
+	fclose(fp);
+	return binary;
+}
+
+//returns true if the header describes a binary sample set file of the given size
+//the sizes of the parts of the file are compared with the space available for them by division,
+//so that corrupt counts cannot overflow the products
+static bool CheckBinaryHeader(BinarySampleSetHeader *header, long long size) {
+	long long typesize = BinaryTypeSize((int)header->type);
+	if((typesize == 0) ||
+		(memcmp(header->magic,binaryMagic,8) != 0) ||
+		(header->version != BINARY_SAMPLESET_VERSION) ||
+		(header->numsamples < 0) || (header->dim < 0) || (header->numclasses < 0) || (header->namesize < 0) ||
+		(header->dim > size))
+	{
+		return false;
+	}
+	//features
+	if((header->classidoffset < BINARY_SAMPLESET_DATA_OFFSET) || (header->classidoffset > size) ||
+		(header->classidoffset % sizeof(long long) != 0) ||
+		(header->dim && (header->numsamples > (header->classidoffset - BINARY_SAMPLESET_DATA_OFFSET) / (header->dim*typesize))))
+	{
+		return false;
+	}
+	//class ids
+	if((header->classoffset < header->classidoffset) || (header->classoffset > size) ||
+		(header->numsamples > (header->classoffset - header->classidoffset) / (long long)sizeof(long long)))
+	{
+		return false;
+	}
+	//class table and file names
+	if((header->nameoffset < header->classoffset) || (header->nameoffset > size) ||
+		(header->numclasses > (header->nameoffset - header->classoffset) / SAMPLE_CLASS_SIZE) ||
+		(header->namesize > size - header->nameoffset))
+	{
+		return false;
+	}
+	return true;
+}
+
+BinarySampleSetHeader *OpenBinarySampleSet(char *filename, MappedFile *file) {
+	if(!file->Open(filename)) return NULL;
+	BinarySampleSetHeader *header = (BinarySampleSetHeader *)file->GetData();
+	if((file->Size() < BINARY_SAMPLESET_DATA_OFFSET) || !CheckBinaryHeader(header,file->Size())) {
+		file->Close();
+		return NULL;
+	}
+	return header;
+}
+
+//sets the file names and classes of the samples in 'names' from a mapped binary sample set file
+//returns 1 on success, 0 if the file is corrupt
+static int ReadBinaryNames(MappedFile *file, BinarySampleSetHeader *header, SampleSet *names) {
+	long i;
+	char *base = (char *)file->GetData();
+	long long *classids = (long long *)(base + header->classidoffset);
+	char (*classnames)[SAMPLE_CLASS_SIZE] = (char (*)[SAMPLE_CLASS_SIZE])(base + header->classoffset);
+	char *name = base + header->nameoffset;
+	char *end = name + header->namesize;
+	for(i=0;i<header->numclasses;i++) {
+		if(!memchr(classnames[i],0,SAMPLE_CLASS_SIZE)) return 0;
+	}
+	for(i=0;i<header->numsamples;i++) {
+		if((classids[i] < 0) || (classids[i] >= header->numclasses)) return 0;
+		char *nameend = (char *)memchr(name,0,end-name);
+		if(!nameend) return 0;
+		(*names)[i].SetClassname(classnames[classids[i]]);
+		(*names)[i].SetFilename(name);
+		name = nameend+1;
+	}
+	return 1;
+}
+
+//writes the feature vector of a sample as dim features of the given type, missing features are written as 0
+//buffer must hold dim doubles
+static void WriteBinaryFeatures(FILE *fp, Sample *sample, long dim, int type, void *buffer) {
+	long n = (sample->Size() < dim) ? sample->Size() : dim;
+	long typesize = BinaryTypeSize(type);
+	ConvertToBinaryType(sample->GetData(),type,buffer,n);
+	memset((char *)buffer + n*typesize,0,(dim-n)*typesize);
+	fwrite(buffer,typesize,dim,fp);
+}
+
+//writes the class ids, the class table and the file names of 'names' after the features and then the header
+//the numsamples, dim and type fields of the header have to be set
+//returns 1 on success, 0 on failure
+static int WriteBinaryNames(FILE *fp, SampleSet *names, BinarySampleSetHeader *header) {
+	long i;
+	long long classid;
+	char classname[SAMPLE_CLASS_SIZE];
+	memcpy(header->magic,binaryMagic,8);
+	header->version = BINARY_SAMPLESET_VERSION;
+	header->classidoffset = BINARY_SAMPLESET_DATA_OFFSET + header->numsamples*header->dim*BinaryTypeSize((int)header->type);
+	header->classidoffset = (header->classidoffset + sizeof(long long) - 1) / sizeof(long long) * sizeof(long long);
+	fseek(fp,(long)header->classidoffset,SEEK_SET);
+	for(i=0;i<header->numsamples;i++) {
+		classid = names->GetClassId(i);
+		fwrite(&classid,sizeof(long long),1,fp);
+	}
+	header->numclasses = names->GetNumberOfClassIds();
+	header->classoffset = header->classidoffset + header->numsamples*sizeof(long long);
+	for(i=0;i<header->numclasses;i++) {
+		memset(classname,0,SAMPLE_CLASS_SIZE);
+		strncpy(classname,names->GetClassnameById(i),SAMPLE_CLASS_SIZE-1);
+		fwrite(classname,1,SAMPLE_CLASS_SIZE,fp);
+	}
+	header->nameoffset = header->classoffset + header->numclasses*SAMPLE_CLASS_SIZE;
+	header->namesize = 0;
+	for(i=0;i<header->numsamples;i++) {
+		char *filename = (*names)[i].GetFilename();
+		long len = strlen(filename)+1;
+		fwrite(filename,1,len,fp);
+		header->namesize += len;
+	}
+	fseek(fp,0,SEEK_SET);
+	fwrite(header,sizeof(BinarySampleSetHeader),1,fp);
+	return !ferror(fp);
+}
+
+//copies at most maxlength-1 characters of src into a (re)allocated string dst
+static char *CopyName(char *dst, char *src, long maxlength) {
+	if(src == dst) return dst;
+	long len = strlen(src);
+	if(len > maxlength-1) len = maxlength-1;
+	dst = (char *)realloc(dst,len+1);
+	memcpy(dst,src,len);
+	dst[len] = 0;
+	return dst;
+}
+
 Sample::Sample() {
+	size = 0;
 	data = NULL;
-	filename[0] = 0;
-	classname[0] = 0;
+	owndata = false;
+	owner = NULL;
+	index = 0;
+	filename = NULL;
+	classname = NULL;
 }
 
 Sample::Sample(int size) {
-	this->size = size;
-	filename[0] = 0;
-	classname[0] = 0;
-	data = (double *)malloc(size*sizeof(double));
+	this->size = 0;
+	data = NULL;
+	owndata = false;
+	owner = NULL;
+	index = 0;
+	filename = NULL;
+	classname = NULL;
+	Allocate(size);
 	memset(data,0,size*sizeof(double));
 }
 
-void Sample::Init(int size) {
-	if(data) free(data);
+void Sample::Release() {
+	if(owndata && data) free(data);
+	data = NULL;
+	owndata = false;
+}
+
+void Sample::Allocate(long size) {
+	Release();
 	this->size = size;
-	filename[0] = 0;
-	classname[0] = 0;
+	if(owner) {
+		if((owner->dim == 0) && (size > 0)) owner->AllocateData(size);
+		if(owner->dim == size) {
+			data = &(owner->data[index*size]);
+			return;
+		}
+	}
 	data = (double *)malloc(size*sizeof(double));
+	owndata = true;
+}
+
+void Sample::Init(int size) {
+	Allocate(size);
 	memset(data,0,size*sizeof(double));
+	SetFilename(emptyname);
+	SetClassname(emptyname);
 }
 
 void Sample::SetData(int size, double *data) {
-	this->size = size;
-	if(this->data) free(this->data);
-	this->data = (double *)malloc(size*sizeof(double));
+	if(data == this->data) return;
+	Allocate(size);
 	memcpy(this->data,data,size*sizeof(double));
 }
 
 Sample::Sample(const Sample& src) {
-	this->size = src.size;
-	this->data = (double *)malloc(src.size*sizeof(double));
-	memcpy(this->data,src.data,size*sizeof(double));
-	strncpy(this->filename,src.filename,SAMPLE_FILE_SIZE);
-	strncpy(this->classname,src.classname,SAMPLE_CLASS_SIZE);
+	Sample &source = (Sample &)src;
+	size = 0;
+	data = NULL;
+	owndata = false;
+	owner = NULL;
+	index = 0;
+	filename = NULL;
+	classname = NULL;
+	Allocate(source.size);
+	if(source.data) memcpy(data,source.data,size*sizeof(double));
+	SetFilename(source.GetFilename());
+	SetClassname(source.GetClassname());
 }
 
 Sample& Sample::operator=(const Sample &src) {
-	if(this->data) free(this->data);
-	this->size = src.size;
-	this->data = (double *)malloc(src.size*sizeof(double));
-	memcpy(this->data,src.data,size*sizeof(double));
-	strncpy(this->filename,src.filename,SAMPLE_FILE_SIZE);
-	strncpy(this->classname,src.classname,SAMPLE_CLASS_SIZE);
+	Sample &source = (Sample &)src;
+	if(this == &source) return *this;
+	Allocate(source.size);
+	if(source.data) memcpy(data,source.data,size*sizeof(double));
+	SetFilename(source.GetFilename());
+	SetClassname(source.GetClassname());
 	return *this;
 }
 
 Sample::~Sample() {
-	if(data) free(data);
+	Release();
+	if(filename) free(filename);
+	if(classname) free(classname);
+}
+
+char *Sample::GetFilename() {
+	if(owner) return &(owner->strings[owner->fileoffsets[index]]);
+	return filename ? filename : emptyname;
+}
+
+char *Sample::GetClassname() {
+	if(owner) return owner->classes.GetName(owner->classids[index]);
+	return classname ? classname : emptyname;
 }
 
 void Sample::SetFilename(char *filename) {
-	strncpy(this->filename,filename,SAMPLE_FILE_SIZE);
-	this->filename[SAMPLE_FILE_SIZE-1] = 0; //just in case
+	if(owner) owner->SetFilename(index,filename);
+	else this->filename = CopyName(this->filename,filename,SAMPLE_FILE_SIZE);
 }
 
 void Sample::SetClassname(char *classname) {
-	strncpy(this->classname,classname,SAMPLE_CLASS_SIZE);
-	this->classname[SAMPLE_CLASS_SIZE-1] = 0; //just in case
+	if(owner) owner->SetClassname(index,classname);
+	else this->classname = CopyName(this->classname,classname,SAMPLE_CLASS_SIZE);
 }
 
 int Sample::ReadImageData(char *filename) {
@@ -99,20 +404,15 @@ int Sample::ReadImageData(char *filename) {
 	ImageIO io;
 	int x,y,w,h;
 
+	io.verbose = false;
 	io.LoadImage(filename,&img);
 
 	w = img.GetWidth();
 	h = img.GetHeight();
 
-	if((w==0)||(h==0)) {
-		printf("Error reading image %s\n",filename);
-		return 0;
-	}
+	if((w==0)||(h==0)) return 0;
 
-	size = w*h;
-
-	if(data) free(data);
-	data = (double *)malloc(size*sizeof(double));
+	Allocate(w*h);
 
 	for(y=0;y<h;y++) {
 		for(x=0;x<w;x++) {
@@ -124,9 +424,12 @@ int Sample::ReadImageData(char *filename) {
 }
 
 int Sample::Load(char *filename, char *classname, int type, long size = 0) {
-	strcpy(this->filename,filename);
-	strcpy(this->classname,classname);
+	SetFilename(filename);
+	SetClassname(classname);
+	return LoadData(filename,type,size);
+}
 
+int Sample::LoadData(char *filename, int type, long size) {
 	if(type == TYPE_IMAGE) return ReadImageData(filename);
 
 	FILE *fp;
@@ -137,72 +440,38 @@ int Sample::Load(char *filename, char *classname, int type, long size = 0) {
 		size = ftell(fp)/typesize[type];
 		fseek(fp,0,SEEK_SET);
 	}
-	this->size = size;
-	if(data) free(data);
-	data = (double *)malloc(size*sizeof(double));
+	Allocate(size);
+	//the file is read into the end of the feature vector and widened to double in place
+	char *raw = (char *)data + size*(sizeof(double)-typesize[type]);
+	long read = fread(raw,typesize[type],size,fp);
+	fclose(fp);
+	long i;
 	switch(type) {
 		case TYPE_CHAR:
-			{
-				char *tmp = (char *)malloc(size*sizeof(char));
-				fread(tmp,size,sizeof(char),fp);
-				for(long i=0;i<size;i++) {
-					data[i] = (double)tmp[i];
-				}
-				free(tmp);
-			}
+			ConvertToDouble((signed char *)raw,data,size);
 			break;
 		case TYPE_UCHAR:
-			{
-				unsigned char *tmp = (unsigned char *)malloc(size*sizeof(unsigned char));
-				fread(tmp,size,sizeof(unsigned char),fp);
-				for(long i=0;i<size;i++) {
-					data[i] = (double)tmp[i];
-				}
-				free(tmp);
-			}
+			ConvertToDouble((unsigned char *)raw,data,size);
 			break;
 		case TYPE_INT:
-			{
-				long *tmp = (long *)malloc(size*sizeof(long));
-				fread(tmp,size,sizeof(long),fp);
-				for(long i=0;i<size;i++) {
-					data[i] = (double)tmp[i];
-				}
-				free(tmp);
-			}
+			//the values are of type long, which is of the same size as int on some platforms
+			if(sizeof(long) == sizeof(int)) ConvertToDouble((int *)raw,data,size);
+			else for(i=0;i<size;i++) data[i] = (double)((long *)raw)[i];
 			break;
 		case TYPE_UINT:
-			{
-				unsigned long *tmp = (unsigned long *)malloc(size*sizeof(unsigned long));
-				fread(tmp,size,sizeof(unsigned long),fp);
-				for(long i=0;i<size;i++) {
-					data[i] = (double)tmp[i];
-				}
-				free(tmp);
-			}
+			for(i=0;i<size;i++) data[i] = (double)((unsigned long *)raw)[i];
 			break;
 		case TYPE_FLOAT:
-			{
-				float *tmp = (float *)malloc(size*sizeof(float));
-				fread(tmp,size,sizeof(float),fp);
-				for(long i=0;i<size;i++) {
-					data[i] = (double)tmp[i];
-				}
-				free(tmp);
-			}
+			ConvertToDouble((float *)raw,data,size);
 			break;
 		case TYPE_DOUBLE:
-			{
-				double *tmp = (double *)malloc(size*sizeof(double));
-				fread(tmp,size,sizeof(double),fp);
-				for(long i=0;i<size;i++) {
-					data[i] = (double)tmp[i];
-				}
-				free(tmp);
-			}
 			break;
 	}
-	fclose(fp);
+	//the file is shorter than the expected feature vector
+	if(read < size) {
+		for(i=read;i<size;i++) data[i] = 0;
+		return 0;
+	}
 	return 1;
 }
 
@@ -213,11 +482,12 @@ void Sample::Save(char *folder) {
 		strcat(filename,"\\");
 	}
 	char *filename2,*filename22;
-	filename2 = strrchr(this->filename,'\\');
-	filename22 = strrchr(this->filename,'/');
+	char *ownfilename = GetFilename();
+	filename2 = strrchr(ownfilename,'\\');
+	filename22 = strrchr(ownfilename,'/');
 	if(filename22 > filename2) filename2 = filename22;
 	if(!filename2) {
-		filename2 = this->filename;
+		filename2 = ownfilename;
 	} else {
 		filename2++;
 	}
@@ -228,106 +498,481 @@ void Sample::Save(char *folder) {
 	fclose(fp);
 }
 
+ClassDictionary::ClassDictionary() {
+	numclasses = 0;
+	capacity = 0;
+	names = NULL;
+	hashsize = 0;
+	hashtable = NULL;
+}
+
+ClassDictionary::~ClassDictionary() {
+	Clear();
+}
+
+void ClassDictionary::Clear() {
+	if(names) free(names);
+	if(hashtable) free(hashtable);
+	numclasses = 0;
+	capacity = 0;
+	names = NULL;
+	hashsize = 0;
+	hashtable = NULL;
+}
+
+void ClassDictionary::Move(ClassDictionary *other) {
+	Clear();
+	numclasses = other->numclasses;
+	capacity = other->capacity;
+	names = other->names;
+	hashsize = other->hashsize;
+	hashtable = other->hashtable;
+	other->numclasses = 0;
+	other->capacity = 0;
+	other->names = NULL;
+	other->hashsize = 0;
+	other->hashtable = NULL;
+}
+
+long ClassDictionary::FindSlot(char *name) {
+	//FNV-1a hash of the name
+	unsigned long long hash = 14695981039346656037ULL;
+	for(char *c = name; *c; c++) {
+		hash ^= (unsigned char)(*c);
+		hash *= 1099511628211ULL;
+	}
+	long slot = (long)(hash & (hashsize-1));
+	while((hashtable[slot] >= 0) && (strcmp(names[hashtable[slot]],name)!=0)) {
+		slot = (slot+1) & (hashsize-1);
+	}
+	return slot;
+}
+
+long ClassDictionary::Find(char *classname) {
+	if(numclasses == 0) return -1;
+	char name[SAMPLE_CLASS_SIZE];
+	strncpy(name,classname,SAMPLE_CLASS_SIZE);
+	name[SAMPLE_CLASS_SIZE-1] = 0;
+	return hashtable[FindSlot(name)];
+}
+
+long ClassDictionary::Add(char *classname) {
+	long i;
+	char name[SAMPLE_CLASS_SIZE];
+	strncpy(name,classname,SAMPLE_CLASS_SIZE);
+	name[SAMPLE_CLASS_SIZE-1] = 0;
+
+	if(numclasses > 0) {
+		long slot = FindSlot(name);
+		if(hashtable[slot] >= 0) return hashtable[slot];
+	}
+
+	if(numclasses == capacity) {
+		capacity = (capacity > 0) ? 2*capacity : 64;
+		names = (char (*)[SAMPLE_CLASS_SIZE])realloc(names,capacity*SAMPLE_CLASS_SIZE);
+	}
+	memcpy(names[numclasses],name,SAMPLE_CLASS_SIZE);
+	numclasses++;
+
+	//the hash table is kept at most half full
+	if(2*numclasses > hashsize) {
+		hashsize = (hashsize > 0) ? 2*hashsize : 128;
+		hashtable = (long *)realloc(hashtable,hashsize*sizeof(long));
+		for(i=0;i<hashsize;i++) hashtable[i] = -1;
+		for(i=0;i<numclasses;i++) hashtable[FindSlot(names[i])] = i;
+	} else {
+		hashtable[FindSlot(name)] = numclasses-1;
+	}
+	return numclasses-1;
+}
+
 SampleSet::SampleSet() {
 	numsamples = 0;
 	samples = NULL;
+	dim = 0;
+	data = NULL;
+	classids = NULL;
+	classcounts = NULL;
+	classcapacity = 0;
+	strings = NULL;
+	stringsize = 0;
+	stringcapacity = 0;
+	fileoffsets = NULL;
+	mapping = NULL;
+	loaderrors = NULL;
+	numloaderrors = 0;
+	loadThreads = 0;
 };
 
 SampleSet::~SampleSet() {
-	if(samples) {
-		for(long i=0;i<numsamples;i++) {
-			if(samples[i]) delete samples[i];
-		}
-		free(samples);
+	Clear();
+}
+
+void SampleSet::AllocateData(long dim) {
+	this->dim = dim;
+	data = (double *)AlignedAlloc(numsamples*dim*sizeof(double));
+	memset(data,0,numsamples*dim*sizeof(double));
+}
+
+long SampleSet::AddString(char *str, long maxlength) {
+	long len = strlen(str);
+	if(len > maxlength-1) len = maxlength-1;
+	//position 0 always holds an empty string
+	if(len == 0) return 0;
+	if(stringsize+len+1 > stringcapacity) {
+		//str may point into the string table itself
+		long srcoffset = -1;
+		if((str >= strings) && (str < strings+stringsize)) srcoffset = str - strings;
+		while(stringsize+len+1 > stringcapacity) stringcapacity *= 2;
+		strings = (char *)realloc(strings,stringcapacity);
+		if(srcoffset >= 0) str = &(strings[srcoffset]);
+	}
+	long pos = stringsize;
+	memcpy(&(strings[pos]),str,len);
+	strings[pos+len] = 0;
+	stringsize += len+1;
+	return pos;
+}
+
+void SampleSet::SetFilename(long i, char *filename) {
+	fileoffsets[i] = AddString(filename,SAMPLE_FILE_SIZE);
+}
+
+void SampleSet::SetClassname(long i, char *classname) {
+	long id = classes.Add(classname);
+	if(id >= classcapacity) {
+		long oldcapacity = classcapacity;
+		classcapacity = 2*classes.Size();
+		classcounts = (long *)realloc(classcounts,classcapacity*sizeof(long));
+		memset(&(classcounts[oldcapacity]),0,(classcapacity-oldcapacity)*sizeof(long));
 	}
+	classcounts[classids[i]]--;
+	classcounts[id]++;
+	classids[i] = id;
+}
+
+bool SampleSet::IsContiguous() {
+	if(!data) return false;
+	for(long i=0;i<numsamples;i++) {
+		if(samples[i].data != &(data[i*dim])) return false;
+	}
+	return true;
 }
 
 void SampleSet::Merge(SampleSet *other) {
-	int i,oldsize;
-	oldsize = numsamples;
-	numsamples += other->numsamples;
-	samples = (Sample **)realloc(samples,numsamples * sizeof(Sample *));
+	long i;
+	long total = numsamples + other->numsamples;
 
+	//the samples are copied into the storage of a new set
+	SampleSet merged;
+	merged.Init(total);
+	for(i=0;i<numsamples;i++) {
+		merged.samples[i] = samples[i];
+	}
 	for(i=0;i<other->numsamples;i++) {
-		samples[i+oldsize] = new Sample(other->samples[i]->Size());
-
-		samples[i+oldsize]->SetClassname(other->samples[i]->GetClassname());
-		samples[i+oldsize]->SetFilename(other->samples[i]->GetFilename());
-	
-		samples[i+oldsize]->SetData(other->samples[i]->Size(), other->samples[i]->GetData());
+		merged.samples[numsamples+i] = other->samples[i];
 	}
+
+	//take over the storage of the new set
+	Clear();
+	numsamples = merged.numsamples;
+	samples = merged.samples;
+	dim = merged.dim;
+	data = merged.data;
+	classids = merged.classids;
+	classes.Move(&merged.classes);
+	classcounts = merged.classcounts;
+	classcapacity = merged.classcapacity;
+	strings = merged.strings;
+	stringsize = merged.stringsize;
+	stringcapacity = merged.stringcapacity;
+	fileoffsets = merged.fileoffsets;
+	for(i=0;i<numsamples;i++) samples[i].owner = this;
+
+	merged.numsamples = 0;
+	merged.samples = NULL;
+	merged.data = NULL;
+	merged.classids = NULL;
+	merged.classcounts = NULL;
+	merged.strings = NULL;
+	merged.fileoffsets = NULL;
 }
 
 void SampleSet::Init(long numsamples, int dim) {
+	long i;
 	Clear();
 	this->numsamples = numsamples;
-	samples = (Sample **)malloc(numsamples * sizeof(Sample *));
-	for(long i=0;i<numsamples;i++) {
-		if(dim)	samples[i] = new Sample(dim);
-		else samples[i] = new Sample();
+	samples = new Sample[numsamples];
+	classids = (long *)malloc(numsamples*sizeof(long));
+	fileoffsets = (long *)malloc(numsamples*sizeof(long));
+	stringcapacity = 1024;
+	strings = (char *)malloc(stringcapacity);
+	strings[0] = 0;
+	stringsize = 1;
+	//all samples initially belong to the class with an empty name
+	classes.Add(emptyname);
+	classcapacity = 64;
+	classcounts = (long *)malloc(classcapacity*sizeof(long));
+	memset(classcounts,0,classcapacity*sizeof(long));
+	classcounts[0] = numsamples;
+	for(i=0;i<numsamples;i++) {
+		samples[i].owner = this;
+		samples[i].index = i;
+		classids[i] = 0;
+		fileoffsets[i] = 0;
+	}
+	if(dim) {
+		AllocateData(dim);
+		for(i=0;i<numsamples;i++) {
+			samples[i].size = dim;
+			samples[i].data = &(data[i*dim]);
+		}
+	}
+}
+
+void SampleSet::SetNamesFromLine(long i, char *line) {
+	//the file name and the class name are the first two words of the line, either may be missing
+	char *names[2] = {emptyname, emptyname};
+	for(int k=0;k<2;k++) {
+		while(*line && isspace((unsigned char)*line)) line++;
+		if(!*line) break;
+		names[k] = line;
+		while(*line && !isspace((unsigned char)*line)) line++;
+		if(*line) *(line++) = 0;
+	}
+	SetFilename(i,names[0]);
+	SetClassname(i,names[1]);
+}
+
+//arguments of the sample loading threads
+struct SampleLoadContext {
+	SampleSet *samples;
+	long first;
+	int type;
+	long size;
+	char *loaded;	//receives 1 for each sample loaded successfully
+};
+
+void SampleSet::LoadSampleThread(long i, void *context) {
+	SampleLoadContext *c = (SampleLoadContext *)context;
+	Sample *sample = &(c->samples->samples[c->first+i]);
+	c->loaded[i] = (char)sample->LoadData(sample->GetFilename(),c->type,c->size);
+}
+
+void SampleSet::LoadSampleData(long first, long num, int type, long size) {
+	long i;
+	char *loaded = (char *)malloc(num+1);
+
+	//the first sample that is loaded allocates the feature block, so the samples are loaded one by one until then
+	//afterwards the samples only write to their rows of the feature block
+	for(i=0;(i<num)&&(dim==0);i++) {
+		loaded[i] = (char)samples[first+i].LoadData(samples[first+i].GetFilename(),type,size);
+	}
+
+	SampleLoadContext context;
+	context.samples = this;
+	context.first = first+i;
+	context.type = type;
+	context.size = size;
+	context.loaded = &(loaded[i]);
+	ParallelFor(num-i,loadThreads,LoadSampleThread,&context);
+
+	for(i=0;i<num;i++) {
+		if(loaded[i]) continue;
+		loaderrors = (long *)realloc(loaderrors,(numloaderrors+1)*sizeof(long));
+		loaderrors[numloaderrors++] = first+i;
+	}
+	free(loaded);
+}
+
+void SampleSet::AddLoadErrors(SampleSet *chunk, long first) {
+	if(!chunk->numloaderrors) return;
+	loaderrors = (long *)realloc(loaderrors,(numloaderrors+chunk->numloaderrors)*sizeof(long));
+	for(long i=0;i<chunk->numloaderrors;i++) {
+		loaderrors[numloaderrors++] = first+chunk->loaderrors[i];
 	}
 }
 
 long SampleSet::Load(char *filename,int type, long size) {
+	if(IsBinarySampleSet(filename)) return LoadBinary(filename);
+
+	//the text file is read at once
 	FILE *fp;
-	fp = fopen(filename,"r");
+	fp = fopen(filename,"rb");
 	if(!fp) return 0;
+	fseek(fp,0,SEEK_END);
+	long length = ftell(fp);
+	fseek(fp,0,SEEK_SET);
+	char *text = (char *)malloc(length+1);
+	length = fread(text,1,length,fp);
+	text[length] = 0;
+	fclose(fp);
+
 	long N = 0;
+	for(long j=0;j<length;j++) {
+		if(text[j] == '\n') N++;
+	}
+	if((length > 0) && (text[length-1] != '\n')) N++;
+
+	Init(N);
+	char *line = text;
+	for(long i=0;i<N;i++) {
+		char *end = strchr(line,'\n');
+		if(end) *(end++) = 0;
+		SetNamesFromLine(i,line);
+		line = end;
+	}
+	free(text);
+
+	LoadSampleData(0,N,type,size);
+	return N;
+}
+
+long SampleSet::LoadChunk(FILE *fp, long maxSamples, int type, long size) {
+	Init(maxSamples);
 	char line[SAMPLE_FILE_SIZE+SAMPLE_CLASS_SIZE+2];
-	while(fgets(line,SAMPLE_FILE_SIZE+SAMPLE_CLASS_SIZE+2,fp)) N++;
-	Clear();
-	numsamples = N;
-	samples = (Sample **)malloc(N * sizeof(Sample *));
-	fseek(fp,0,SEEK_SET);
 	long i = 0;
-	while(fgets(line,SAMPLE_FILE_SIZE+SAMPLE_CLASS_SIZE+2,fp)) {
-		samples[i] = new Sample;
-		char filename2[SAMPLE_FILE_SIZE+SAMPLE_CLASS_SIZE+2];
-		char classname[SAMPLE_FILE_SIZE+SAMPLE_CLASS_SIZE+2] = "";
-		sscanf(line,"%s %s",filename2,classname);
-		samples[i]->Load(filename2,classname,type,size);
+	while(i<maxSamples) {
+		if(!fgets(line,SAMPLE_FILE_SIZE+SAMPLE_CLASS_SIZE+2,fp)) break;
+		SetNamesFromLine(i,line);
 		i++;
 	}
-	fclose(fp);
+	//the samples that were not read are removed from the class counts
+	for(long j=i;j<maxSamples;j++) classcounts[classids[j]]--;
+	numsamples = i;
+	LoadSampleData(0,i,type,size);
+	return i;
+}
+
+int SampleSet::SaveBinary(char *filename, int type) {
+	long i;
+	if(!BinaryTypeSize(type)) return 0;
+	FILE *fp = fopen(filename,"wb");
+	if(!fp) return 0;
+	BinarySampleSetHeader header;
+	memset(&header,0,sizeof(header));
+	header.numsamples = numsamples;
+	header.dim = numsamples ? samples[0].Size() : 0;
+	header.type = type;
+	void *buffer = malloc((header.dim+1)*sizeof(double));
+	fseek(fp,BINARY_SAMPLESET_DATA_OFFSET,SEEK_SET);
+	for(i=0;i<numsamples;i++) {
+		WriteBinaryFeatures(fp,&(samples[i]),(long)header.dim,type,buffer);
+	}
+	free(buffer);
+	int ret = WriteBinaryNames(fp,this,&header);
+	if(fclose(fp)) ret = 0;
+	return ret;
+}
+
+long SampleSet::LoadBinary(char *filename) {
+	long i;
+	Clear();
+	MappedFile *file = new MappedFile;
+	BinarySampleSetHeader *header = OpenBinarySampleSet(filename,file);
+	if(!header) {
+		delete file;
+		return 0;
+	}
+	long N = (long)header->numsamples;
+	Init(N);
+	if(!ReadBinaryNames(file,header,this)) {
+		delete file;
+		Clear();
+		return 0;
+	}
+	void *features = (char *)file->GetData() + BINARY_SAMPLESET_DATA_OFFSET;
+	if(header->type == TYPE_DOUBLE) {
+		//the feature block is the mapped file
+		dim = (long)header->dim;
+		data = (double *)features;
+		mapping = file;
+	} else {
+		if(header->dim) {
+			AllocateData((long)header->dim);
+			ConvertFromBinaryType(features,(int)header->type,data,N*dim);
+		}
+		delete file;
+	}
+	if(dim) {
+		for(i=0;i<N;i++) {
+			samples[i].size = dim;
+			samples[i].data = &(data[i*dim]);
+		}
+	}
 	return N;
 }
 
+long SampleSet::LoadBinaryChunk(MappedFile *file, BinarySampleSetHeader *header, long first, long maxSamples) {
+	long i;
+	long N = (long)header->numsamples;
+	if(first >= N) {
+		Clear();
+		return 0;
+	}
+	if(maxSamples > N-first) maxSamples = N-first;
+	Init(maxSamples,(int)header->dim);
+	char *base = (char *)file->GetData();
+	long long *classids = (long long *)(base + header->classidoffset);
+	char (*classnames)[SAMPLE_CLASS_SIZE] = (char (*)[SAMPLE_CLASS_SIZE])(base + header->classoffset);
+	for(i=0;i<maxSamples;i++) {
+		long long classid = classids[first+i];
+		if((classid < 0) || (classid >= header->numclasses) || !memchr(classnames[classid],0,SAMPLE_CLASS_SIZE)) {
+			Clear();
+			return 0;
+		}
+		SetClassname(i,classnames[classid]);
+	}
+	if(dim) {
+		void *features = base + BINARY_SAMPLESET_DATA_OFFSET + first*dim*BinaryTypeSize((int)header->type);
+		ConvertFromBinaryType(features,(int)header->type,data,maxSamples*dim);
+	}
+	return maxSamples;
+}
+
 void SampleSet::Save(char *folder) {
 	long i;
 	for(i=0;i<numsamples;i++) {
-		samples[i]->Save(folder);
+		samples[i].Save(folder);
 	}
 }
 
 Sample SampleSet::GetAvgSample() {
 	long i,j;
-	long size = samples[0]->Size();
+	long size = samples[0].Size();
 	Sample avg(size);
+	double *sum = avg.GetData();
+	double *src;
 	for(i=0;i<numsamples;i++) {
+		src = samples[i].GetData();
 		for(j=0;j<size;j++) {
-			avg[j] += (*samples[i])[j];
+			sum[j] += src[j];
 		}
 	}
 	for(j=0;j<size;j++) {
-		avg[j] /= numsamples;
+		sum[j] /= numsamples;
 	}
 	return avg;
 }
 
 Sample SampleSet::GetAvgSampleOfClass(char *classname) {
 	long i,j,k = 0;
-	long size = samples[0]->Size();
+	long size = samples[0].Size();
+	long id = classes.Find(classname);
 	Sample avg(size);
 	avg.SetClassname(classname);
+	double *sum = avg.GetData();
+	double *src;
 	for(i=0;i<numsamples;i++) {
-		if(strcmp(samples[i]->GetClassname(),classname)!=0) continue;
+		if(classids[i] != id) continue;
+		src = samples[i].GetData();
 		for(j=0;j<size;j++) {
-			avg[j] += (*samples[i])[j];
+			sum[j] += src[j];
 		}
 		k++;
 	}
 	for(j=0;j<size;j++) {
-		avg[j] /= k;
+		sum[j] /= k;
 	}
 	return avg;
 }
@@ -335,147 +980,566 @@ Sample SampleSet::GetAvgSampleOfClass(char *classname) {
 //collumns are samples
 Matrix SampleSet::GetAsMatrix() {
 	long i,j,m,n;
-	m = samples[0]->Size();		//rows
+	m = samples[0].Size();		//rows
 	n = numsamples;				//collumns
 	Matrix mat(m,n);
+	double *dst = mat.GetData();
+	double *src;
+	//samples are read sequentially, each one is written into a column
+	for(j=0;j<n;j++) {
+		src = samples[j].GetData();
+		for(i=0;i<m;i++) {
+			dst[i*n+j] = src[i];
+		}
+	}
+	return mat;
+}
+
+//rows are samples
+Matrix SampleSet::GetAsRowMatrix(Sample *center) {
+	long i,j,m,n;
+	m = numsamples;				//rows
+	n = samples[0].Size();		//collumns
+	Matrix mat(m,n);
+	double *row,*src;
 	for(i=0;i<m;i++) {
-		for(j=0;j<n;j++) {
-			mat[i][j] = (*samples[j])[i];
+		row = mat[i];
+		src = samples[i].GetData();
+		if(center) {
+			for(j=0;j<n;j++) {
+				row[j] = src[j] - (*center)[j];
+			}
+		} else {
+			memcpy(row,src,n*sizeof(double));
 		}
 	}
 	return mat;
 }
 
+long SampleSet::IndexClasses(long *sampleClass, long *classCount) {
+	long i,c;
+	long numclasses = 0;
+	//maps class ids to class indices
+	long *classIndex = (long *)malloc(classes.Size()*sizeof(long));
+	for(c=0;c<classes.Size();c++) classIndex[c] = -1;
+	for(i=0;i<numsamples;i++) {
+		c = classids[i];
+		if(classIndex[c] < 0) {
+			classIndex[c] = numclasses;
+			classCount[numclasses] = 0;
+			numclasses++;
+		}
+		sampleClass[i] = classIndex[c];
+		classCount[classIndex[c]]++;
+	}
+	free(classIndex);
+	return numclasses;
+}
+
+Matrix SampleSet::GetClassMeans(long numclasses, long *sampleClass, long *classCount) {
+	long i,j;
+	long n = samples[0].Size();
+	Matrix M(numclasses,n);
+	double *row,*src;
+	for(i=0;i<numsamples;i++) {
+		row = M[sampleClass[i]];
+		src = samples[i].GetData();
+		for(j=0;j<n;j++) row[j] += src[j];
+	}
+	for(i=0;i<numclasses;i++) {
+		row = M[i];
+		for(j=0;j<n;j++) row[j] /= classCount[i];
+	}
+	return M;
+}
+
+//number of samples centered and accumulated at once when computing the within-class variance
+#define SCATTER_BLOCK_SIZE 256
+
 Matrix SampleSet::GetWithinClassVariance() {
 	long i,j,k;
 	long n,N;
-	n = samples[0]->Size();
+	n = samples[0].Size();
 	N = numsamples;
 
 	Matrix W(n,n);
 
-	//get number of classes and class averages
-	long numclasses=GetNumberOfClasses();
-	Sample *avgClassSamples = new Sample[numclasses];
-	long tmpnumclasses = 0;
-	for(i=0;i<N;i++) {
-		bool found = false;
-		for(j=i-1;j>=0;j--) {
-			if(strcmp(samples[i]->GetClassname(),samples[j]->GetClassname())==0) found = true;
-		}
-		if(!found) {
-			avgClassSamples[tmpnumclasses] = GetAvgSampleOfClass(samples[i]->GetClassname());
-			tmpnumclasses++;
-		}
-	}
+	//get classes and class averages
+	long *sampleClass = (long *)malloc(N*sizeof(long));
+	long *classCount = (long *)malloc(N*sizeof(long));
+	long numclasses = IndexClasses(sampleClass,classCount);
+	Matrix avgClassSamples = GetClassMeans(numclasses,sampleClass,classCount);
 
 	//get the within-class variance matrix
-	long classno = 0;
-	double *tmp = (double *)malloc(n*sizeof(double));
-	for(i=0;i<N;i++) {
-		for(j=0;j<numclasses;j++) {
-			if(strcmp(samples[i]->GetClassname(),avgClassSamples[j].GetClassname())==0) {
-				classno = j;
-				break;
-			}
-		}
-		for(j=0;j<n;j++) {
-			tmp[j] = ((*samples[i])[j]) - (avgClassSamples[classno][j]);
+	//W = Xc'*Xc, where the rows of Xc are samples with their class averages substracted
+	//Xc is processed in blocks of rows in order to limit the memory use
+	long blocksize = (N < SCATTER_BLOCK_SIZE) ? N : SCATTER_BLOCK_SIZE;
+	double *Xc = (double *)malloc(blocksize*n*sizeof(double));
+	double *row,*src,*avg;
+	for(i=0;i<N;i+=blocksize) {
+		long nb = (N-i < blocksize) ? (N-i) : blocksize;
+		for(j=0;j<nb;j++) {
+			row = &(Xc[j*n]);
+			src = samples[i+j].GetData();
+			avg = avgClassSamples[sampleClass[i+j]];
+			for(k=0;k<n;k++) row[k] = src[k] - avg[k];
 		}
-		for(j=0;j<n;j++) {
-			for(k=0;k<j;k++) {
-				W[j][k] += tmp[j]*tmp[k];
-				W[k][j] += tmp[j]*tmp[k];
-			}
-		}
-		for(j=0;j<n;j++) W[j][j] += tmp[j]*tmp[j];
+		syrk(GEMM_TRANS,n,nb,1.0,Xc,n,1.0,W.GetData(),n);
 	}
 
-	free(tmp);
-	delete [] avgClassSamples;
+	free(Xc);
+	free(sampleClass);
+	free(classCount);
 	return W;
 }
 
 Matrix SampleSet::GetBetweenClassVariance() {
-	long i,j,k;
+	long i,j;
 	long n,N;
-	n = samples[0]->Size();
+	n = samples[0].Size();
 	N = numsamples;
 
-	Matrix B(n,n);
-
-	//get number of classes and class averages
-	long numclasses=GetNumberOfClasses();
+	//get classes and class averages
 	Sample avg = this->GetAvgSample();
-	Sample *avgClassSamples = new Sample[numclasses];
-	long *classno = (long *)malloc(numclasses*sizeof(long));
-	long tmpnumclasses = 0;
-	for(i=0;i<N;i++) {
-		bool found = false;
-		for(j=i-1;j>=0;j--) {
-			if(strcmp(samples[i]->GetClassname(),samples[j]->GetClassname())==0) {
-				found = true;
-			}
-		}
-		if(!found) {
-			avgClassSamples[tmpnumclasses] = GetAvgSampleOfClass(samples[i]->GetClassname());
-			tmpnumclasses++;
+	long *sampleClass = (long *)malloc(N*sizeof(long));
+	long *classCount = (long *)malloc(N*sizeof(long));
+	long numclasses = IndexClasses(sampleClass,classCount);
+	Matrix M = GetClassMeans(numclasses,sampleClass,classCount);
+
+	//get the between-class variance matrix
+	//B = M'*M, where the i-th row of M is sqrt(classCount[i])*(avgClassSample[i]-avg)
+	double *row;
+	double weight;
+	for(i=0;i<numclasses;i++) {
+		row = M[i];
+		weight = sqrt((double)classCount[i]);
+		for(j=0;j<n;j++) row[j] = weight*(row[j] - avg[j]);
+	}
+	Matrix B = M.SymmetricProduct(true);
+
+	free(sampleClass);
+	free(classCount);
+	return B;
+}
+
+long SampleSet::GetNumberOfClasses() {
+	long c,numclasses = 0;
+	for(c=0;c<classes.Size();c++) {
+		if(classcounts[c] > 0) numclasses++;
+	}
+	return numclasses;
+}
+
+void SampleSet::Clear() {
+	if(samples) delete [] samples;
+	if(mapping) delete mapping;
+	else if(data) AlignedFree(data);
+	if(classids) free(classids);
+	if(classcounts) free(classcounts);
+	if(strings) free(strings);
+	if(fileoffsets) free(fileoffsets);
+	if(loaderrors) free(loaderrors);
+	samples = NULL;
+	numsamples = 0;
+	dim = 0;
+	data = NULL;
+	mapping = NULL;
+	classids = NULL;
+	classes.Clear();
+	classcounts = NULL;
+	classcapacity = 0;
+	strings = NULL;
+	stringsize = 0;
+	stringcapacity = 0;
+	fileoffsets = NULL;
+	loaderrors = NULL;
+	numloaderrors = 0;
+}
+
+FloatSampleSet::FloatSampleSet() {
+	dim = 0;
+	data = NULL;
+	mapping = NULL;
+}
+
+FloatSampleSet::~FloatSampleSet() {
+	Clear();
+}
+
+void FloatSampleSet::Init(long numsamples, long dim) {
+	Clear();
+	names.Init(numsamples);
+	this->dim = dim;
+	if(numsamples && dim) {
+		data = (float *)AlignedAlloc(numsamples*dim*sizeof(float));
+		memset(data,0,numsamples*dim*sizeof(float));
+	}
+}
+
+void FloatSampleSet::Clear() {
+	if(mapping) delete mapping;
+	else if(data) AlignedFree(data);
+	data = NULL;
+	mapping = NULL;
+	dim = 0;
+	names.Clear();
+}
+
+void FloatSampleSet::CopySamples(SampleSet *samples, long first) {
+	long i,j,n;
+	for(i=0;i<samples->Size();i++) {
+		Sample *sample = samples->GetSample(i);
+		float *dst = GetSampleData(first+i);
+		double *src = sample->GetData();
+		n = (sample->Size() < dim) ? sample->Size() : dim;
+		ConvertToFloat(src,dst,n);
+		for(j=n;j<dim;j++) dst[j] = 0;
+		names[first+i].SetFilename(sample->GetFilename());
+		names[first+i].SetClassname(sample->GetClassname());
+	}
+}
+
+void FloatSampleSet::Convert(SampleSet *samples) {
+	long N = samples->Size();
+	Init(N,N ? (*samples)[0].Size() : 0);
+	CopySamples(samples,0);
+}
+
+//number of samples read at once by FloatSampleSet::Load
+#define FLOAT_LOAD_CHUNK_SIZE 1000
+
+long FloatSampleSet::Load(char *filename, int type, long size) {
+	if(IsBinarySampleSet(filename)) return LoadBinary(filename);
+	FILE *fp;
+	fp = fopen(filename,"r");
+	if(!fp) return 0;
+	long N = 0;
+	char line[SAMPLE_FILE_SIZE+SAMPLE_CLASS_SIZE+2];
+	while(fgets(line,SAMPLE_FILE_SIZE+SAMPLE_CLASS_SIZE+2,fp)) N++;
+	Init(N,0);
+	fseek(fp,0,SEEK_SET);
+	SampleSet chunk;
+	long i = 0, j, n;
+	while(i<N) {
+		n = chunk.LoadChunk(fp,(N-i < FLOAT_LOAD_CHUNK_SIZE) ? (N-i) : FLOAT_LOAD_CHUNK_SIZE,type,size);
+		if(n == 0) break;
+		//the dimensionality is given by the first sample that was read successfully
+		for(j=0;(j<n)&&(!data);j++) {
+			if(!chunk[j].Size()) continue;
+			dim = chunk[j].Size();
+			data = (float *)AlignedAlloc(N*dim*sizeof(float));
+			memset(data,0,N*dim*sizeof(float));
 		}
+		CopySamples(&chunk,i);
+		names.AddLoadErrors(&chunk,i);
+		i += n;
 	}
-	for(i=0;i<numclasses;i++) {
-		classno[i]=0;
-		for(j=0;j<N;j++) {
-			if(strcmp(avgClassSamples[i].GetClassname(),samples[j]->GetClassname())==0) {
-				classno[i]++;
-			}
+	fclose(fp);
+	return N;
+}
+
+long FloatSampleSet::LoadBinary(char *filename) {
+	Clear();
+	MappedFile *file = new MappedFile;
+	BinarySampleSetHeader *header = OpenBinarySampleSet(filename,file);
+	if(!header) {
+		delete file;
+		return 0;
+	}
+	long N = (long)header->numsamples;
+	names.Init(N);
+	if(!ReadBinaryNames(file,header,&names)) {
+		delete file;
+		Clear();
+		return 0;
+	}
+	dim = (long)header->dim;
+	void *features = (char *)file->GetData() + BINARY_SAMPLESET_DATA_OFFSET;
+	if(header->type == TYPE_FLOAT) {
+		//the feature block is the mapped file
+		data = (float *)features;
+		mapping = file;
+	} else {
+		if(N && dim) {
+			data = (float *)AlignedAlloc(N*dim*sizeof(float));
+			ConvertFromBinaryType(features,(int)header->type,data,N*dim);
 		}
+		delete file;
 	}
+	return N;
+}
 
-	//get the between-class variance matrix
-	double *tmp = (double *)malloc(n*sizeof(double));
-	for(i=0;i<numclasses;i++) {
-		for(j=0;j<n;j++) {
-			tmp[j] = (avgClassSamples[i][j]) - (avg[j]);
+//number of samples read at once by ConvertSampleSet
+#define CONVERT_CHUNK_SIZE 1000
+
+long ConvertSampleSet(char *listfilename, int type, long size, char *binfilename, int bintype, SampleSet *names) {
+	if(!BinaryTypeSize(bintype)) return 0;
+	FILE *fp = fopen(listfilename,"r");
+	if(!fp) return 0;
+	long N = 0;
+	char line[SAMPLE_FILE_SIZE+SAMPLE_CLASS_SIZE+2];
+	while(fgets(line,SAMPLE_FILE_SIZE+SAMPLE_CLASS_SIZE+2,fp)) N++;
+	fseek(fp,0,SEEK_SET);
+	FILE *out = fopen(binfilename,"wb");
+	if(!out) {
+		fclose(fp);
+		return 0;
+	}
+
+	BinarySampleSetHeader header;
+	memset(&header,0,sizeof(header));
+	header.type = bintype;
+	void *buffer = NULL;
+
+	//the names and classes are collected in a sample set without feature vectors and written after the features
+	SampleSet localnames;
+	if(!names) names = &localnames;
+	names->Init(N);
+	SampleSet chunk;
+	long i = 0, j, n;
+	while(i<N) {
+		n = chunk.LoadChunk(fp,(N-i < CONVERT_CHUNK_SIZE) ? (N-i) : CONVERT_CHUNK_SIZE,type,size);
+		if(n == 0) break;
+		//the dimensionality is given by the first sample that was read successfully
+		for(j=0;(j<n)&&(!buffer);j++) {
+			if(!chunk[j].Size()) continue;
+			header.dim = chunk[j].Size();
+			buffer = malloc(header.dim*sizeof(double));
+			//the samples of the previous chunks are left as zeros
+			fseek(out,(long)(BINARY_SAMPLESET_DATA_OFFSET + i*header.dim*BinaryTypeSize(bintype)),SEEK_SET);
 		}
 		for(j=0;j<n;j++) {
-			for(k=0;k<j;k++) {
-				B[j][k] += classno[i]*tmp[j]*tmp[k];
-				B[k][j] += classno[i]*tmp[j]*tmp[k];
-			}
+			if(buffer) WriteBinaryFeatures(out,chunk.GetSample(j),(long)header.dim,bintype,buffer);
+			(*names)[i+j].SetFilename(chunk[j].GetFilename());
+			(*names)[i+j].SetClassname(chunk[j].GetClassname());
 		}
-		for(j=0;j<n;j++) B[j][j] += classno[i]*tmp[j]*tmp[j];
+		names->AddLoadErrors(&chunk,i);
+		i += n;
 	}
+	fclose(fp);
+	if(buffer) free(buffer);
 
-	free(tmp);
-	free(classno);
-	delete [] avgClassSamples;
-	return B;
+	header.numsamples = i;
+	int ret = WriteBinaryNames(out,names,&header);
+	if(fclose(out)) ret = 0;
+	return ret ? i : 0;
 }
 
-long SampleSet::GetNumberOfClasses() {
-	long i,j,numclasses = 0;
-	long N = numsamples;
-	for(i=0;i<N;i++) {
-		bool found = false;
-		for(j=i-1;j>=0;j--) {
-			if(strcmp(samples[i]->GetClassname(),samples[j]->GetClassname())==0) {
-				found = true;
-			}
+SampleStatistics::SampleStatistics() {
+	dim = 0;
+	count = 0;
+	mean = NULL;
+	scatter = NULL;
+	classcapacity = 0;
+	classcounts = NULL;
+	classmeans = NULL;
+	classStatistics = true;
+}
+
+SampleStatistics::~SampleStatistics() {
+	Clear();
+}
+
+void SampleStatistics::Clear() {
+	if(mean) free(mean);
+	if(scatter) free(scatter);
+	if(classcounts) free(classcounts);
+	if(classmeans) free(classmeans);
+	mean = NULL;
+	scatter = NULL;
+	classcounts = NULL;
+	classmeans = NULL;
+	dim = 0;
+	count = 0;
+	classes.Clear();
+	classcapacity = 0;
+}
+
+long SampleStatistics::GetClassIndex(char *classname) {
+	long numclasses = classes.Size();
+	long c = classes.Add(classname);
+	if(c == classcapacity) {
+		classcapacity = (classcapacity > 0) ? 2*classcapacity : 64;
+		classcounts = (long *)realloc(classcounts,classcapacity*sizeof(long));
+		classmeans = (double *)realloc(classmeans,classcapacity*dim*sizeof(double));
+	}
+	if(c == numclasses) {
+		//new class
+		classcounts[c] = 0;
+		memset(&(classmeans[c*dim]),0,dim*sizeof(double));
+	}
+	return c;
+}
+
+int SampleStatistics::Add(SampleSet *samples) {
+	long i,j,k;
+	long n,m;
+
+	m = samples->Size();
+	if(m == 0) return 1;
+	n = (*samples)[0].Size();
+
+	if(count == 0) {
+		Clear();
+		dim = n;
+		mean = (double *)malloc(n*sizeof(double));
+		scatter = (double *)malloc(n*n*sizeof(double));
+		memset(mean,0,n*sizeof(double));
+		memset(scatter,0,n*n*sizeof(double));
+	} else if(n != dim) {
+		printf("Error: sample dimensionality (%ld) does not match the statistics (%ld)\n",n,dim);
+		return 0;
+	}
+
+	//the new samples are centered on their own mean and their scatter is added
+	//to the scatter matrix, then the statistics are merged as
+	//scatter += delta*delta'*count*m/(count+m), where delta is the difference of the means
+	Sample avg = samples->GetAvgSample();
+	long blocksize = (m < SCATTER_BLOCK_SIZE) ? m : SCATTER_BLOCK_SIZE;
+	double *Xc = (double *)malloc(blocksize*n*sizeof(double));
+	double *row,*src;
+	for(i=0;i<m;i+=blocksize) {
+		long nb = (m-i < blocksize) ? (m-i) : blocksize;
+		for(j=0;j<nb;j++) {
+			row = &(Xc[j*n]);
+			src = samples->GetSample(i+j)->GetData();
+			for(k=0;k<n;k++) row[k] = src[k] - avg[k];
 		}
-		if(!found) {
-			numclasses++;
+		syrk(GEMM_TRANS,n,nb,1.0,Xc,n,1.0,scatter,n);
+	}
+	free(Xc);
+
+	double *delta = (double *)malloc(n*sizeof(double));
+	double total = (double)(count+m);
+	for(k=0;k<n;k++) delta[k] = avg[k] - mean[k];
+	syrk(GEMM_TRANS,n,1,((double)count)*m/total,delta,n,1.0,scatter,n);
+	for(k=0;k<n;k++) mean[k] += delta[k]*m/total;
+	free(delta);
+
+	count += m;
+
+	//class means are updated one sample at a time
+	if(classStatistics) {
+		//maps the class ids of the sample set to class indices
+		long *classIndex = (long *)malloc(samples->GetNumberOfClassIds()*sizeof(long));
+		for(i=0;i<samples->GetNumberOfClassIds();i++) classIndex[i] = -1;
+		long c;
+		for(i=0;i<m;i++) {
+			Sample *sample = samples->GetSample(i);
+			c = classIndex[samples->GetClassId(i)];
+			if(c < 0) {
+				c = GetClassIndex(sample->GetClassname());
+				classIndex[samples->GetClassId(i)] = c;
+			}
+			classcounts[c]++;
+			row = &(classmeans[c*n]);
+			src = sample->GetData();
+			for(k=0;k<n;k++) row[k] += (src[k] - row[k])/classcounts[c];
 		}
+		free(classIndex);
 	}
-	return numclasses;
+
+	return 1;
 }
 
-void SampleSet::Clear() {
-	if(samples) {
-		for(long i=0;i<numsamples;i++) {
-			if(samples[i]) delete samples[i];
+Matrix SampleStatistics::GetBetweenClassVariance() {
+	long i,j;
+
+	//B = M'*M, where the i-th row of M is sqrt(classcounts[i])*(classmeans[i]-mean)
+	long numclasses = classes.Size();
+	Matrix M(numclasses,dim);
+	double *row,*src;
+	double weight;
+	for(i=0;i<numclasses;i++) {
+		row = M[i];
+		src = &(classmeans[i*dim]);
+		weight = sqrt((double)classcounts[i]);
+		for(j=0;j<dim;j++) row[j] = weight*(src[j] - mean[j]);
+	}
+	return M.SymmetricProduct(true);
+}
+
+Matrix SampleStatistics::GetWithinClassVariance() {
+	long i;
+
+	//the scatter matrix is the sum of the within-class and between-class variance matrices
+	Matrix W = GetBetweenClassVariance();
+	double *data = W.GetData();
+	for(i=0;i<dim*dim;i++) data[i] = scatter[i] - data[i];
+	return W;
+}
+
+void SampleStatistics::Save(FILE *fp) {
+	long i;
+	fwrite(&dim,1,sizeof(long),fp);
+	fwrite(&count,1,sizeof(long),fp);
+	long numclasses = classes.Size();
+	fwrite(&numclasses,1,sizeof(long),fp);
+	fwrite(mean,dim,sizeof(double),fp);
+	fwrite(scatter,dim*dim,sizeof(double),fp);
+	for(i=0;i<numclasses;i++) {
+		fwrite(classes.GetName(i),1,SAMPLE_CLASS_SIZE,fp);
+		fwrite(&(classcounts[i]),1,sizeof(long),fp);
+		fwrite(&(classmeans[i*dim]),dim,sizeof(double),fp);
+	}
+}
+
+int SampleStatistics::Save(char *filename) {
+	FILE *fp;
+	fp = fopen(filename,"wb");
+	if(!fp) return 0;
+	Save(fp);
+	fclose(fp);
+	return 1;
+}
+
+int SampleStatistics::Load(FILE *fp) {
+	long i,n,N,C;
+	Clear();
+	if(fread(&n,sizeof(long),1,fp)!=1) return 0;
+	if(fread(&N,sizeof(long),1,fp)!=1) return 0;
+	if(fread(&C,sizeof(long),1,fp)!=1) return 0;
+	if((n<0) || (N<0) || (C<0)) return 0;
+	dim = n;
+	count = N;
+	mean = (double *)malloc(dim*sizeof(double));
+	scatter = (double *)malloc(dim*dim*sizeof(double));
+	if(fread(mean,sizeof(double),dim,fp)!=(size_t)dim) {
+		Clear();
+		return 0;
+	}
+	if(fread(scatter,sizeof(double),dim*dim,fp)!=(size_t)(dim*dim)) {
+		Clear();
+		return 0;
+	}
+	classStatistics = (C > 0);
+	if(C > 0) {
+		char name[SAMPLE_CLASS_SIZE];
+		for(i=0;i<C;i++) {
+			if(fread(name,1,SAMPLE_CLASS_SIZE,fp)!=SAMPLE_CLASS_SIZE) {
+				Clear();
+				return 0;
+			}
+			name[SAMPLE_CLASS_SIZE-1] = 0;
+			long c = GetClassIndex(name);
+			if((fread(&(classcounts[c]),sizeof(long),1,fp)!=1) ||
+				(fread(&(classmeans[c*dim]),sizeof(double),dim,fp)!=(size_t)dim))
+			{
+				Clear();
+				return 0;
+			}
 		}
-		free(samples);
 	}
+	return 1;
+}
+
+int SampleStatistics::Load(char *filename) {
+	FILE *fp;
+	fp = fopen(filename,"rb");
+	if(!fp) return 0;
+	int ret = Load(fp);
+	fclose(fp);
+	return ret;
 }
 
 } //namespace
@@ -35,15 +35,49 @@ namespace LibSubspace {
 extern long typesize[];
 
 class Matrix;
+class SampleSet;
+class MappedFile;
+
+//header of a binary sample set file, see SampleSet::SaveBinary()
+struct BinarySampleSetHeader {
+	char magic[8];	//binaryMagic
+	long long version;	//BINARY_SAMPLESET_VERSION
+	long long numsamples;	//number of samples
+	long long dim;	//size of the feature vectors
+	long long type;	//element type of the features
+	long long numclasses;	//number of classes in the class table
+	long long classidoffset;	//position of the class ids in the file
+	long long classoffset;	//position of the class table in the file
+	long long nameoffset;	//position of the file names in the file
+	long long namesize;	//size of the file names in bytes
+};
 
 //implements a single sample
 //the sample contains a feature vector (array of double), class name and file name
+//a sample is either standalone, owning its feature vector and names, or belongs to a SampleSet,
+//in which case it is a view into the sample set storage (see SampleSet)
 class Sample {
+	friend class SampleSet;
+
 protected:
 	long size;	//size of the feature vector
 	double* data;	//feature vector
-	char filename[SAMPLE_FILE_SIZE];	//filename, used for loading and storing, useful for i.e. seeing where the classification fails
-	char classname[SAMPLE_CLASS_SIZE];	//name of the class of the current sample
+	bool owndata;	//true if the feature vector was allocated by the sample rather than the sample set
+	SampleSet *owner;	//the sample set the sample belongs to, NULL for standalone samples
+	long index;	//index of the sample in the owner sample set
+	char *filename;	//filename of a standalone sample, used for loading and storing, useful for i.e. seeing where the classification fails
+	char *classname;	//name of the class of a standalone sample
+
+	//allocates the feature vector of 'size' features, in the owner sample set storage if possible
+	//the contents of the feature vector are undefined
+	void Allocate(long size);
+
+	//releases the feature vector
+	void Release();
+
+	//loads the feature vector from file, the same as Load() but the names of the sample are not changed
+	//returns 1 on success, 0 on failure
+	int LoadData(char *filename, int type, long size);
 	
 public:
 
@@ -71,13 +105,8 @@ public:
 		return data[i];
 	}
 
-	char *GetFilename() {
-		return filename;
-	}
-
-	char *GetClassname() {
-		return classname;
-	}
+	char *GetFilename();
+	char *GetClassname();
 
 	void SetFilename(char *filename);
 	void SetClassname(char *classname);
@@ -91,7 +120,7 @@ public:
 
 	//sets the feature vector as gray pixel values from an image in file 'filename'
 	//image data is stored in a vector in a row-oriented manner
-	//returns 1 on success, 0 on failure
+	//returns 1 on success, 0 on failure, no error messages are printed
 	int ReadImageData(char *filename);
 
 	//loads a sample from file. A file is assumed to be an array of type denoted by the 'type' param
@@ -100,7 +129,7 @@ public:
 	//	classname : name of the sample class
 	//	type : denotes the type of the data stored in file, for example TYPE_CHAR assumes signed 8-bit values
 	//	size : the number of features to be read
-	//returns 1 on success, 0 on failure
+	//returns 1 on success, 0 on failure (the file can not be read or is too short), no error messages are printed
 	int Load(char *filename, char *classname, int type, long size);
 
 	//saves the sample data to file
@@ -110,13 +139,116 @@ public:
 };
 
 
+//maps class names to dense integer ids (0, 1, 2, ...), in the order in which the names are added
+//names are looked up through a hash table
+class ClassDictionary {
+protected:
+	long numclasses;	//number of classes
+	long capacity;	//number of names the names array can hold
+	char (*names)[SAMPLE_CLASS_SIZE];	//class names, indexed by class id
+	long hashsize;	//size of the hash table, a power of 2
+	long *hashtable;	//class ids, -1 for empty slots, open addressing with linear probing
+
+	//returns the hash table slot holding the name, or the empty slot where it should be inserted
+	long FindSlot(char *name);
+
+public:
+	//constructor/destructor
+	ClassDictionary();
+	~ClassDictionary();
+
+	//removes all classes
+	void Clear();
+
+	//takes over the contents of another dictionary, leaving it empty
+	void Move(ClassDictionary *other);
+
+	//number of classes
+	long Size() {
+		return numclasses;
+	}
+
+	//returns the name of the class with the given id
+	char *GetName(long id) {
+		return names[id];
+	}
+
+	//returns the id of the class with the given name, or -1 if there is no such class
+	//names are compared up to SAMPLE_CLASS_SIZE-1 characters
+	long Find(char *classname);
+
+	//returns the id of the class with the given name, the class is added if it does not exist
+	long Add(char *classname);
+};
+
 //implements a collection of samples, for example a training or a test set
+//the feature vectors of all samples are stored in a single aligned row-major (numsamples x dim) block,
+//file names are stored in a string table, and each sample has an integer class id
+//class ids index a class dictionary, which also keeps the number of samples in each class
+//the Sample objects of a set are views into this storage
+//if a sample of a different size is stored into the set, that sample keeps its own feature vector
 class SampleSet {
+	friend class Sample;
+
 protected:
 	long numsamples;	//number of samples in the set
-	Sample **samples;	//samples
+	Sample *samples;	//samples, views into the storage below
+
+	long dim;	//size of the feature vectors in the feature block, 0 if not yet allocated
+	double *data;	//aligned row-major (numsamples x dim) feature block
+	MappedFile *mapping;	//binary sample set file the feature block is mapped from, NULL if the block was allocated
+
+	long *classids;	//class id of each sample
+	ClassDictionary classes;	//class names
+	long *classcounts;	//number of samples of each class, indexed by class id
+	long classcapacity;	//number of classes classcounts can hold
+
+	char *strings;	//string table, zero-terminated file names and class names
+	long stringsize;	//used size of the string table
+	long stringcapacity;	//allocated size of the string table
+	long *fileoffsets;	//position of the file name of each sample in the string table
+
+	long *loaderrors;	//indices of the samples that could not be loaded by Load() or LoadChunk()
+	long numloaderrors;	//number of the samples that could not be loaded
+
+	//allocates the feature block for feature vectors of size 'dim'
+	void AllocateData(long dim);
+
+	//adds a string of at most maxlength-1 characters to the string table and returns its position
+	long AddString(char *str, long maxlength);
+
+	//sets the names of the i-th sample
+	void SetFilename(long i, char *filename);
+	void SetClassname(long i, char *classname);
+
+	//sets the names of the i-th sample from a line of a text file describing a sample set, see Load()
+	//the line is modified
+	void SetNamesFromLine(long i, char *line);
+
+	//loads the feature vectors of 'num' samples, starting with the sample 'first', from the files given by their file names
+	//the files are read by loadThreads threads, the samples that could not be loaded are added to the load errors
+	void LoadSampleData(long first, long num, int type, long size);
+
+	//loads the feature vector of a single sample, called by the loading threads
+	static void LoadSampleThread(long i, void *context);
+
+	//finds the classes of the samples in the set, classes are numbered in the order of their first appearance
+	//classes without samples are skipped
+	//params:
+	//	sampleClass : array of numsamples elements, receives the class index of each sample
+	//	classCount : array of numsamples elements, receives the number of samples in each class
+	//returns the number of classes
+	long IndexClasses(long *sampleClass, long *classCount);
+
+	//computes the mean of each class
+	//returns a (number of classes x sample size) matrix, the i-th row is the mean of the i-th class
+	Matrix GetClassMeans(long numclasses, long *sampleClass, long *classCount);
 
 public:
+	//number of threads used by Load() and LoadChunk() to read the sample files
+	//0 (default) uses one thread per processor, the order of the samples does not depend on it
+	int loadThreads;
+
 	//constructor/destructor
 	SampleSet();
 	~SampleSet();
@@ -133,22 +265,110 @@ public:
 	}
 
 	Sample &operator[] (int i) {
-		return *(samples[i]);
+		return samples[i];
 	}
 
 	Sample* GetSample(int i) {
-		return samples[i];
+		return &(samples[i]);
+	}
+
+	//returns the feature block, the i-th row is the feature vector of the i-th sample
+	//valid only if IsContiguous() returns true
+	double *GetData() {
+		return data;
+	}
+
+	//returns true if the feature vectors of all samples are stored in the feature block
+	bool IsContiguous();
+
+	//returns the number of samples that could not be loaded by the last Load() or LoadChunk()
+	//such samples remain in the set with the feature vector that could be read, possibly empty
+	long GetNumberOfLoadErrors() {
+		return numloaderrors;
+	}
+
+	//returns the index of the i-th sample that could not be loaded, the indices are in increasing order
+	long GetLoadError(long i) {
+		return loaderrors[i];
+	}
+
+	//adds the samples of 'chunk' that could not be loaded to the load errors of this set,
+	//the sample 'first' of this set being the first sample of the chunk
+	//used when the samples of a set are loaded in chunks
+	void AddLoadErrors(SampleSet *chunk, long first);
+
+	//returns the class id of the i-th sample
+	long GetClassId(int i) {
+		return classids[i];
+	}
+
+	//returns the number of class ids, some of the classes may have no samples
+	long GetNumberOfClassIds() {
+		return classes.Size();
+	}
+
+	//returns the id of the class with the given name, -1 if there is no such class
+	long FindClassId(char *classname) {
+		return classes.Find(classname);
+	}
+
+	//returns the name of the class with the given id
+	char *GetClassnameById(long classid) {
+		return classes.GetName(classid);
+	}
+
+	//returns the number of samples of the class with the given id
+	long GetClassSize(long classid) {
+		return classcounts[classid];
 	}
 
 	//loads a sample set described in a text file, organized as
 	//<sample file name 1> <class of sample 1>
 	//<sample file name 2> <class of sample 2>
 	//...
+	//if the file is a binary sample set (see LoadBinary()), it is loaded with LoadBinary() instead
 	//Parameters:
 	//	filename : the name of the text file as described above
 	//	type : the individual sample files are assumed to contain araay of this type, see Sample.Load()
 	//	size : the feature vector length of each sample
 	long Load(char *filename,int type = TYPE_DOUBLE, long size = 0);
+
+	//loads a binary sample set file, created by SaveBinary() or ConvertSampleSet()
+	//the file is mapped into memory, if its features are of TYPE_DOUBLE the feature vectors of the samples
+	//point directly into the mapped file, otherwise they are converted into the feature block
+	//returns the number of samples, 0 on failure
+	long LoadBinary(char *filename);
+
+	//saves the sample set as a single binary file, organized as
+	//	header : BinarySampleSetHeader, see sample.cpp
+	//	features : row-major (number of samples x dim) matrix of the element type 'type', 64-byte aligned
+	//	class ids : 64-bit class id of each sample
+	//	class table : names of the classes, SAMPLE_CLASS_SIZE characters each, indexed by class id
+	//	file names : zero-terminated file names of the samples
+	//all numbers are stored in the byte order of the machine
+	//type can be TYPE_CHAR, TYPE_UCHAR, TYPE_INT (32-bit), TYPE_UINT (32-bit), TYPE_FLOAT or TYPE_DOUBLE,
+	//features are converted to it without rounding
+	//all samples must be of the size of the first sample
+	//returns 1 on success, 0 on failure
+	int SaveBinary(char *filename, int type = TYPE_DOUBLE);
+
+	//loads the next part of a sample set from a text file organized as described in Load()
+	//the set is cleared and at most maxSamples samples are read, starting from the current position in the file
+	//can be used to process sample sets that do not fit into memory in chunks
+	//Parameters:
+	//	fp : the text file, opened for reading
+	//	maxSamples : maximum number of samples to be read
+	//	type : the individual sample files are assumed to contain araay of this type, see Sample.Load()
+	//	size : the feature vector length of each sample
+	//returns the number of samples read, 0 when the end of file is reached
+	long LoadChunk(FILE *fp, long maxSamples, int type = TYPE_DOUBLE, long size = 0);
+
+	//loads the next part of a binary sample set file opened with OpenBinarySampleSet()
+	//the set is cleared and at most maxSamples samples, starting with the sample 'first', are converted into the feature block,
+	//so that only a chunk of the samples is kept in memory even if the features are of TYPE_DOUBLE
+	//the classes of the samples are set, the file names are not
+	//returns the number of samples read, 0 when 'first' is past the last sample or the file is corrupt
+	long LoadBinaryChunk(MappedFile *file, BinarySampleSetHeader *header, long first, long maxSamples);
 	
 	//saves all the samples in folder given as 'folder' param
 	//all samples are stored in files containing an array of double
@@ -165,6 +385,11 @@ public:
 	//each COLUMN of a matrix is one sample
 	Matrix GetAsMatrix();
 
+	//creates a matrix composed of samples
+	//each ROW of a matrix is one sample
+	//if center is given, it is substracted from each sample
+	Matrix GetAsRowMatrix(Sample *center = NULL);
+
 	//creates a within-class variance matrix of samples
 	Matrix GetWithinClassVariance();
 
@@ -180,5 +405,210 @@ public:
 	void Merge(SampleSet *other);
 };
 
-} //namespace
+//implements a collection of samples with single precision (float) feature vectors
+//uses half of the memory of a SampleSet and is intended for projecting and classifying
+//large sample sets, subspaces should still be learned from a SampleSet
+//the feature vectors of all samples have the same size and are stored in a single aligned row-major block
+class FloatSampleSet {
+protected:
+	long dim;	//size of the feature vectors
+	float *data;	//aligned row-major (number of samples x dim) feature block
+	MappedFile *mapping;	//binary sample set file the feature block is mapped from, NULL if the block was allocated
+	SampleSet names;	//file names and classes of the samples, its samples have no feature vectors
+
+	//copies the samples from 'samples' to this set, starting at the position 'first'
+	//the feature vectors are converted to float, missing features are set to 0
+	void CopySamples(SampleSet *samples, long first);
+
+public:
+	//constructor/destructor
+	FloatSampleSet();
+	~FloatSampleSet();
+
+	//creates the sample set with 'numsamples' samples, all of the size 'dim' with features set to 0
+	void Init(long numsamples, long dim);
+
+	//clears the sample set (deletes all samples)
+	void Clear();
+
+	//property getters and setters
+	long Size() {
+		return names.Size();
+	}
+
+	long GetDim() {
+		return dim;
+	}
+
+	//returns the feature block, the i-th row is the feature vector of the i-th sample
+	float *GetData() {
+		return data;
+	}
+
+	//returns the feature vector of the i-th sample
+	float *GetSampleData(long i) {
+		return &(data[i*dim]);
+	}
+
+	char *GetFilename(long i) {
+		return names[i].GetFilename();
+	}
+
+	char *GetClassname(long i) {
+		return names[i].GetClassname();
+	}
+
+	void SetFilename(long i, char *filename) {
+		names[i].SetFilename(filename);
+	}
+
+	void SetClassname(long i, char *classname) {
+		names[i].SetClassname(classname);
+	}
+
+	//class ids, see the corresponding SampleSet methods
+	long GetClassId(long i) {
+		return names.GetClassId(i);
+	}
+
+	long GetNumberOfClassIds() {
+		return names.GetNumberOfClassIds();
+	}
+
+	long FindClassId(char *classname) {
+		return names.FindClassId(classname);
+	}
+
+	char *GetClassnameById(long classid) {
+		return names.GetClassnameById(classid);
+	}
+
+	long GetNumberOfClasses() {
+		return names.GetNumberOfClasses();
+	}
+
+	//load errors, see the corresponding SampleSet methods
+	long GetNumberOfLoadErrors() {
+		return names.GetNumberOfLoadErrors();
+	}
+
+	long GetLoadError(long i) {
+		return names.GetLoadError(i);
+	}
+
+	//creates the sample set as a single precision copy of 'samples'
+	//the size of the feature vectors is the size of the first sample
+	void Convert(SampleSet *samples);
 
+	//loads a sample set described in a text file, see SampleSet::Load()
+	//the samples are read in chunks, so that only a chunk of samples is kept in double precision at once
+	//binary sample set files are loaded with LoadBinary()
+	//returns the number of samples
+	long Load(char *filename, int type = TYPE_DOUBLE, long size = 0);
+
+	//loads a binary sample set file, see SampleSet::SaveBinary()
+	//if its features are of TYPE_FLOAT, the feature block is the mapped file, otherwise the features are converted
+	//returns the number of samples, 0 on failure
+	long LoadBinary(char *filename);
+};
+
+//converts a sample set described in a text file (see SampleSet::Load()) into a binary sample set file (see SampleSet::SaveBinary())
+//the samples are read in chunks, the whole sample set is never kept in memory
+//parameters:
+//	listfilename : the name of the text file
+//	type, size : the type and the feature vector length of the individual sample files, see SampleSet::Load()
+//	binfilename : the name of the binary file to be created
+//	bintype : the element type of the features in the binary file, see SampleSet::SaveBinary()
+//	names : if given, receives the file names and classes of the samples without feature vectors,
+//		the samples that could not be loaded (and are stored with zero features) are its load errors
+//returns the number of samples converted, 0 on failure
+long ConvertSampleSet(char *listfilename, int type, long size, char *binfilename, int bintype, SampleSet *names = NULL);
+
+//returns true if the file given as filename is a binary sample set file
+bool IsBinarySampleSet(char *filename);
+
+//maps a binary sample set file into 'file' and checks its header
+//returns the header, NULL if the file is not a valid binary sample set file
+BinarySampleSetHeader *OpenBinarySampleSet(char *filename, MappedFile *file);
+
+//running statistics (number of samples, mean and scatter matrix) of a collection of samples
+//if classStatistics is set, the number of samples and the mean of each class are also kept,
+//which is sufficient to compute the within-class and between-class variance matrices
+//samples can be added in any number of batches, the resulting statistics are the same
+//as if they were computed from all of the samples at once
+//the statistics can be saved and later updated with new samples, without the old samples
+class SampleStatistics {
+protected:
+	long dim;	//sample dimensionality
+	long count;	//number of samples added so far
+	double *mean;	//mean of the samples
+	double *scatter;	//row-ordered (dim x dim) scatter matrix, the sum of (x-mean)*(x-mean)' over all samples x
+
+	ClassDictionary classes;	//names of the classes
+	long classcapacity;	//number of classes the arrays below can hold
+	long *classcounts;	//number of samples of each class
+	double *classmeans;	//row-ordered (number of classes x dim) matrix, the i-th row is the mean of the i-th class
+
+	//returns the index of the class with the given name, adds the class if it does not exist
+	long GetClassIndex(char *classname);
+
+public:
+	//if true (default), per-class statistics are kept
+	//can only be changed while the statistics are empty
+	bool classStatistics;
+
+	//constructor/destructor
+	SampleStatistics();
+	~SampleStatistics();
+
+	//clears the statistics
+	void Clear();
+
+	//property getters
+	long GetDim() {
+		return dim;
+	}
+
+	long GetCount() {
+		return count;
+	}
+
+	double *GetMean() {
+		return mean;
+	}
+
+	double *GetScatter() {
+		return scatter;
+	}
+
+	long GetNumberOfClasses() {
+		return classes.Size();
+	}
+
+	//adds all samples from a sample set to the statistics
+	//returns 1 on success, 0 if the sample dimensionality does not match the statistics
+	int Add(SampleSet *samples);
+
+	//creates a within-class variance matrix of the samples, the same as SampleSet::GetWithinClassVariance()
+	Matrix GetWithinClassVariance();
+
+	//creates a between-class variance matrix of the samples, the same as SampleSet::GetBetweenClassVariance()
+	Matrix GetBetweenClassVariance();
+
+	//saves the statistics to a file given as filename
+	//returns 1 on success, 0 on failure
+	int Save(char *filename);
+
+	//saves the statistics to a file given as file pointer
+	void Save(FILE *fp);
+
+	//loads the statistics from a file given as filename
+	//returns 1 on success, 0 on failure
+	int Load(char *filename);
+
+	//loads the statistics from a file given as file pointer
+	//returns 1 on success, 0 on failure
+	int Load(FILE *fp);
+};
+
+} //namespace
@@ -27,10 +27,13 @@
 #include "matrix.h"
 #include "sample.h"
 #include "eigen.h"
+#include "gemm.h"
+#include "convert.h"
 
 #include "subspace.h"
 #include "image.h"
 #include "imageio.h"
+#include "mappedfile.h"
 
 namespace LibSubspace {
 
@@ -216,6 +219,22 @@ void Subspace::ToImages(long n, char *basename, long sizex, long sizey) {
 	}
 }
 
+SubspaceGenerator::SubspaceGenerator() {
+	verbose = false;
+	eigenAlgorithm = EIGEN_CHOL;
+}
+
+int SubspaceGenerator::GenerateSubspace(SampleStatistics*, Subspace*) {
+	if(verbose) printf("Error: generating this type of subspace from statistics is not supported\n");
+	return 0;
+}
+
+int SubspaceGenerator::UpdateSubspace(SampleStatistics* statistics, SampleSet* newSamples, Subspace* subspace) {
+	if(verbose) printf("Updating statistics...\n");
+	if(!statistics->Add(newSamples)) return 0;
+	return GenerateSubspace(statistics,subspace);
+}
+
 int LDASubspaceGenerator::GenerateSubspace(SampleSet* sampleSet, Subspace* subspace) {
 	long N,n,Nc;
 	//getting the problem dimensionality
@@ -234,7 +253,7 @@ int LDASubspaceGenerator::GenerateSubspace(SampleSet* sampleSet, Subspace* subsp
 		Matrix W = sampleSet->GetWithinClassVariance();
 
 		if(verbose) printf("Computing generalized eigenvectors...\n");
-		if(!geneigen(B.GetData(),W.GetData(),n,E.GetData(),EIGEN_CHOL,verbose)) return 0;
+		if(!geneigen(B.GetData(),W.GetData(),n,E.GetData(),eigenAlgorithm,verbose)) return 0;
 
 		subspace->SetData(SUBSPACE_LDA, n, n, avg.GetData(), B.GetData(), E.GetData());
 	} else {
@@ -242,9 +261,10 @@ int LDASubspaceGenerator::GenerateSubspace(SampleSet* sampleSet, Subspace* subsp
 		//PCA has to be performed first
 		if(verbose) printf("Performing PCA...\n");
 		Subspace PCASubspace;
-		Subspace LDASubspace;
 		PCASubspaceGenerator PCAGen;
 		PCAGen.verbose = verbose;
+		PCAGen.eigenAlgorithm = eigenAlgorithm;
+		PCAGen.numComponents = Npca; //only the first Npca components are used
 		PCAGen.GenerateSubspace(sampleSet,&PCASubspace);
 		
 		if(verbose) printf("Projecting samples into low-dimensional subspace...\n");
@@ -257,23 +277,67 @@ int LDASubspaceGenerator::GenerateSubspace(SampleSet* sampleSet, Subspace* subsp
 		if(verbose) printf("Getting within class variance matrix...\n");
 		Matrix W = transformedSamples.GetWithinClassVariance();
 
+		if(!CombineWithPCA(B,W,&PCASubspace,subspace)) return 0;
+	}
+
+	subspace->ReorderAbsDescending();
+	subspace->Normalize();
+	subspace->Trim(Nc-1);
+
+	return 1;
+}
+
+int LDASubspaceGenerator::GenerateSubspace(SampleStatistics* statistics, Subspace* subspace) {
+	long N,n,Nc;
+	//getting the problem dimensionality
+	N = statistics->GetCount();				//number of samples
+	n = statistics->GetDim();				//sample dimensionality
+	Nc = statistics->GetNumberOfClasses();	//number of classes
+
+	if(Nc == 0) {
+		if(verbose) printf("Error: LDA requires per-class statistics\n");
+		return 0;
+	}
+
+	if(verbose) printf("Getting beetween class variance matrix...\n");
+	Matrix B = statistics->GetBetweenClassVariance();
+	if(verbose) printf("Getting within class variance matrix...\n");
+	Matrix W = statistics->GetWithinClassVariance();
+
+	if((Npca<=0) && (n <= (N-Nc))) {
+		//direct LDA
+		Matrix E(1,n);
+
 		if(verbose) printf("Computing generalized eigenvectors...\n");
-		Matrix E(1,Npca);
-		if(!geneigen(B.GetData(),W.GetData(),Npca,E.GetData(),EIGEN_CHOL,verbose)) return 0;
-
-		Matrix Avg(1,Npca);
-		LDASubspace.SetData(SUBSPACE_LDA, Npca, Npca, Avg.GetData(), B.GetData(), E.GetData());
-		LDASubspace.ReorderAbsDescending();
-
-		if(verbose) printf("Computing final subspace...\n");
-		Matrix MatLda(Npca,Npca);
-		Matrix MatPca(Npca,n);
-		Matrix MatFinal(Npca,n);
-		memcpy(MatLda.GetData(), LDASubspace.GetSubspaceAxes(), (Npca)*(Npca)*sizeof(double));
-		memcpy(MatPca.GetData(), PCASubspace.GetSubspaceAxes(), (Npca)*(n)*sizeof(double));
-		MatFinal = MatLda*MatPca;
-
-		subspace->SetData( SUBSPACE_LDA, Npca, n, PCASubspace.GetCenterOffset(), MatFinal.GetData(), LDASubspace.GetAxesCriterionFn());
+		if(!geneigen(B.GetData(),W.GetData(),n,E.GetData(),eigenAlgorithm,verbose)) return 0;
+
+		subspace->SetData(SUBSPACE_LDA, n, n, statistics->GetMean(), B.GetData(), E.GetData());
+	} else {
+		//the number of samples changes between updates, so Npca is not overwritten here
+		long npca = Npca;
+		if(npca == 0) npca = N-Nc;
+		//PCA has to be performed first
+		if(verbose) printf("Performing PCA...\n");
+		Subspace PCASubspace;
+		PCASubspaceGenerator PCAGen;
+		PCAGen.verbose = verbose;
+		PCAGen.eigenAlgorithm = eigenAlgorithm;
+		PCAGen.numComponents = npca; //only the first npca components are used
+		if(!PCAGen.GenerateSubspace(statistics,&PCASubspace)) return 0;
+		if(PCASubspace.GetSubspaceDim() < npca) npca = PCASubspace.GetSubspaceDim();
+
+		//the variance matrices of the samples projected into the PCA subspace are P*B*P' and P*W*P',
+		//where the rows of P are the PCA axes
+		if(verbose) printf("Projecting variance matrices into low-dimensional subspace...\n");
+		Matrix P(npca,n);
+		memcpy(P.GetData(), PCASubspace.GetSubspaceAxes(), npca*n*sizeof(double));
+		Matrix PT = P.Transpose();
+		Matrix tmp = P*B;
+		Matrix Bpca = tmp*PT;
+		tmp = P*W;
+		Matrix Wpca = tmp*PT;
+
+		if(!CombineWithPCA(Bpca,Wpca,&PCASubspace,subspace)) return 0;
 	}
 
 	subspace->ReorderAbsDescending();
@@ -283,9 +347,34 @@ int LDASubspaceGenerator::GenerateSubspace(SampleSet* sampleSet, Subspace* subsp
 	return 1;
 }
 
+int LDASubspaceGenerator::CombineWithPCA(Matrix &B, Matrix &W, Subspace *PCASubspace, Subspace* subspace) {
+	long npca = B.GetNumRows();
+	long n = PCASubspace->GetOriginalDim();
+	Subspace LDASubspace;
+
+	if(verbose) printf("Computing generalized eigenvectors...\n");
+	Matrix E(1,npca);
+	if(!geneigen(B.GetData(),W.GetData(),npca,E.GetData(),eigenAlgorithm,verbose)) return 0;
+
+	Matrix Avg(1,npca);
+	LDASubspace.SetData(SUBSPACE_LDA, npca, npca, Avg.GetData(), B.GetData(), E.GetData());
+	LDASubspace.ReorderAbsDescending();
+
+	if(verbose) printf("Computing final subspace...\n");
+	Matrix MatLda(npca,npca);
+	Matrix MatPca(npca,n);
+	Matrix MatFinal(npca,n);
+	memcpy(MatLda.GetData(), LDASubspace.GetSubspaceAxes(), (npca)*(npca)*sizeof(double));
+	memcpy(MatPca.GetData(), PCASubspace->GetSubspaceAxes(), (npca)*(n)*sizeof(double));
+	MatFinal = MatLda*MatPca;
+
+	subspace->SetData( SUBSPACE_LDA, npca, n, PCASubspace->GetCenterOffset(), MatFinal.GetData(), LDASubspace.GetAxesCriterionFn());
+
+	return 1;
+}
+
 
 int PCASubspaceGenerator::GenerateSubspace(SampleSet* sampleSet, Subspace* subspace) {
-	long i,j;
 	long N,n;
 	
 	if(sampleSet->Size() == 0) return 0;
@@ -294,39 +383,48 @@ int PCASubspaceGenerator::GenerateSubspace(SampleSet* sampleSet, Subspace* subsp
 	N = sampleSet->Size();					//number of samples
 	n = (*sampleSet)[0].Size();			//sample dimensionality
 
-	//getting the sample matrix
+	//getting the sample matrix, each row is a centered sample
 	Sample avg = sampleSet->GetAvgSample();
-	Matrix X = sampleSet->GetAsMatrix();
-	for(i=0;i<X.GetNumRows();i++) {
-		for(j=0;j<X.GetNumCols();j++) {
-			X[i][j] -= avg[i];
-		}
-	}
-
-	Matrix XT = X.Transpose();
+	Matrix XT = sampleSet->GetAsRowMatrix(&avg);
 
 	if(n > N) {
+		//number of eigenvectors to compute
+		long k = N;
+		if((numComponents > 0) && (numComponents < N)) k = numComponents;
+
 		if(verbose) printf("Computing covariance matrix...\n");
-		Matrix XTX = XT*X;
+		Matrix XTX = XT.SymmetricProduct();
 		XTX.scalarMultiply(1.00/sampleSet->Size());
-		Matrix tmpv(XTX.GetNumRows(),XTX.GetNumRows());
-		Matrix eigenvectors(N,n);
-		Matrix eigenvalues(N,1);
+		Matrix tmpv(k,N);
+		Matrix eigenvectors(k,n);
+		Matrix eigenvalues(k,1);
 		if(verbose) printf("Computing eigenvectors...\n");
-		if(!eigen(XTX.GetData(),tmpv.GetData(),eigenvalues.GetData(),XTX.GetNumRows(),verbose)) return 0;
+		if(k < N) {
+			if(!eigentop(XTX.GetData(),tmpv.GetData(),eigenvalues.GetData(),N,k,verbose)) return 0;
+		} else {
+			if(!eigen(XTX.GetData(),tmpv.GetData(),eigenvalues.GetData(),N,verbose,eigenAlgorithm)) return 0;
+		}
 		if(verbose) printf("Computing actual eigenvectors...\n");			
 		eigenvectors = tmpv*XT;
 		if(verbose) printf("Saving subspace data...\n");
-		subspace->SetData(SUBSPACE_PCA,N,n,avg.GetData(),eigenvectors.GetData(),eigenvalues.GetData());		
+		subspace->SetData(SUBSPACE_PCA,k,n,avg.GetData(),eigenvectors.GetData(),eigenvalues.GetData());		
 	} else {
+		//number of eigenvectors to compute
+		long k = n;
+		if((numComponents > 0) && (numComponents < n)) k = numComponents;
+
 		if(verbose) printf("Computing covariance matrix...\n");
-		Matrix XXT = X*XT;
+		Matrix XXT = XT.SymmetricProduct(true);
 		XXT.scalarMultiply(1.00/sampleSet->Size());
-		Matrix eigenvectors(n,n);
-		Matrix eigenvalues(n,1);
+		Matrix eigenvectors(k,n);
+		Matrix eigenvalues(k,1);
 		if(verbose) printf("Computing eigenvectors...\n");
-		if(!eigen(XXT.GetData(),eigenvectors.GetData(),eigenvalues.GetData(),n,verbose)) return 0;
-		subspace->SetData(SUBSPACE_PCA,n,n,avg.GetData(),eigenvectors.GetData(),eigenvalues.GetData());
+		if(k < n) {
+			if(!eigentop(XXT.GetData(),eigenvectors.GetData(),eigenvalues.GetData(),n,k,verbose)) return 0;
+		} else {
+			if(!eigen(XXT.GetData(),eigenvectors.GetData(),eigenvalues.GetData(),n,verbose,eigenAlgorithm)) return 0;
+		}
+		subspace->SetData(SUBSPACE_PCA,k,n,avg.GetData(),eigenvectors.GetData(),eigenvalues.GetData());
 	}
 
 	subspace->Normalize();
@@ -337,6 +435,165 @@ int PCASubspaceGenerator::GenerateSubspace(SampleSet* sampleSet, Subspace* subsp
 }
 
 
+int PCASubspaceGenerator::GenerateSubspace(SampleStatistics* statistics, Subspace* subspace) {
+	long N,n,k;
+
+	if(statistics->GetCount() == 0) return 0;
+
+	//getting the problem dimensionality
+	N = statistics->GetCount();			//number of samples
+	n = statistics->GetDim();			//sample dimensionality
+
+	//number of eigenvectors to compute
+	k = n;
+	if((numComponents > 0) && (numComponents < n)) k = numComponents;
+
+	if(verbose) printf("Computing covariance matrix...\n");
+	Matrix cov(n,n);
+	memcpy(cov.GetData(),statistics->GetScatter(),n*n*sizeof(double));
+	cov.scalarMultiply(1.00/N);
+	Matrix eigenvectors(k,n);
+	Matrix eigenvalues(k,1);
+	if(verbose) printf("Computing eigenvectors...\n");
+	if(k < n) {
+		if(!eigentop(cov.GetData(),eigenvectors.GetData(),eigenvalues.GetData(),n,k,verbose)) return 0;
+	} else {
+		if(!eigen(cov.GetData(),eigenvectors.GetData(),eigenvalues.GetData(),n,verbose,eigenAlgorithm)) return 0;
+	}
+	subspace->SetData(SUBSPACE_PCA,k,n,statistics->GetMean(),eigenvectors.GetData(),eigenvalues.GetData());
+
+	subspace->Normalize();
+	subspace->ReorderAbsDescending();
+	subspace->Trim(N-1);
+
+	return 1;
+}
+
+
+int StreamingPCASubspaceGenerator::GenerateSubspace(char *filename, int type, long size, Subspace* subspace) {
+	SampleStatistics statistics;
+	statistics.classStatistics = false;
+	SampleSet chunk;
+	long loaded = 0;
+
+	//binary sample set files are mapped and converted in chunks, like the samples listed in a text file
+	if(IsBinarySampleSet(filename)) {
+		MappedFile file;
+		BinarySampleSetHeader *header = OpenBinarySampleSet(filename,&file);
+		if(!header) {
+			printf("Error loading file %s\n",filename);
+			return 0;
+		}
+		while(chunk.LoadBinaryChunk(&file,header,loaded,chunkSize) > 0) {
+			loaded += chunk.Size();
+			if(verbose) printf("%ld samples loaded\n",loaded);
+			statistics.Add(&chunk);
+		}
+		chunk.Clear();
+		if(loaded < header->numsamples) {
+			printf("Error loading file %s\n",filename);
+			return 0;
+		}
+		return GenerateSubspace(&statistics,subspace);
+	}
+
+	FILE *fp = fopen(filename,"r");
+	if(!fp) {
+		printf("Error opening file %s\n",filename);
+		return 0;
+	}
+
+	while(chunk.LoadChunk(fp,chunkSize,type,size) > 0) {
+		loaded += chunk.Size();
+		if(verbose) printf("%ld samples loaded\n",loaded);
+		statistics.Add(&chunk);
+	}
+	chunk.Clear();
+	fclose(fp);
+
+	return GenerateSubspace(&statistics,subspace);
+}
+
+int StreamingPCASubspaceGenerator::GenerateSubspace(SampleSet* sampleSet, Subspace* subspace) {
+	SampleStatistics statistics;
+	statistics.classStatistics = false;
+	statistics.Add(sampleSet);
+	return GenerateSubspace(&statistics,subspace);
+}
+
+//standard normal random number (Box-Muller transform)
+static double RandomGaussian(unsigned long long *state) {
+	double u1 = RandomUniform(state);
+	double u2 = RandomUniform(state);
+	return sqrt(-2.0*log(u1))*cos(2.0*3.14159265358979323846*u2);
+}
+
+int RandomizedPCASubspaceGenerator::GenerateSubspace(SampleSet* sampleSet, Subspace* subspace) {
+	long i,q;
+	long N,n,k,l;
+
+	if(sampleSet->Size() == 0) return 0;
+
+	//getting the problem dimensionality
+	N = sampleSet->Size();					//number of samples
+	n = (*sampleSet)[0].Size();			//sample dimensionality
+
+	k = (N-1 < n) ? N-1 : n;			//number of components
+	if((numComponents > 0) && (numComponents < k)) k = numComponents;
+	if(k <= 0) return 0;
+	l = k + oversampling;				//number of random directions
+	if(l > N) l = N;
+	if(l > n) l = n;
+
+	//getting the sample matrix, each row is a centered sample
+	Sample avg = sampleSet->GetAvgSample();
+	Matrix X = sampleSet->GetAsRowMatrix(&avg);
+
+	//random projection directions
+	if(verbose) printf("Generating random directions...\n");
+	unsigned long long state = 0x9E3779B97F4A7C15ULL ^ (unsigned long long)seed;
+	if(!state) state = 1;
+	Matrix R(l,n);
+	double *rdata = R.GetData();
+	for(i=0;i<l*n;i++) rdata[i] = RandomGaussian(&state);
+
+	//the rows of Q form an orthonormal basis for the range of X
+	//Q = orth(R*X'), then Q = orth((Q*X)*X') for each power iteration
+	if(verbose) printf("Finding the range of the sample matrix...\n");
+	Matrix Q(l,N);
+	Matrix B(l,n);
+	gemm(GEMM_NOTRANS,GEMM_TRANS,l,N,n,1.0,R.GetData(),n,X.GetData(),n,0.0,Q.GetData(),N);
+	if(!orthonormalize(Q.GetData(),l,N,verbose)) return 0;
+	for(q=0;q<powerIterations;q++) {
+		if(verbose) printf("Power iteration %ld...\n",q+1);
+		gemm(GEMM_NOTRANS,GEMM_NOTRANS,l,n,N,1.0,Q.GetData(),N,X.GetData(),n,0.0,B.GetData(),n);
+		if(!orthonormalize(B.GetData(),l,n,verbose)) return 0;
+		gemm(GEMM_NOTRANS,GEMM_TRANS,l,N,n,1.0,B.GetData(),n,X.GetData(),n,0.0,Q.GetData(),N);
+		if(!orthonormalize(Q.GetData(),l,N,verbose)) return 0;
+	}
+
+	//project the samples onto the basis, B = Q*X
+	//the right singular vectors of B approximate those of X, they are found from the
+	//eigenvectors of the small (l x l) matrix B*B'
+	if(verbose) printf("Computing eigenvectors...\n");
+	gemm(GEMM_NOTRANS,GEMM_NOTRANS,l,n,N,1.0,Q.GetData(),N,X.GetData(),n,0.0,B.GetData(),n);
+	Matrix BBT = B.SymmetricProduct();
+	BBT.scalarMultiply(1.00/N);
+	Matrix tmpv(l,l);
+	Matrix eigenvalues(l,1);
+	if(!eigen(BBT.GetData(),tmpv.GetData(),eigenvalues.GetData(),l,verbose,eigenAlgorithm)) return 0;
+	Matrix eigenvectors = tmpv*B;
+
+	if(verbose) printf("Saving subspace data...\n");
+	subspace->SetData(SUBSPACE_PCA,l,n,avg.GetData(),eigenvectors.GetData(),eigenvalues.GetData());
+
+	subspace->Normalize();
+	subspace->ReorderAbsDescending();
+	subspace->Trim(k);
+
+	return 1;
+}
+
 SubspaceProjector::SubspaceProjector(Subspace *subspace) {
 	this->subspace = subspace;
 }
@@ -345,15 +602,106 @@ SubspaceProjector::~SubspaceProjector() {
 	//delete subspace;
 }
 
+//number of samples centered and projected at once by ProjectSampleSet
+#define PROJECTION_BLOCK_SIZE 256
+
+void SubspaceProjector::ProjectBlock(SampleSet *originalSamples, long first, long numSamples, double *buffer, double *projectedData, int dim) {
+	long i,j,size;
+	long n = subspace->originalDim;
+	double *row,*src;
+	for(i=0;i<numSamples;i++) {
+		row = &(buffer[i*n]);
+		src = originalSamples->GetSample(first+i)->GetData();
+		//the missing features of samples that could not be loaded completely do not contribute to the projection
+		size = originalSamples->GetSample(first+i)->Size();
+		if(size > n) size = n;
+		for(j=0;j<size;j++) row[j] = src[j] - subspace->centerOffset[j];
+		for(;j<n;j++) row[j] = 0;
+	}
+	ProjectCenteredBlock(buffer,numSamples,projectedData,dim);
+}
+
+void SubspaceProjector::ProjectBlock(FloatSampleSet *originalSamples, long first, long numSamples, double *buffer, double *projectedData, int dim) {
+	long i,j;
+	long n = subspace->originalDim;
+	double *row;
+	float *src;
+	for(i=0;i<numSamples;i++) {
+		row = &(buffer[i*n]);
+		src = originalSamples->GetSampleData(first+i);
+		for(j=0;j<n;j++) row[j] = src[j] - subspace->centerOffset[j];
+	}
+	ProjectCenteredBlock(buffer,numSamples,projectedData,dim);
+}
+
+void SubspaceProjector::ProjectCenteredBlock(double *buffer, long numSamples, double *projectedData, int dim) {
+	long n = subspace->originalDim;
+	//the rows of projectedData are the centered samples multiplied by the transposed axes
+	gemm(GEMM_NOTRANS,GEMM_TRANS,numSamples,dim,n,1.0,buffer,n,subspace->subspaceAxes,n,0.0,projectedData,dim);
+}
+
 void SubspaceProjector::ProjectSampleSet(SampleSet *originalSamples, SampleSet *projectedSamples, int dim) {
 	if((!dim)||(dim>subspace->subspaceDim)) dim = subspace->subspaceDim;
-	long n = originalSamples->Size();
-	projectedSamples->Init(n);
-	for(long i=0;i<n;i++) {
-		ProjectSample(originalSamples->GetSample(i),projectedSamples->GetSample(i),dim);
+	long N = originalSamples->Size();
+	projectedSamples->Init(N,dim);
+	if(N == 0) return;
+	long blocksize = (N < PROJECTION_BLOCK_SIZE) ? N : PROJECTION_BLOCK_SIZE;
+	double *buffer = (double *)malloc(blocksize*subspace->originalDim*sizeof(double));
+	double *projected = (double *)malloc(blocksize*dim*sizeof(double));
+	for(long i=0;i<N;i+=blocksize) {
+		long nb = (N-i < blocksize) ? (N-i) : blocksize;
+		ProjectBlock(originalSamples,i,nb,buffer,projected,dim);
+		for(long j=0;j<nb;j++) {
+			Sample *originalSample = originalSamples->GetSample(i+j);
+			Sample *projectedSample = projectedSamples->GetSample(i+j);
+			memcpy(projectedSample->GetData(),&(projected[j*dim]),dim*sizeof(double));
+			projectedSample->SetClassname(originalSample->GetClassname());
+			projectedSample->SetFilename(originalSample->GetFilename());
+		}
 	}
+	free(projected);
+	free(buffer);
 };
 
+void SubspaceProjector::ProjectSampleSet(SampleSet *originalSamples, double *projectedData, int dim) {
+	if((!dim)||(dim>subspace->subspaceDim)) dim = subspace->subspaceDim;
+	long N = originalSamples->Size();
+	if(N == 0) return;
+	long blocksize = (N < PROJECTION_BLOCK_SIZE) ? N : PROJECTION_BLOCK_SIZE;
+	double *buffer = (double *)malloc(blocksize*subspace->originalDim*sizeof(double));
+	for(long i=0;i<N;i+=blocksize) {
+		long nb = (N-i < blocksize) ? (N-i) : blocksize;
+		ProjectBlock(originalSamples,i,nb,buffer,&(projectedData[i*dim]),dim);
+	}
+	free(buffer);
+}
+
+void SubspaceProjector::ProjectSampleSet(FloatSampleSet *originalSamples, FloatSampleSet *projectedSamples, int dim) {
+	if((!dim)||(dim>subspace->subspaceDim)) dim = subspace->subspaceDim;
+	long N = originalSamples->Size();
+	projectedSamples->Init(N,dim);
+	if(N == 0) return;
+	if(originalSamples->GetDim() != subspace->originalDim) {
+		printf("Error: sample size does not match the subspace\n");
+		return;
+	}
+	long blocksize = (N < PROJECTION_BLOCK_SIZE) ? N : PROJECTION_BLOCK_SIZE;
+	double *buffer = (double *)malloc(blocksize*subspace->originalDim*sizeof(double));
+	double *projected = (double *)malloc(blocksize*dim*sizeof(double));
+	for(long i=0;i<N;i+=blocksize) {
+		long nb = (N-i < blocksize) ? (N-i) : blocksize;
+		ProjectBlock(originalSamples,i,nb,buffer,projected,dim);
+		for(long j=0;j<nb;j++) {
+			float *dst = projectedSamples->GetSampleData(i+j);
+			ConvertToFloat(&(projected[j*dim]),dst,dim);
+			projectedSamples->SetClassname(i+j,originalSamples->GetClassname(i+j));
+			projectedSamples->SetFilename(i+j,originalSamples->GetFilename(i+j));
+		}
+	}
+	free(projected);
+	free(buffer);
+}
+
 void SubspaceProjector::ProjectSample(Sample *originalSample, Sample *projectedSample, int dim) {
 	if((!dim)||(dim>subspace->subspaceDim)) dim = subspace->subspaceDim;
 	projectedSample->Init(dim);
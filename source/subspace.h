@@ -111,21 +111,109 @@ class SubspaceGenerator {
 public:
 	bool verbose; //if true, prints information about subspace generation, including error messages
 
-	SubspaceGenerator() {
-		verbose = false;
-	}
+	//algorithm used for eigenanalysis, see geneigen() in eigen.h
+	//EIGEN_CHOL (default) uses the standard LAPACK drivers
+	//EIGEN_DC uses the divide and conquer drivers, which are faster for large problems but use more memory
+	int eigenAlgorithm;
+
+	SubspaceGenerator();
+
+	//destructor, virtual as generators are used (and deleted) through this interface
+	virtual ~SubspaceGenerator() {}
 
 	//generates a subspace based on the training data contained in the sampleSet
 	virtual int GenerateSubspace(SampleSet* sampleSet, Subspace* subspace)=0;
+
+	//generates a subspace from the statistics of the training data, see SampleStatistics
+	//returns 0 if the generator does not support this
+	virtual int GenerateSubspace(SampleStatistics* statistics, Subspace* subspace);
+
+	//updates a subspace with new training data, without the training data used previously
+	//params:
+	//	statistics : the statistics of the training data the subspace was generated from,
+	//	             on return, they also include newSamples and can be saved for the next update
+	//	newSamples : the new training data
+	//	subspace : on return, the subspace generated from all of the training data
+	int UpdateSubspace(SampleStatistics* statistics, SampleSet* newSamples, Subspace* subspace);
 };
 
 //generates a PCA subspace based on the training data
 class PCASubspaceGenerator : public SubspaceGenerator {
 public:
+	//number of principal components (subspace axes) to compute
+	//if 0, all components are computed
+	//otherwise, only the eigenvectors with the numComponents largest eigenvalues are computed
+	//which is much faster when numComponents is small compared to the number or dimensionality of samples
+	long numComponents;
+
+	//constructor
+	PCASubspaceGenerator() {numComponents = 0;}
+
+	//generates a PCA subspace based on the training data contained in the sampleSet
+	int GenerateSubspace(SampleSet* sampleSet, Subspace* subspace);
+
+	//generates a PCA subspace from the statistics of the training data
+	int GenerateSubspace(SampleStatistics* statistics, Subspace* subspace);
+};
+
+
+//generates a PCA subspace using a randomized algorithm
+//computes only the first numComponents principal components, in time proportional to
+//(number of samples) x (sample dimensionality) x numComponents, which makes it suitable for
+//very large sample sets where the covariance (or Gram) matrix could not be decomposed
+//the range of the sample matrix is found by multiplying it with a random matrix,
+//followed by several power iterations to improve accuracy
+//the results are reproducible for the same seed
+class RandomizedPCASubspaceGenerator : public SubspaceGenerator {
+public:
+	//number of principal components to compute
+	//if 0, min((number of samples)-1, (sample dimensionality)) is used
+	long numComponents;
+
+	//number of additional random directions used to find the range of the sample matrix
+	//larger values improve accuracy of the last components, 10 by default
+	long oversampling;
+
+	//number of power iterations, more iterations improve accuracy
+	//when the eigenvalues of the covariance matrix decay slowly, 4 by default
+	long powerIterations;
+
+	//seed of the random number generator
+	unsigned long seed;
+
+	//constructor
+	RandomizedPCASubspaceGenerator() {
+		numComponents = 0;
+		oversampling = 10;
+		powerIterations = 4;
+		seed = 1;
+	}
+
 	//generates a PCA subspace based on the training data contained in the sampleSet
 	int GenerateSubspace(SampleSet* sampleSet, Subspace* subspace);
 };
 
+//generates a PCA subspace without holding all of the training samples in memory
+//samples are read in chunks and only the mean and the (dimensionality x dimensionality) scatter matrix
+//are kept, so the memory used does not depend on the number of samples
+//gives the same subspace as PCASubspaceGenerator (up to the signs of the axes)
+class StreamingPCASubspaceGenerator : public PCASubspaceGenerator {
+public:
+	//number of samples loaded into memory at once, 1000 by default
+	long chunkSize;
+
+	//constructor
+	StreamingPCASubspaceGenerator() {chunkSize = 1000;}
+
+	using PCASubspaceGenerator::GenerateSubspace;
+
+	//generates a PCA subspace based on the training data listed in a file
+	//the file has the same format as the one read by SampleSet::Load, binary sample set files are also read in chunks
+	int GenerateSubspace(char *filename, int type, long size, Subspace* subspace);
+
+	//generates a PCA subspace based on the training data contained in the sampleSet
+	int GenerateSubspace(SampleSet* sampleSet, Subspace* subspace);
+};
 
 //generates a LDA subspace based on the training data
 class LDASubspaceGenerator : public SubspaceGenerator {
@@ -142,6 +230,15 @@ public:
 
 	//generates a LDA subspace based on the training data contained in the sampleSet
 	int GenerateSubspace(SampleSet* sampleSet, Subspace* subspace);
+
+	//generates a LDA subspace from the statistics of the training data
+	//the statistics must include the per-class statistics
+	int GenerateSubspace(SampleStatistics* statistics, Subspace* subspace);
+
+protected:
+	//computes the LDA in the PCA subspace and combines the two subspaces into the final subspace
+	//B and W are the between-class and within-class variance matrices of the samples projected into PCASubspace
+	int CombineWithPCA(Matrix &B, Matrix &W, Subspace *PCASubspace, Subspace* subspace);
 };
 
 //projects a sample set into a subspace
@@ -170,6 +267,34 @@ public:
 	//	dim : a dimensionality to which originalSamples will be reduced
 	//	      if set to 0, all available subspace axis will be used
 	void ProjectSampleSet(SampleSet *originalSamples, SampleSet *projectedSamples, int dim = 0);
+
+	//projects a sample set into subspace, storing the result in a single array
+	//params:
+	//	originalSamples : samples to be projected
+	//	projectedData : row-ordered (number of samples x dim) array receiving the projected samples,
+	//	                must hold (number of samples) x min(dim, subspace dimensionality) values,
+	//	                (number of samples) x (subspace dimensionality) values if dim is 0
+	//	dim : a dimensionality to which originalSamples will be reduced
+	//	      if set to 0 or larger than the subspace dimensionality, all available subspace axis will be used
+	void ProjectSampleSet(SampleSet *originalSamples, double *projectedData, int dim);
+
+	//projects a single precision sample set into subspace
+	//the projection is computed in double precision, the result is stored in single precision
+	//params:
+	//	originalSamples : samples to be projected
+	//	projectedSamples : resulting samples in a new subspace
+	//	dim : a dimensionality to which originalSamples will be reduced
+	//	      if set to 0, all available subspace axis will be used
+	void ProjectSampleSet(FloatSampleSet *originalSamples, FloatSampleSet *projectedSamples, int dim = 0);
+
+protected:
+	//projects numSamples samples, starting with the sample first, as a single matrix product
+	//the samples are centered into buffer (numSamples x originalDim), the result is stored in projectedData
+	void ProjectBlock(SampleSet *originalSamples, long first, long numSamples, double *buffer, double *projectedData, int dim);
+	void ProjectBlock(FloatSampleSet *originalSamples, long first, long numSamples, double *buffer, double *projectedData, int dim);
+
+	//projects numSamples centered samples stored in buffer, the result is stored in projectedData
+	void ProjectCenteredBlock(double *buffer, long numSamples, double *projectedData, int dim);
 };
 
 } //namespace